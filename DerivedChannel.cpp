@@ -0,0 +1,290 @@
+//
+// Kinematic channels derived on demand from recorded channels.
+//
+
+#include "DerivedChannel.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// Function to write first derivatives of samples first..last; the interior loop has no branches
+// so the compiler can vectorize it
+template <typename T>
+static void differentiate(const T *x, int count, int first, int last, double factor, float *out) {
+    int i = first;
+    if (i == 0) {
+        out[0] = count > 1 ? static_cast<float>((x[1] - static_cast<double>(x[0])) * factor) : 0.0f;
+        ++i;
+    }
+    int interiorLast = std::min(last, count - 2);
+    double halfFactor = factor / 2;
+    for (; i <= interiorLast; ++i) {
+        out[i - first] = static_cast<float>((x[i + 1] - static_cast<double>(x[i - 1])) * halfFactor);
+    }
+    if (i <= last) {
+        out[i - first] = static_cast<float>((x[count - 1] - static_cast<double>(x[count - 2])) * factor);
+    }
+}
+
+// Function to write second derivatives of samples first..last; the ends repeat their neighbour
+template <typename T>
+static void differentiateTwice(const T *x, int count, int first, int last, double factor, float *out) {
+    if (count < 3) {
+        std::fill(out, out + (last - first + 1), 0.0f);
+        return;
+    }
+    int interiorFirst = std::max(first, 1);
+    int interiorLast = std::min(last, count - 2);
+    for (int i = interiorFirst; i <= interiorLast; ++i) {
+        out[i - first] = static_cast<float>((x[i + 1] - 2.0 * x[i] + x[i - 1]) * factor);
+    }
+    if (first == 0) {
+        out[0] = static_cast<float>((x[2] - 2.0 * x[1] + x[0]) * factor);
+    }
+    if (last == count - 1) {
+        out[last - first] = static_cast<float>((x[count - 1] - 2.0 * x[count - 2] + x[count - 3]) * factor);
+    }
+}
+
+// Constructor for an empty channel
+DerivedChannel::DerivedChannel()
+        : derivedKind(Velocity), samplingRate(1), sampleCount(0), first(0) {
+}
+
+// Constructor
+DerivedChannel::DerivedChannel(Kind kind, const QVector<SampleBuffer> &sources, const QVector<double> &sourceRates, double samplingRate)
+        : derivedKind(kind), sources(sources), samplingRate(samplingRate > 0 ? samplingRate : 1), sampleCount(0), first(0) {
+    // Velocity and acceleration use the first source, tangential speed up to three
+    int used = kind == TangentialSpeed ? std::min(3, this->sources.size()) : std::min(1, this->sources.size());
+    this->sources.resize(used);
+    resamplers.resize(used);
+    if (used > 0) {
+        sampleCount = std::numeric_limits<int>::max();
+        for (int i = 0; i < used; ++i) {
+            const SampleBuffer &source = this->sources[i];
+            double rate = i < sourceRates.size() && sourceRates[i] > 0 ? sourceRates[i] : this->samplingRate;
+            int count = source.size();
+            if (rate != this->samplingRate && count > 0) {
+                resamplers[i] = QSharedPointer<const PolyphaseResampler>(new PolyphaseResampler(rate, this->samplingRate));
+                count = static_cast<int>(std::min<double>(std::numeric_limits<int>::max(),
+                                                          std::floor((count - 1) * this->samplingRate / rate) + 1));
+            }
+            sampleCount = std::min(sampleCount, count);
+        }
+    }
+
+    int buckets = (sampleCount + envelopeBucket - 1) / envelopeBucket;
+    mins.resize(buckets);
+    maxs.resize(buckets);
+    chunkReady.resize((buckets + envelopeChunk - 1) / envelopeChunk);
+    chunkRequested.resize(chunkReady.size());
+}
+
+// Function to get the kind of derivative
+DerivedChannel::Kind DerivedChannel::kind() const {
+    return derivedKind;
+}
+
+// Function to check whether the channel has samples
+bool DerivedChannel::isValid() const {
+    return sampleCount > 0;
+}
+
+// Function to get the number of samples
+int DerivedChannel::size() const {
+    return sampleCount;
+}
+
+// Function to hand the samples of one source to fn; a resampled source is converted for the range only
+template <typename Fn>
+void DerivedChannel::visitSource(int index, int from, int to, Fn fn) const {
+    const SampleBuffer &source = sources[index];
+    if (!resamplers[index]) {
+        source.visit([&](const auto *x, int) {
+            fn(x, sampleCount, from, to, source.scale());
+        });
+        return;
+    }
+
+    // Two neighbours on either side keep the differences at the range ends as on the whole channel
+    int low = std::max(0, from - 2);
+    int high = std::min(sampleCount - 1, to + 2);
+    QVector<float> values(high - low + 1);
+    resamplers[index]->resample(source, low, high, values.data());
+    fn(values.constData(), values.size(), from - low, to - low, 1.0);
+}
+
+// Function to compute derived values of a sample range
+void DerivedChannel::compute(int from, int to, float *out) const {
+    int count = to - from + 1;
+    auto derive = [&](int index, float *values) {
+        visitSource(index, from, to, [&](const auto *x, int n, int localFirst, int localLast, double scale) {
+            if (derivedKind == Acceleration) {
+                differentiateTwice(x, n, localFirst, localLast, scale * samplingRate * samplingRate, values);
+            } else {
+                differentiate(x, n, localFirst, localLast, scale * samplingRate, values);
+            }
+        });
+    };
+
+    if (derivedKind == TangentialSpeed) {
+        // Speed is the length of the velocity vector of all sources
+        QVector<float> velocity(count);
+        QVector<float> squares(count, 0.0f);
+        for (int s = 0; s < sources.size(); ++s) {
+            derive(s, velocity.data());
+            const float *v = velocity.constData();
+            float *sum = squares.data();
+            for (int k = 0; k < count; ++k) {
+                sum[k] += v[k] * v[k];
+            }
+        }
+        const float *sum = squares.constData();
+        for (int k = 0; k < count; ++k) {
+            out[k] = std::sqrt(sum[k]);
+        }
+        return;
+    }
+
+    derive(0, out);
+}
+
+// Function to compute the window unless it already covers the range
+void DerivedChannel::ensureWindow(int from, int to) {
+    from = std::max(0, from);
+    to = std::min(sampleCount - 1, to);
+    if (from > to || (!window.isEmpty() && first <= from && to < first + window.size())) {
+        return;
+    }
+
+    // One range of margin on either side, so short pans stay inside the window
+    int span = to - from + 1;
+    int windowFrom = std::max(0, from - span);
+    int windowTo = static_cast<int>(std::min<qint64>(sampleCount - 1, static_cast<qint64>(to) + span));
+    QVector<float> values(windowTo - windowFrom + 1);
+    compute(windowFrom, windowTo, values.data());
+
+    first = windowFrom;
+    window = SampleBuffer(values);
+    pyramid.build(window);
+}
+
+// Function to get the first sample of the window
+int DerivedChannel::windowFirst() const {
+    return first;
+}
+
+// Function to get the values of the window
+const SampleBuffer &DerivedChannel::windowValues() const {
+    return window;
+}
+
+// Function to get the pyramid of the window
+const SignalPyramid &DerivedChannel::windowPyramid() const {
+    return pyramid;
+}
+
+// Function to request the missing envelope chunks covering a bucket range
+QVector<int> DerivedChannel::requestEnvelope(int firstBucket, int lastBucket) {
+    firstBucket = std::max(0, firstBucket);
+    lastBucket = std::min(mins.size() - 1, lastBucket);
+    QVector<int> chunks;
+    for (int chunk = firstBucket / envelopeChunk; firstBucket <= lastBucket && chunk <= lastBucket / envelopeChunk; ++chunk) {
+        if (!chunkReady.testBit(chunk) && !chunkRequested.testBit(chunk)) {
+            chunkRequested.setBit(chunk);
+            chunks.append(chunk);
+        }
+    }
+    return chunks;
+}
+
+// Function to fill envelope chunks
+void DerivedChannel::buildEnvelope(const QVector<int> &chunks) {
+    QVector<float> values;
+    for (int chunk : chunks) {
+        if (chunk < 0 || chunk >= chunkReady.size() || chunkReady.testBit(chunk)) {
+            continue;
+        }
+
+        // Derived values of one chunk exist only while its buckets are reduced
+        int from = chunk * envelopeChunk * envelopeBucket;
+        int to = static_cast<int>(std::min<qint64>(sampleCount, static_cast<qint64>(from) + envelopeChunk * envelopeBucket) - 1);
+        values.resize(to - from + 1);
+        compute(from, to, values.data());
+
+        const float *data = values.constData();
+        for (int start = 0; start < values.size(); start += envelopeBucket) {
+            int end = std::min(start + envelopeBucket, values.size());
+            float low = data[start];
+            float high = data[start];
+            for (int i = start + 1; i < end; ++i) {
+                low = std::min(low, data[i]);
+                high = std::max(high, data[i]);
+            }
+            int bucket = (from + start) / envelopeBucket;
+            mins[bucket] = low;
+            maxs[bucket] = high;
+        }
+        chunkReady.setBit(chunk);
+    }
+}
+
+// Function to take over envelope chunks built on a copy of the channel
+void DerivedChannel::setEnvelope(const DerivedChannel &built, const QVector<int> &chunks) {
+    // A copy of another binding, e.g. of a recording loaded since, does not fit
+    if (built.sampleCount != sampleCount || built.mins.size() != mins.size()) {
+        return;
+    }
+    for (int chunk : chunks) {
+        if (chunk < 0 || chunk >= chunkReady.size() || !built.chunkReady.testBit(chunk)) {
+            continue;
+        }
+        int first = chunk * envelopeChunk;
+        int count = std::min(envelopeChunk, mins.size() - first);
+        std::copy(built.mins.constBegin() + first, built.mins.constBegin() + first + count, mins.begin() + first);
+        std::copy(built.maxs.constBegin() + first, built.maxs.constBegin() + first + count, maxs.begin() + first);
+        chunkReady.setBit(chunk);
+    }
+}
+
+// Function to check whether a bucket of the envelope is filled
+bool DerivedChannel::isBucketReady(int bucket) const {
+    return bucket >= 0 && bucket < mins.size() && chunkReady.testBit(bucket / envelopeChunk);
+}
+
+// Function to estimate a bucket from its first samples
+void DerivedChannel::probeBucket(int bucket, int probeLength, float &low, float &high) const {
+    int from = bucket * envelopeBucket;
+    int to = std::min(sampleCount - 1, from + std::max(1, probeLength) - 1);
+    QVector<float> values(std::max(1, to - from + 1));
+    low = high = 0.0f;
+    if (from > to) {
+        return;
+    }
+    compute(from, to, values.data());
+    low = *std::min_element(values.constBegin(), values.constEnd());
+    high = *std::max_element(values.constBegin(), values.constEnd());
+}
+
+// Function to get the envelope minima
+const QVector<float> &DerivedChannel::envelopeMins() const {
+    return mins;
+}
+
+// Function to get the envelope maxima
+const QVector<float> &DerivedChannel::envelopeMaxs() const {
+    return maxs;
+}
+
+// Function to get the derived value of one sample
+double DerivedChannel::valueAt(int index) const {
+    if (index < 0 || index >= sampleCount) {
+        return 0.0;
+    }
+    if (!window.isEmpty() && index >= first && index < first + window.size()) {
+        return window.valueAt(index - first);
+    }
+    float value;
+    compute(index, index, &value);
+    return value;
+}
@@ -0,0 +1,88 @@
+//
+// Kinematic channels derived on demand from recorded channels.
+//
+
+#ifndef DERIVEDCHANNEL_H
+#define DERIVEDCHANNEL_H
+
+#include <QBitArray>
+#include <QSharedPointer>
+#include <QVector>
+#include "SampleBuffer.h"
+#include "SignalPyramid.h"
+#include "SignalResampler.h"
+
+// DerivedChannel differentiates one or more source channels (central differences, one-sided at
+// the ends) without precomputing anything. Zoomed-in views ask for a window of derived values,
+// which is computed for the visible range plus one range to either side and kept until the view
+// leaves it. Zoomed-out views use a min/max envelope with one pair per envelopeBucket samples,
+// filled in chunks of envelopeChunk buckets the first time a chunk becomes visible and kept
+// afterwards. A view requests the chunks it misses and has them built on a copy of the channel,
+// e.g. on a worker, then takes them over; until then probeBucket() gives a cheap estimate. Sources
+// recorded at a lower rate are resampled to the derived rate for each computed range only.
+class DerivedChannel {
+public:
+    // Velocity and acceleration of one source, or the speed along the path of up to three
+    // sources, e.g. X/Y/Z
+    enum Kind { Velocity, Acceleration, TangentialSpeed };
+
+    // Samples per bucket of the persistent envelope
+    static constexpr int envelopeBucket = 1024;
+
+    DerivedChannel();
+    // Sources with their own rates; the derived channel is sampled at samplingRate
+    DerivedChannel(Kind kind, const QVector<SampleBuffer> &sources, const QVector<double> &sourceRates, double samplingRate);
+
+    Kind kind() const;
+    bool isValid() const;
+    int size() const;
+
+    // Make derived values of samples first..last available in the window
+    void ensureWindow(int first, int last);
+    int windowFirst() const;
+    const SampleBuffer &windowValues() const;     // Floats, index 0 is windowFirst()
+    const SignalPyramid &windowPyramid() const;
+
+    // Mark the envelope chunks covering a bucket range that are neither built nor requested yet
+    // as requested and return them
+    QVector<int> requestEnvelope(int firstBucket, int lastBucket);
+    // Build envelope chunks, on a copy of the channel, and take over the chunks of such a copy
+    void buildEnvelope(const QVector<int> &chunks);
+    void setEnvelope(const DerivedChannel &built, const QVector<int> &chunks);
+    bool isBucketReady(int bucket) const;
+    // Range of the derived values of the first probeLength samples of a bucket
+    void probeBucket(int bucket, int probeLength, float &low, float &high) const;
+    const QVector<float> &envelopeMins() const;
+    const QVector<float> &envelopeMaxs() const;
+
+    // Derived value of one sample, from the window or computed on the spot
+    double valueAt(int index) const;
+
+private:
+    // Compute derived values of samples first..last into out
+    void compute(int first, int last, float *out) const;
+
+    // Call fn(x, count, first, last, scale) with the samples of one source around from..to
+    template <typename Fn>
+    void visitSource(int index, int from, int to, Fn fn) const;
+
+    Kind derivedKind;
+    QVector<SampleBuffer> sources;
+    QVector<QSharedPointer<const PolyphaseResampler>> resamplers;   // Per source, null at the derived rate
+    double samplingRate;
+    int sampleCount;                 // Length of the shortest source
+
+    // Window for zoomed-in views
+    int first;
+    SampleBuffer window;
+    SignalPyramid pyramid;
+
+    // Envelope for zoomed-out views, filled in chunks of envelopeChunk buckets
+    static constexpr int envelopeChunk = 64;
+    QVector<float> mins;
+    QVector<float> maxs;
+    QBitArray chunkReady;
+    QBitArray chunkRequested;
+};
+
+#endif // DERIVEDCHANNEL_H
@@ -12,13 +12,20 @@
 #include <QVBoxLayout>
 #include <QPainter>
 #include "label.h"
-
-// Static member variables for color mapping, custom plots, vertical lines, and selection rectangle
+#include <cmath>
+#include <algorithm>
+#include <type_traits>
+#include "ReplotScheduler.h"
+#include "PlotSyncGroup.h"
+#include "SignalStats.h"
+#include "PlotProfiler.h"
+
+// Power range (dB) covered by the quantization levels of engine spectrograms
+const double KinematicVisualizer::spectrogramMinLevel = -120.0;
+const double KinematicVisualizer::spectrogramMaxLevel = 160.0;
+
+// Static member variable for color mapping
 QMap<QString, QColor> KinematicVisualizer::colorMap;
-QList<QCustomPlot*> KinematicVisualizer::customPlots;
-QMap<QCustomPlot*, QCPItemLine*> KinematicVisualizer::vLinesMap;
-QCustomPlot* KinematicVisualizer::lastPlotWithLine = nullptr;
-QCPItemRect* KinematicVisualizer::selectionRect = nullptr;  // Initialize selection rectangle
 
 // Function to generate a random color within a specific range
 QColor KinematicVisualizer::generateRandomColor() {
@@ -32,7 +39,22 @@ QColor KinematicVisualizer::generateRandomColor() {
 
 // Constructor
 KinematicVisualizer::KinematicVisualizer(QWidget *parent)
-        : QWidget(parent), customPlot(new QCustomPlot(this)), selecting(false), label(new Label(customPlot)) {
+        : QWidget(parent), customPlot(new QCustomPlot(this)), selecting(false),
+          label(new Label(customPlot)), signalSamplingRate(1), waveformRendering(false), showAllChannelValues(false),
+          cursorSnap(false), cursorSnapRadius(12), landmarkKinds(SignalLandmarks::AllKinds),
+          externalStreamWriter(false), streamAppended(false), streamGeneration(0),
+          streamPenWidth(1), followTail(false), streamDirty(false), streamEndTime(0),
+          streamMin(std::numeric_limits<double>::max()), streamMax(std::numeric_limits<double>::lowest()),
+          streamTimer(new QTimer(this)), spectrogramEngine(new SpectrogramEngine(this)), spectrogramMap(nullptr),
+          spectrogramPeak(std::numeric_limits<float>::lowest()), spectrogramRaster(nullptr), spectrogramQuantizationBits(0),
+          spectrogramTiles(new SpectrogramTileCache(this)), spectrogramTiling(false),
+          spectrogramTilePeak(std::numeric_limits<float>::lowest()), signalLoader(new SignalLoader(this)),
+          pendingPenWidth(1), pendingSpectrogram(false), pyramidLoader(new SignalLoader(this)), mappedInitialSpan(10),
+          viewCacheEnabled(false), viewCacheVerification(false),
+          profilerHud(nullptr), profilerHudTimer(new QTimer(this)), autoscaleY(false), derivedGeneration(0),
+          filterStage(new SignalFilterStage(this)), adaptiveQuality(false), draftQuality(false),
+          qualityTimer(new QTimer(this)), fullQualityNotAntialiased(QCP::aeNone), fullQualityLegendVisible(false),
+          selectionReadout(nullptr), selectionReadoutVisible(false) {
 
     // Set up layout
     QVBoxLayout *layout = new QVBoxLayout(this);
@@ -50,6 +72,31 @@ KinematicVisualizer::KinematicVisualizer(QWidget *parent)
     connect(customPlot, &QCustomPlot::mouseMove, this, &KinematicVisualizer::onMouseDrag);
     connect(customPlot->xAxis, SIGNAL(rangeChanged(QCPRange)), this, SLOT(synchronizePlots(QCPRange)));
 
+    // Streamed samples are published at display rate, not per append
+    streamTimer->setInterval(16);
+    connect(streamTimer, &QTimer::timeout, this, &KinematicVisualizer::onStreamFrame);
+
+    // Spectrogram frames arrive from the engine in blocks
+    connect(spectrogramEngine, &SpectrogramEngine::framesReady, this, &KinematicVisualizer::onSpectrogramFramesReady);
+    connect(spectrogramEngine, &SpectrogramEngine::finished, this, &KinematicVisualizer::onSpectrogramFinished);
+    connect(spectrogramTiles, &SpectrogramTileCache::tileReady, this, &KinematicVisualizer::onSpectrogramTileReady);
+
+    // Background loads report progress and are swapped in when complete
+    connect(signalLoader, &SignalLoader::progress, this, &KinematicVisualizer::loadingProgress);
+    connect(signalLoader, &SignalLoader::finished, this, &KinematicVisualizer::onLoadFinished);
+    connect(pyramidLoader, &SignalLoader::finished, this, &KinematicVisualizer::onPyramidsReady);
+    connect(filterStage, &SignalFilterStage::ready, this, &KinematicVisualizer::onFilterReady);
+
+    // Full quality returns once the view stopped changing
+    qualityTimer->setSingleShot(true);
+    qualityTimer->setInterval(150);
+    connect(qualityTimer, &QTimer::timeout, this, &KinematicVisualizer::onInteractionIdle);
+
+    // Replots of this plot are timed while the profiler is on
+    PlotProfiler::instance()->watch(customPlot);
+    profilerHudTimer->setInterval(500);
+    connect(profilerHudTimer, &QTimer::timeout, this, &KinematicVisualizer::onProfilerHudTimer);
+
     // Enable mouse tracking
     setMouseTracking(true);
     customPlot->setMouseTracking(true);
@@ -57,9 +104,9 @@ KinematicVisualizer::KinematicVisualizer(QWidget *parent)
     // Install event filter
     customPlot->installEventFilter(this);
 
-    // Add the custom plot to the list and synchronize Y-axes
-    customPlots.append(customPlot);
+    // Create the cursor items and join the default group until the caller assigns one
     setupCursorItems(customPlot);
+    setSyncGroup(PlotSyncGroup::defaultGroup());
 
     // Ensure xAxis2 (top axis) is configured properly
     customPlot->xAxis2->setVisible(false);
@@ -86,15 +133,14 @@ void KinematicVisualizer::setupCursorItems(QCustomPlot *plot) {
         plot->addLayer("textOverlay", plot->layer("overlay"), QCustomPlot::limAbove);
     }
 
-    // Create and configure the vertical line
-    QCPItemLine *vLine = new QCPItemLine(plot);
+    // Create and configure the vertical line, shared with the sync group as this plot's cursor
+    vLine = new QCPItemLine(plot);
     vLine->setLayer("overlay");
     vLine->setPen(QPen(Qt::red, 1, Qt::DotLine));
     vLine->start->setType(QCPItemPosition::ptPlotCoords);
     vLine->end->setType(QCPItemPosition::ptPlotCoords);
     vLine->setSelectable(false);
     vLine->setVisible(false);
-    vLinesMap[plot] = vLine;
 
     if (plot == customPlot) {
         // Create and configure the horizontal line, coordinate text, and frame for the main plot
@@ -131,12 +177,14 @@ void KinematicVisualizer::setupCursorItems(QCustomPlot *plot) {
 // Event filter for handling mouse move, enter, and leave events
 bool KinematicVisualizer::eventFilter(QObject *object, QEvent *event) {
     if (event->type() == QEvent::MouseMove) {
+        PlotProfiler::instance()->countEvent("mouse moves");
         QMouseEvent *mouseEvent = static_cast<QMouseEvent*>(event);
         cursorPos = mouseEvent->pos();
         if (QCustomPlot *plot = qobject_cast<QCustomPlot*>(object)) {
+            PlotProfiler::Scope scope("cursor", plot);
             updateCursorItems(plot);
         }
-        if (selecting && selectionRect) {
+        if (selecting) {
             onMouseDrag();  // Update selection rectangle while dragging
         }
         return true;
@@ -144,6 +192,10 @@ bool KinematicVisualizer::eventFilter(QObject *object, QEvent *event) {
         hideAllVerticalLines();
         hideHorizontalCursor();
         return true;
+    } else if (event->type() == QEvent::Resize) {
+        // A different width needs a different pyramid level; let the plot handle the resize itself
+        updateSignalLevelOfDetail();
+        return false;
     } else if (event->type() == QEvent::Enter) {
         if (QCustomPlot *plot = qobject_cast<QCustomPlot*>(object)) {
             updateCursorItems(plot);
@@ -165,30 +217,14 @@ void KinematicVisualizer::updateCursorItems(QCustomPlot *plot) {
         // Use the y-axis position of the mouse for the spectrogram
         y = plot->yAxis->pixelToCoord(cursorPos.y());
     } else {
-        // Extract the corresponding Y value from the signal data
+        // Extract the corresponding Y value from the signal data, at the landmark if the cursor is on one
+        x = snapCursorToLandmark(plot, x);
         y = getYValueFromSignal(x);
     }
 
-    // Hide all vertical lines
-    hideAllVerticalLines();
-
-    // Update vertical line position for the current plot
-    QCPItemLine *vLine = vLinesMap[plot];
-    vLine->start->setCoords(x, plot->yAxis->range().lower);
-    vLine->end->setCoords(x, plot->yAxis->range().upper);
-    vLine->setVisible(true);
-
     // Update horizontal line and coordinate text for the main plot
     if (plot == customPlot) {
-        double adjustedY = y;
-
-        if (trackedParameter == "X") {
-            adjustedY += signalOffsets.value("X", 0.0);
-        } else if (trackedParameter == "Y") {
-            adjustedY += signalOffsets.value("Y", 0.0);
-        } else if (trackedParameter == "Z") {
-            adjustedY += signalOffsets.value("Z", 0.0);
-        }
+        double adjustedY = y + signalOffsets.value(trackedParameter, 0.0);
 
         if (cursorPos.y() >= 0 && cursorPos.y() <= plot->height()) {
             hLine->start->setCoords(plot->xAxis->range().lower, adjustedY);
@@ -199,18 +235,43 @@ void KinematicVisualizer::updateCursorItems(QCustomPlot *plot) {
         }
 
         // Update coordinate text
-        QString coordStr = QString("X: %1\nY: %2").arg(x).arg(y);
+        QString xStr = QString("X: %1").arg(x);
+        if (cursorLandmark.isValid()) {
+            xStr += QString(" (%1)").arg(SignalLandmarks::kindName(cursorLandmark.kind));
+        }
+        QString coordStr = QString("%1\nY: %2").arg(xStr).arg(y);
+        int lineCount = 2;
+        if (showAllChannelValues && !cursorChannels.isEmpty()) {
+            // One line per channel, all resolved in a single pass over the store
+            cursorChannels.valuesAt(x, cursorValues);
+            coordStr = xStr;
+            for (int i = 0; i < cursorValues.size(); ++i) {
+                coordStr += QString("\n%1: %2").arg(cursorChannelNames[i]).arg(cursorValues[i]);
+            }
+            lineCount = cursorValues.size() + 1;
+
+            // Derived channels follow, read from their window or computed for the one sample
+            for (auto it = derivedTracks.constBegin(); it != derivedTracks.constEnd(); ++it) {
+                const DerivedChannel &channel = it.value().channel;
+                if (!it.value().graph || !channel.isValid()) {
+                    continue;
+                }
+                double index = qBound(0.0, std::round(x * it.value().samplingRate), channel.size() - 1.0);
+                coordStr += QString("\n%1: %2").arg(it.key()).arg(channel.valueAt(static_cast<int>(index)));
+                ++lineCount;
+            }
+        }
         coordText->setText(coordStr);
 
-        // Calculate text bounding rectangle based only on the X-axis value
-        QString xCoordStr = QString("X: %1").arg(x);
+        // Calculate text bounding rectangle based only on the X-axis value (all lines for the full readout)
         QFontMetrics fm(coordText->font());
-        QRect textRect = fm.boundingRect(xCoordStr);
+        QRect textRect = (lineCount > 2) ? fm.boundingRect(QRect(), Qt::AlignLeft, coordStr)
+                                         : fm.boundingRect(xStr);
 
         // Update coordinate frame size based on the text width for the X-axis value
         const int padding = 5; // Optional padding to increase frame size
         const int frameWidth = textRect.width() + padding * 2;
-        const int frameHeight = fm.height() * 2 + padding;
+        const int frameHeight = fm.height() * lineCount + padding;
 
         coordFrame->topLeft->setPixelPosition(QPoint(cursorPos.x() + 20 - padding, cursorPos.y() - padding));
         coordFrame->bottomRight->setPixelPosition(QPoint(cursorPos.x() + 20 + frameWidth, cursorPos.y() + frameHeight));
@@ -220,22 +281,92 @@ void KinematicVisualizer::updateCursorItems(QCustomPlot *plot) {
         coordText->position->setPixelPosition(QPoint(cursorPos.x() + 20, cursorPos.y()));
         coordText->setVisible(true);
 
-        // Replot only the text overlay layer
-        customPlot->layer("textOverlay")->replot();
+        // Repaint only the text overlay layer, once per frame however often the mouse moves
+        ReplotScheduler::instance()->requestLayerReplot(customPlot, "textOverlay");
     }
 
-    // Update vertical line in all plots
+    // Update vertical line in all plots of the group
     updateVerticalLineInAllPlots(x);
 }
 
-// Hide all vertical lines in all plots
-void KinematicVisualizer::hideAllVerticalLines() {
-    for (QCustomPlot *plot : customPlots) {
-        QCPItemLine *vLine = vLinesMap[plot];
-        if (vLine) {
-            vLine->setVisible(false);
-        }
+// Function to snap the cursor x to a landmark of the tracked channel
+double KinematicVisualizer::snapCursorToLandmark(QCustomPlot *plot, double x) {
+    auto trackIt = signalTracks.constFind(trackedParameter);
+    if (plot != customPlot || trackIt == signalTracks.constEnd() || trackIt.value().landmarks.isEmpty()) {
+        cursorLandmark = SignalLandmarks::Landmark();
+        return x;
+    }
+    const SignalTrack &track = trackIt.value();
+
+    // A landmark reached by navigation stays while the cursor has not left its pixel
+    if (cursorLandmark.isValid()
+        && qRound(plot->xAxis->coordToPixel(cursorLandmark.index / track.samplingRate)) == cursorPos.x()) {
+        return cursorLandmark.index / track.samplingRate;
+    }
+    cursorLandmark = SignalLandmarks::Landmark();
+    if (!cursorSnap) {
+        return x;
+    }
+
+    SignalLandmarks::Landmark nearest = track.landmarks.nearest(x * track.samplingRate, landmarkKinds);
+    if (!nearest.isValid()) {
+        return x;
+    }
+    double landmarkX = nearest.index / track.samplingRate;
+    if (std::abs(plot->xAxis->coordToPixel(landmarkX) - cursorPos.x()) > cursorSnapRadius) {
+        return x;
+    }
+    cursorLandmark = nearest;
+    return landmarkX;
+}
+
+// Function to move the cursor to the next or previous landmark of the tracked channel
+void KinematicVisualizer::stepLandmark(bool forward) {
+    auto trackIt = signalTracks.constFind(trackedParameter);
+    if (trackIt == signalTracks.constEnd()) {
+        return;
+    }
+    const SignalTrack &track = trackIt.value();
+
+    // Steps start at the landmark the cursor is on, so landmarks sharing a pixel are not skipped
+    double position = cursorLandmark.isValid() ? cursorLandmark.index
+                                               : customPlot->xAxis->pixelToCoord(cursorPos.x()) * track.samplingRate;
+    SignalLandmarks::Landmark target = forward ? track.landmarks.next(position, landmarkKinds)
+                                               : track.landmarks.previous(position, landmarkKinds);
+    if (!target.isValid()) {
+        return;
     }
+
+    // Center the landmark if it lies outside the view, keeping the zoom
+    double targetX = target.index / track.samplingRate;
+    QCPRange range = customPlot->xAxis->range();
+    if (!range.contains(targetX)) {
+        customPlot->xAxis->setRange(targetX - range.size() / 2, targetX + range.size() / 2);
+        ReplotScheduler::instance()->requestReplot(customPlot);
+    }
+
+    cursorLandmark = target;
+    QRect area = customPlot->axisRect()->rect();
+    cursorPos.setX(qRound(customPlot->xAxis->coordToPixel(targetX)));
+    if (!area.contains(area.center().x(), cursorPos.y())) {
+        cursorPos.setY(area.center().y());
+    }
+    updateCursorItems(customPlot);
+}
+
+// Slot to move the cursor to the next landmark
+void KinematicVisualizer::goToNextLandmark() {
+    stepLandmark(true);
+}
+
+// Slot to move the cursor to the previous landmark
+void KinematicVisualizer::goToPreviousLandmark() {
+    stepLandmark(false);
+}
+
+// Hide the vertical lines in all plots of the group
+void KinematicVisualizer::hideAllVerticalLines() {
+    syncGroup->hideCursor();
 }
 
 // Hide the horizontal cursor and coordinate items
@@ -243,33 +374,261 @@ void KinematicVisualizer::hideHorizontalCursor() {
     hLine->setVisible(false);
     coordText->setVisible(false);
     coordFrame->setVisible(false);
-    customPlot->layer("textOverlay")->replot();
+    ReplotScheduler::instance()->requestLayerReplot(customPlot, "textOverlay");
 }
 
-// Update the vertical line position in all plots
+// Update the vertical line position in all plots of the group
 void KinematicVisualizer::updateVerticalLineInAllPlots(double x) {
-    for (QCustomPlot *plot : customPlots) {
-        QCPItemLine *vLine = vLinesMap[plot];
-        if (vLine) {
-            vLine->start->setCoords(x, plot->yAxis->range().lower);
-            vLine->end->setCoords(x, plot->yAxis->range().upper);
-            vLine->setVisible(true);
-            plot->layer("overlay")->replot();
-        }
-    }
+    syncGroup->setCursor(x);
 }
 
 // Destructor
 KinematicVisualizer::~KinematicVisualizer() {
-    customPlots.removeAll(customPlot);
+    if (syncGroup) {
+        syncGroup->leave(customPlot);
+    }
+    // Envelope workers must not outlive the widget they report to
+    derivedPool.clear();
+    derivedPool.waitForDone();
+}
+
+// Function to switch the y-axis between the whole recording and the visible data
+void KinematicVisualizer::setAutoscaleY(bool enabled) {
+    autoscaleY = enabled;
+    if (autoscaleY) {
+        updateAutoscaleY();
+    } else if (!signalTracks.isEmpty()) {
+        // Back to the range of the whole recording, as applied at load
+        customPlot->yAxis->setRange(fixedYRange);
+    }
+    ReplotScheduler::instance()->requestReplot(customPlot);
+}
+
+// Function to center the channels and fit the fixed y-range to the stats of the shown samples
+void KinematicVisualizer::updateSignalLayout() {
+    double globalMin = std::numeric_limits<double>::max();
+    double globalMax = std::numeric_limits<double>::lowest();
+    for (const SignalTrack &track : signalTracks) {
+        if (track.stats.valid) {
+            globalMin = qMin(globalMin, track.stats.minValue);
+            globalMax = qMax(globalMax, track.stats.maxValue);
+        }
+    }
+    if (globalMin > globalMax) {
+        return;
+    }
+
+    // Align the center of every channel with the center of the global range
+    double globalCenter = (globalMax + globalMin) / 2;
+    for (auto it = signalTracks.begin(); it != signalTracks.end(); ++it) {
+        SignalTrack &track = it.value();
+        if (track.stats.valid) {
+            track.offset = globalCenter - track.stats.center();
+            signalOffsets[it.key()] = track.offset;
+        }
+        if (track.waveform) {
+            track.waveform->setSignal(track.samples, track.pyramid, track.samplingRate, track.offset);
+        }
+    }
+
+    // Add padding to the Y-axis range
+    double padding = (globalMax - globalMin) * 0.1; // 10% padding
+    if (padding == 0) { // Handle case where globalMax == globalMin
+        padding = 1; // Set a default padding value
+    }
+    fixedYRange = QCPRange(globalMin - padding, globalMax + padding);
+
+    updateSignalLevelOfDetail();
+    if (autoscaleY) {
+        updateAutoscaleY();
+    } else {
+        customPlot->yAxis->setRange(fixedYRange);
+    }
+}
+
+// Function to fit the y-axis to the samples of the visible x-range
+void KinematicVisualizer::updateAutoscaleY() {
+    if (signalTracks.isEmpty() || signalSamplingRate <= 0) {
+        return;
+    }
+    PlotProfiler::Scope scope("autoscale", customPlot);
+
+    QCPRange range = customPlot->xAxis->range();
+    double visibleMin = std::numeric_limits<double>::max();
+    double visibleMax = std::numeric_limits<double>::lowest();
+    for (const SignalTrack &track : signalTracks) {
+        // Without its pyramid, a mapped track would be read in full; it joins once the pyramid is there
+        if (track.samples.isEmpty() || track.pyramidPending) {
+            continue;
+        }
+        int first = static_cast<int>(std::floor(range.lower * track.samplingRate));
+        int last = static_cast<int>(std::ceil(range.upper * track.samplingRate));
+        double trackMin;
+        double trackMax;
+        if (track.pyramid.rangeMinMax(track.samples, first, last, trackMin, trackMax)) {
+            visibleMin = qMin(visibleMin, trackMin + track.offset);
+            visibleMax = qMax(visibleMax, trackMax + track.offset);
+        }
+    }
+    if (visibleMin > visibleMax) {
+        return;
+    }
+
+    // Same padding as the initial range
+    double padding = (visibleMax - visibleMin) * 0.1;
+    if (padding == 0) {
+        padding = 1;
+    }
+    customPlot->yAxis->setRange(visibleMin - padding, visibleMax + padding);
+}
+
+// Function to choose between line graphs and column-raster waveforms for recorded channels
+void KinematicVisualizer::setWaveformRendering(bool enabled) {
+    waveformRendering = enabled;
+}
+
+// Function to switch interaction-time render quality on or off
+void KinematicVisualizer::setAdaptiveQuality(bool enabled, int idleMilliseconds) {
+    adaptiveQuality = enabled;
+    qualityTimer->setInterval(qMax(0, idleMilliseconds));
+    if (!enabled) {
+        qualityTimer->stop();
+        setDraftQuality(false);
+    }
+}
+
+// Function to note one step of an interaction; a single change keeps full quality, changes that
+// follow each other within the idle time are drawn in draft quality
+void KinematicVisualizer::noteInteraction() {
+    if (!adaptiveQuality) {
+        return;
+    }
+    if (qualityTimer->isActive()) {
+        setDraftQuality(true);
+    }
+    qualityTimer->start();
 }
 
-// Synchronize the Y-axes of all plots
+// Slot to redraw at full quality after the last interaction step
+void KinematicVisualizer::onInteractionIdle() {
+    setDraftQuality(false);
+}
+
+// Function to swap between draft and full-quality drawing of the graphs
+void KinematicVisualizer::setDraftQuality(bool draft) {
+    if (draft == draftQuality) {
+        return;
+    }
+    draftQuality = draft;
+
+    if (draft) {
+        // Wide antialiased pens are the slowest path of the raster engine; one-pixel aliased lines the fastest
+        for (int i = 0; i < customPlot->graphCount(); ++i) {
+            QCPGraph *graph = customPlot->graph(i);
+            QPen pen = graph->pen();
+            if (pen.width() > 1 || pen.style() != Qt::SolidLine) {
+                fullQualityPens.insert(graph, pen);
+                pen.setWidth(1);
+                pen.setStyle(Qt::SolidLine);
+                graph->setPen(pen);
+            }
+        }
+        fullQualityNotAntialiased = customPlot->notAntialiasedElements();
+        customPlot->setNotAntialiasedElements(QCP::aeAll);
+        fullQualityLegendVisible = customPlot->legend->visible();
+        customPlot->legend->setVisible(false);
+        return;
+    }
+
+    // Graphs added meanwhile were never changed; removed ones left the map when they were removed
+    for (int i = 0; i < customPlot->graphCount(); ++i) {
+        QCPGraph *graph = customPlot->graph(i);
+        auto it = fullQualityPens.constFind(graph);
+        if (it != fullQualityPens.constEnd()) {
+            graph->setPen(it.value());
+        }
+    }
+    fullQualityPens.clear();
+    customPlot->setNotAntialiasedElements(fullQualityNotAntialiased);
+    customPlot->legend->setVisible(fullQualityLegendVisible);
+    ReplotScheduler::instance()->requestReplot(customPlot);
+}
+
+// Function to show or hide the profiler digest in the corner of the plot
+void KinematicVisualizer::setProfilerHudVisible(bool visible) {
+    if (visible && !profilerHud) {
+        profilerHud = new QCPItemText(customPlot);
+        profilerHud->setLayer("textOverlay");
+        profilerHud->position->setType(QCPItemPosition::ptAxisRectRatio);
+        profilerHud->position->setCoords(0.01, 0.02);
+        profilerHud->setPositionAlignment(Qt::AlignLeft | Qt::AlignTop);
+        profilerHud->setTextAlignment(Qt::AlignLeft);
+        profilerHud->setFont(QFont("Monospace", 8));
+        profilerHud->setColor(Qt::black);
+        profilerHud->setBrush(QBrush(QColor(255, 255, 255, 200)));
+        profilerHud->setPadding(QMargins(4, 2, 4, 2));
+        profilerHud->setSelectable(false);
+    }
+    if (profilerHud) {
+        profilerHud->setVisible(visible);
+    }
+
+    // The HUD needs data, so showing it switches the profiler on; hiding it leaves the profiler as is
+    if (visible) {
+        PlotProfiler::instance()->setEnabled(true);
+        onProfilerHudTimer();
+        profilerHudTimer->start();
+    } else {
+        profilerHudTimer->stop();
+        ReplotScheduler::instance()->requestLayerReplot(customPlot, "textOverlay");
+    }
+}
+
+// Slot to refresh the profiler digest
+void KinematicVisualizer::onProfilerHudTimer() {
+    if (!profilerHud) {
+        return;
+    }
+    profilerHud->setText(PlotProfiler::instance()->summary());
+    ReplotScheduler::instance()->requestLayerReplot(customPlot, "textOverlay");
+}
+
+// Function to move the plot into another sync group
+void KinematicVisualizer::setSyncGroup(PlotSyncGroup *group) {
+    if (!group) {
+        group = PlotSyncGroup::defaultGroup();
+    }
+    if (group == syncGroup) {
+        return;
+    }
+
+    if (syncGroup) {
+        syncGroup->leave(customPlot);
+        disconnect(syncGroup, nullptr, this, nullptr);
+    }
+    syncGroup = group;
+    syncGroup->join(customPlot, vLine);
+    connect(syncGroup, &PlotSyncGroup::selectionChanged, this, &KinematicVisualizer::onSelectionChanged);
+
+    // A deleted group hands its plots back to the default group
+    connect(syncGroup, &QObject::destroyed, this, [this]() {
+        syncGroup = nullptr;
+        setSyncGroup(PlotSyncGroup::defaultGroup());
+    });
+}
+
+// Function to get the sync group of the plot
+PlotSyncGroup* KinematicVisualizer::getSyncGroup() const {
+    return syncGroup;
+}
+
+// Synchronize the Y-axes of all plots in the group
 void KinematicVisualizer::synchronizeYAxes() {
-    if (customPlots.size() < 2) return;
+    QList<QCustomPlot*> plots = syncGroup->plots();
+    if (plots.size() < 2) return;
 
-    QCustomPlot *referencePlot = customPlots.first();
-    for (QCustomPlot *plot : customPlots) {
+    QCustomPlot *referencePlot = plots.first();
+    for (QCustomPlot *plot : plots) {
         if (plot != referencePlot) {
             connect(referencePlot->xAxis, SIGNAL(rangeChanged(QCPRange)), plot->xAxis, SLOT(setRange(QCPRange)));
             connect(plot->xAxis, SIGNAL(rangeChanged(QCPRange)), referencePlot->xAxis, SLOT(setRange(QCPRange)));
@@ -285,7 +644,7 @@ void KinematicVisualizer::mouseMoveEvent(QMouseEvent *event) {
     if (customPlot->viewport().contains(event->pos())) {
         cursorPos = event->pos(); // Update cursor position
         updateCursorItems(customPlot);
-        if (selecting && selectionRect) {
+        if (selecting) {
             onMouseDrag();
         }
     }
@@ -293,42 +652,11 @@ void KinematicVisualizer::mouseMoveEvent(QMouseEvent *event) {
 
 // Function to get Y value from the signal data based on the X value
 double KinematicVisualizer::getYValueFromSignal(double x) {
-    QVector<QPair<double, double>> *signalData = nullptr;
-
-    if (trackedParameter == "X") {
-        signalData = &signalDataX;
-    } else if (trackedParameter == "Y") {
-        signalData = &signalDataY;
-    } else if (trackedParameter == "Z") {
-        signalData = &signalDataZ;
-    }
-
-    if (!signalData || signalData->isEmpty()) {
-        return 0.0;
-    }
-
-    auto it = std::lower_bound(signalData->begin(), signalData->end(), x,
-                               [](const QPair<double, double> &a, double value) {
-                                   return a.first < value;
-                               });
-
-    if (it == signalData->end()) {
-        return signalData->last().second;
-    } else if (it == signalData->begin()) {
-        return signalData->first().second;
-    } else {
-        auto prevIt = std::prev(it);
-        double x1 = prevIt->first;
-        double y1 = prevIt->second;
-        double x2 = it->first;
-        double y2 = it->second;
-
-        if (x2 - x1 == 0) {
-            return y1;
-        } else {
-            return y1 + (y2 - y1) * (x - x1) / (x2 - x1);
-        }
+    PlotProfiler::Scope scope("cursor lookup", customPlot);
+    if (streamTracks.contains(trackedParameter)) {
+        return streamSnapshot.channel(trackedParameter).valueAt(x);
     }
+    return cursorChannels.valueAt(trackedParameter, x);
 }
 
 // Paint event handler
@@ -351,8 +679,240 @@ double KinematicVisualizer::getXAxisMaxLimit() const {
     return xAxisMaxLimit;
 }
 
+// Function to wrap double channels into sample buffers sharing their data
+static QMap<QString, SampleBuffer> toSampleBuffers(const QMap<QString, QVector<double>> &dataMap) {
+    QMap<QString, SampleBuffer> channels;
+    for (auto it = dataMap.cbegin(); it != dataMap.cend(); ++it) {
+        channels.insert(it.key(), SampleBuffer(it.value()));
+    }
+    return channels;
+}
+
 // Function to visualize a signal with provided data
 void KinematicVisualizer::visualizeSignal(const QMap<QString, QVector<double>> &dataMap, const QString &configName, int penWidth, int samplingRate) {
+    // Wrapping the map only shares the sample buffers, no samples are duplicated
+    visualizeSignal(toSampleBuffers(dataMap), configName, penWidth, samplingRate);
+}
+
+// Function to visualize a signal, taking over the provided sample buffers
+void KinematicVisualizer::visualizeSignal(QMap<QString, QVector<double>> &&dataMap, const QString &configName, int penWidth, int samplingRate) {
+    QMap<QString, SampleBuffer> channels = toSampleBuffers(dataMap);
+    dataMap.clear();   // The buffers are now referenced only by the channels
+    visualizeSignal(channels, configName, penWidth, samplingRate);
+}
+
+// Function to visualize typed channels, kept in their native sample type
+void KinematicVisualizer::visualizeSignal(const QMap<QString, SampleBuffer> &channels, const QString &configName, int penWidth, int samplingRate) {
+    PreparedSignal prepared;
+    prepareSignal(channels, samplingRate, prepared);
+    applySignal(std::move(prepared), configName, penWidth);
+}
+
+// Function to visualize channels that each have their own sampling rate
+void KinematicVisualizer::visualizeSignal(const QMap<QString, SampleBuffer> &channels, const QMap<QString, double> &samplingRates,
+                                          const QString &configName, int penWidth, double defaultRate) {
+    PreparedSignal prepared;
+    prepareSignal(channels, samplingRates, defaultRate, prepared);
+    applySignal(std::move(prepared), configName, penWidth);
+}
+
+// Function to overlay repeated tokens aligned to a reference token
+void KinematicVisualizer::visualizeTokenOverlay(const QVector<AlignmentToken> &tokens, const QStringList &alignmentChannels,
+                                                const QString &configName, int penWidth, const QStringList &displayChannels) {
+    TokenAlignment alignment;
+    {
+        PlotProfiler::Scope scope("token alignment", customPlot);
+        alignment = tokenAligner.align(tokens, alignmentChannels);
+    }
+    if (alignment.reference < 0) {
+        return;
+    }
+
+    // Every token is drawn on the time axis and at the rate of the reference
+    double rate = tokens[alignment.reference].samplingRate;
+    const QStringList shown = displayChannels.isEmpty() ? alignmentChannels : displayChannels;
+    QMap<QString, SampleBuffer> channels;
+    for (int t = 0; t < tokens.size(); ++t) {
+        for (const QString &channel : shown) {
+            SampleBuffer warped = warpChannel(tokens[t], channel, alignment, t, rate);
+            if (!warped.isEmpty()) {
+                channels.insert(tokens[t].name + " " + channel, warped);
+            }
+        }
+    }
+    visualizeSignal(channels, QMap<QString, double>(), configName, penWidth, rate);
+    tokenAlignment = alignment;
+}
+
+// Function to get the alignment of the shown token overlay
+TokenAlignment KinematicVisualizer::getTokenAlignment() const {
+    return tokenAlignment;
+}
+
+// Function to visualize a memory-mapped recording without reading it up front
+void KinematicVisualizer::visualizeMappedSignal(const QSharedPointer<MappedSignalFile> &file, const QString &configName, int penWidth) {
+    if (!file) {
+        return;
+    }
+
+    double rate = file->samplingRate();
+    double span = mappedInitialSpan;
+    int windowSamples = static_cast<int>(qMin<double>(file->samplesPerChannel(), std::ceil(span * rate) + 1));
+
+    // Only the initial window is scanned for the value range and offsets
+    PreparedSignal prepared;
+    prepared.samplingRate = rate;
+    prepared.initialSpan = span;
+    prepared.globalMin = std::numeric_limits<double>::max();
+    prepared.globalMax = std::numeric_limits<double>::lowest();
+    QMap<QString, SampleBuffer> channels;
+    QStringList names = file->channelNames();
+    for (int i = 0; i < names.size(); ++i) {
+        PreparedChannel channel;
+        channel.name = names[i];
+        channel.samples = file->channel(i);
+        channel.samplingRate = rate;
+        channel.stats = computeSignalStats(channel.samples, 0, windowSamples);
+        if (!channel.stats.valid) {
+            continue;
+        }
+        prepared.globalMin = qMin(prepared.globalMin, channel.stats.minValue);
+        prepared.globalMax = qMax(prepared.globalMax, channel.stats.maxValue);
+        prepared.maxTime = qMax(prepared.maxTime, (channel.samples.size() - 1) / rate);
+        channels.insert(channel.name, channel.samples);
+        prepared.channels.append(std::move(channel));
+    }
+    applySignal(std::move(prepared), configName, penWidth);
+
+    // A summary cached by an earlier session replaces the pass over the file
+    if (viewCacheEnabled) {
+        PreparedSignal summary;
+        if (SignalViewCache::loadSignal(file, summary)) {
+            applyPyramids(summary);
+
+            // Contents changed behind an unchanged key are summarized again once found
+            if (viewCacheVerification) {
+                viewCacheShown = file;
+                viewCache.verifySignal(file, this, [this, file, channels, rate]() {
+                    if (viewCacheShown != file) {
+                        return;
+                    }
+                    viewCacheShown.reset();
+                    viewCacheSource = file;
+                    pyramidLoader->loadSignal(channels, rate);
+                });
+            }
+            return;
+        }
+        viewCacheSource = file;
+    }
+
+    // The whole file is summarized in the background, one sequential read per channel
+    pyramidLoader->loadSignal(channels, rate);
+}
+
+// Function to set the span shown first for mapped recordings
+void KinematicVisualizer::setMappedInitialSpan(double seconds) {
+    mappedInitialSpan = seconds > 0 ? seconds : 10;
+}
+
+// Function to switch the view cache on or off
+void KinematicVisualizer::setViewCacheEnabled(bool enabled) {
+    viewCacheEnabled = enabled;
+}
+
+// Function to switch the background check of cached summaries on or off
+void KinematicVisualizer::setViewCacheVerification(bool enabled) {
+    viewCacheVerification = enabled;
+}
+
+// Slot to hand the background pyramids of a mapped recording to its tracks
+void KinematicVisualizer::onPyramidsReady() {
+    PreparedSignal summary = pyramidLoader->takeSignal();
+    if (viewCacheSource) {
+        viewCache.storeSignal(viewCacheSource, summary);
+        viewCacheSource.reset();
+    }
+    applyPyramids(summary);
+}
+
+// Function to hand the pyramids and indexes of a summary to the tracks of the same channels
+void KinematicVisualizer::applyPyramids(PreparedSignal &summary) {
+    for (PreparedChannel &channel : summary.channels) {
+        auto it = signalTracks.find(channel.name);
+        if (it == signalTracks.end()) {
+            continue;
+        }
+        SignalTrack &track = it.value();
+        track.raw.pyramid = std::move(channel.pyramid);
+        track.raw.rangeIndex = std::move(channel.rangeIndex);
+        track.raw.landmarks = std::move(channel.landmarks);
+        track.raw.stats = channel.stats;   // Whole recording, the load only scanned its start
+
+        // A filtered channel shown meanwhile came with its own pyramid and stats
+        if (track.pyramidPending) {
+            track.pyramid = track.raw.pyramid;
+            track.rangeIndex = track.raw.rangeIndex;
+            track.landmarks = track.raw.landmarks;
+            track.stats = track.raw.stats;
+            track.pyramidPending = false;
+        }
+    }
+
+    // Offsets and the y-range were derived from the start of the recording; the full range may be wider
+    updateSignalLayout();
+    ReplotScheduler::instance()->requestReplot(customPlot);
+}
+
+// Function to prepare a signal on a worker thread and show it once ready
+void KinematicVisualizer::visualizeSignalAsync(const QMap<QString, QVector<double>> &dataMap, const QString &configName, int penWidth, int samplingRate) {
+    visualizeSignalAsync(toSampleBuffers(dataMap), configName, penWidth, samplingRate);
+}
+
+// Function to prepare typed channels on a worker thread and show them once ready
+void KinematicVisualizer::visualizeSignalAsync(const QMap<QString, SampleBuffer> &channels, const QString &configName, int penWidth, int samplingRate) {
+    pendingConfigName = configName;
+    pendingPenWidth = penWidth;
+    pendingSpectrogram = false;
+    signalLoader->loadSignal(channels, samplingRate);
+}
+
+// Function to prepare channels with their own rates on a worker thread and show them once ready
+void KinematicVisualizer::visualizeSignalAsync(const QMap<QString, SampleBuffer> &channels, const QMap<QString, double> &samplingRates,
+                                               const QString &configName, int penWidth, double defaultRate) {
+    pendingConfigName = configName;
+    pendingPenWidth = penWidth;
+    pendingSpectrogram = false;
+    signalLoader->loadSignal(channels, samplingRates, defaultRate);
+}
+
+// Function to prepare a spectrogram matrix on a worker thread and show it once ready
+void KinematicVisualizer::visualizeSpectrogramAsync(const QVector<QVector<double>> &spectrogramData, const QString &configName, double duration) {
+    pendingConfigName = configName;
+    pendingSpectrogram = true;
+    signalLoader->loadSpectrogram(spectrogramData, duration, 5000, spectrogramQuantizationBits);
+}
+
+// Function to cancel a background load; the plot keeps what it shows
+void KinematicVisualizer::cancelLoading() {
+    signalLoader->cancel();
+}
+
+// Slot to swap a finished background load into the plot
+void KinematicVisualizer::onLoadFinished() {
+    if (pendingSpectrogram) {
+        QSharedPointer<PreparedSpectrogram> prepared = signalLoader->takeSpectrogram();
+        if (prepared) {
+            applySpectrogram(*prepared);
+        }
+    } else {
+        applySignal(signalLoader->takeSignal(), pendingConfigName, pendingPenWidth);
+    }
+    emit loadingFinished();
+}
+
+// Function to show a prepared signal; only graphs and axes are set up here
+void KinematicVisualizer::applySignal(PreparedSignal &&prepared, const QString &configName, int penWidth) {
     setupCustomPlot();
     customPlot->setFixedHeight(150);
 
@@ -364,103 +924,93 @@ void KinematicVisualizer::visualizeSignal(const QMap<QString, QVector<double>> &
     customPlot->legend->setFont(legendFont);
     customPlot->legend->setBrush(QBrush(QColor(255, 255, 255, 230)));
 
-    double maxTime = 0;
-
-    signalDataX.clear();
-    signalDataY.clear();
-    signalDataZ.clear();
-
-    // First, determine the global min and max for all data combined
-    double globalMin = std::numeric_limits<double>::max();
-    double globalMax = std::numeric_limits<double>::lowest();
-
-    for (auto it = dataMap.begin(); it != dataMap.end(); ++it) {
-        double localMin = *std::min_element(it.value().begin(), it.value().end());
-        double localMax = *std::max_element(it.value().begin(), it.value().end());
-        if (localMin < globalMin) globalMin = localMin;
-        if (localMax > globalMax) globalMax = localMax;
-    }
-
-    // Calculate the center of the global range
-    double globalCenter = (globalMax + globalMin) / 2;
+    double maxTime = prepared.maxTime;
 
-    for (auto it = dataMap.begin(); it != dataMap.end(); ++it) {
-        QVector<double> x(it.value().size());
-        for (int i = 0; i < it.value().size(); ++i) {
-            x[i] = static_cast<double>(i) / samplingRate;
-        }
+    cursorChannels.clear();
+    signalSamplingRate = prepared.samplingRate;
 
-        QString key = it.key();
+    for (PreparedChannel &channel : prepared.channels) {
+        const QString &key = channel.name;
 
         if (!colorMap.contains(configName + key)) {
             colorMap[configName + key] = generateRandomColor();
         }
         QColor baseColor = colorMap.value(configName + key);
 
-        QCPGraph *graph = customPlot->addGraph();
-        if (graph) {
+        // Line graphs are filled per visible range below, waveform plottables read the samples themselves
+        QCPGraph *graph = nullptr;
+        WaveformPlottable *waveform = nullptr;
+        QCPAbstractPlottable *plottable;
+        if (waveformRendering) {
+            waveform = new WaveformPlottable(customPlot->xAxis, customPlot->yAxis);
+            plottable = waveform;
+        } else {
+            graph = customPlot->addGraph();
+            plottable = graph;
+        }
+        if (plottable) {
             QPen pen(baseColor);
             pen.setWidth(penWidth);
-            graph->setPen(pen);
-            graph->setBrush(Qt::NoBrush);
-            graph->setLineStyle(QCPGraph::lsLine);
+            plottable->setPen(pen);
+            plottable->setBrush(Qt::NoBrush);
+            if (graph) {
+                graph->setLineStyle(QCPGraph::lsLine);
+            }
 
             // Avoid "Audio Audio" label
             if (configName == key) {
-                graph->setName(configName);
+                plottable->setName(configName);
             } else {
-                graph->setName(configName + " " + key);
+                plottable->setName(configName + " " + key);
             }
 
-            // Store the original y-values for use in cursor display
-            QVector<double> originalYValues = it.value();
-
-            // Calculate the local center and the offset to align it with the global center
-            double localMin = *std::min_element(it.value().begin(), it.value().end());
-            double localMax = *std::max_element(it.value().begin(), it.value().end());
-            double localCenter = (localMax + localMin) / 2;
-            double offset = globalCenter - localCenter;
-
-            signalOffsets[key] = offset;  // Store the offset for this signal
-
-            // Apply the offset to the y-values for plotting, but store the original values for cursor display
-            QVector<double> yOffsetValues = it.value();
-            for (int i = 0; i < yOffsetValues.size(); ++i) {
-                yOffsetValues[i] += offset;
-            }
-            graph->setData(x, yOffsetValues);
-
-            // Store signal data for cursor display
-            if (key == "X") {
-                for (int i = 0; i < x.size(); ++i) {
-                    signalDataX.append(qMakePair(x[i], originalYValues[i]));
-                }
-            } else if (key == "Y") {
-                for (int i = 0; i < x.size(); ++i) {
-                    signalDataY.append(qMakePair(x[i], originalYValues[i]));
-                }
-            } else if (key == "Z") {
-                for (int i = 0; i < x.size(); ++i) {
-                    signalDataZ.append(qMakePair(x[i], originalYValues[i]));
-                }
-            }
+            // The graph is filled per visible range from the pyramid, the offset is added there;
+            // offsets follow from the stats of all channels once every track is set up
+            SignalTrack &track = signalTracks[key];
+            track.graph = graph;
+            track.waveform = waveform;
+            track.samples = channel.samples;
+            track.samplingRate = channel.samplingRate;
+            track.stats = channel.stats;
+            track.pyramid = std::move(channel.pyramid);
+            track.rangeIndex = std::move(channel.rangeIndex);
+            track.landmarks = std::move(channel.landmarks);
+            track.pyramidPending = track.pyramid.levelCount() == 1 && track.samples.size() > SignalPyramid::reductionFactor;
+            track.raw.samples = track.samples;
+            track.raw.pyramid = track.pyramid;
+            track.raw.rangeIndex = track.rangeIndex;
+            track.raw.landmarks = track.landmarks;
+            track.raw.stats = track.stats;
+
+            // Share the original values for cursor display
+            cursorChannels.setChannel(key, track.samples, track.samplingRate);
         }
+    }
 
-        if (!x.isEmpty() && x.last() > maxTime) {
-            maxTime = x.last();
-        }
+    // Derived channels follow the new recording
+    for (auto it = derivedTracks.begin(); it != derivedTracks.end(); ++it) {
+        bindDerivedTrack(it.key(), it.value());
     }
 
-    customPlot->xAxis->setRange(0, maxTime);
+    // The raw channels are shown until the current filter has been applied to them
+    QMap<QString, SampleBuffer> rawChannels;
+    QMap<QString, double> samplingRates;
+    for (auto it = signalTracks.cbegin(); it != signalTracks.cend(); ++it) {
+        rawChannels.insert(it.key(), it.value().raw.samples);
+        samplingRates.insert(it.key(), it.value().samplingRate);
+    }
+    aligner.setChannels(rawChannels, samplingRates);
+    filterStage->setSource(rawChannels, samplingRates);
+    if (filterSettings.isActive()) {
+        filterStage->request(filterSettings);
+    }
+
+    customPlot->xAxis->setRange(0, prepared.initialSpan > 0 ? qMin(prepared.initialSpan, maxTime) : maxTime);
     xAxisMinLimit = 0;
     xAxisMaxLimit = maxTime;
 
-    // Add padding to the Y-axis range
-    double padding = (globalMax - globalMin) * 0.1; // 10% padding
-    if (padding == 0) { // Handle case where globalMax == globalMin
-        padding = 1; // Set a default padding value
-    }
-    customPlot->yAxis->setRange(globalMin - padding, globalMax + padding);
+    cursorChannelNames = cursorChannels.channelNames();
+    updateSignalLayout();
 
     // Configure top X-axis for audio
     if (configName == "Audio") {
@@ -479,7 +1029,30 @@ void KinematicVisualizer::visualizeSignal(const QMap<QString, QVector<double>> &
 
 // Function to set up the custom plot with default settings
 void KinematicVisualizer::setupCustomPlot() {
+    qualityTimer->stop();
+    setDraftQuality(false);        // Restores the pens and the legend of the graphs cleared next
     customPlot->clearPlottables();
+    signalTracks.clear();
+    for (DerivedTrack &track : derivedTracks) {
+        track.graph = nullptr;   // Deleted with the plottables above
+        track.channel = DerivedChannel();
+        track.envelopeGeneration = 0;
+    }
+    aligner.clear();
+    tokenAlignment = TokenAlignment();
+    cursorLandmark = SignalLandmarks::Landmark();
+    streamTracks.clear();
+    streamSnapshot = SignalSnapshot();
+    streamTimer->stop();
+    spectrogramEngine->cancel();
+    signalLoader->cancel();       // Whatever is shown next replaces a pending background load
+    pyramidLoader->cancel();
+    filterStage->cancel();
+    viewCacheSource.reset();
+    viewCacheShown.reset();
+    spectrogramCacheKey.clear();
+    spectrogramMap = nullptr;     // Deleted with the plottables above
+    spectrogramRaster = nullptr;
     customPlot->xAxis->setTicks(false);
     customPlot->xAxis->setTickLabels(false);
     customPlot->xAxis->setBasePen(Qt::NoPen);
@@ -505,6 +1078,7 @@ void KinematicVisualizer::setupCustomPlot() {
 
 // Function to get the selection range
 QCPRange KinematicVisualizer::getSelectionRange() const {
+    QCPItemRect *selectionRect = syncGroup->selection();
     if (selectionRect) {
         double lower = selectionRect->topLeft->coords().x();
         double upper = selectionRect->bottomRight->coords().x();
@@ -513,59 +1087,526 @@ QCPRange KinematicVisualizer::getSelectionRange() const {
     return QCPRange(0, 0);  // Return an invalid range if no selection
 }
 
+// Function to get the sampling rate of a shown channel
+double KinematicVisualizer::getChannelSamplingRate(const QString &channel) const {
+    auto it = signalTracks.constFind(channel);
+    return it != signalTracks.constEnd() ? it.value().samplingRate : 0;
+}
+
+// Function to resample the shown channels onto a common grid
+AlignedSignal KinematicVisualizer::getAlignedSignal(double startTime, double endTime, double samplingRate,
+                                                    const QStringList &channels) {
+    PlotProfiler::Scope scope("align", customPlot);
+    return aligner.align(channels, samplingRate, startTime, endTime);
+}
+
+// Function to get the statistics of all channels over the selection
+QList<SelectionStats> KinematicVisualizer::getSelectionStats() const {
+    QList<SelectionStats> result;
+    if (!syncGroup->selection() || signalSamplingRate <= 0) {
+        return result;
+    }
+    QCPRange range = getSelectionRange();
+    range.normalize();   // Selections dragged to the left end before they start
+
+    for (auto it = signalTracks.cbegin(); it != signalTracks.cend(); ++it) {
+        // Samples of this channel whose time lies inside the selection
+        const SignalTrack &track = it.value();
+        int first = static_cast<int>(std::ceil(range.lower * track.samplingRate));
+        int last = static_cast<int>(std::floor(range.upper * track.samplingRate));
+        SelectionStats stats = track.rangeIndex.stats(track.samples, track.pyramid, first, last, track.samplingRate);
+        stats.channel = it.key();
+        result.append(stats);
+    }
+    return result;
+}
+
+// Function to show or hide the statistics readout of the selection
+void KinematicVisualizer::setSelectionReadoutVisible(bool visible) {
+    selectionReadoutVisible = visible;
+    if (visible && !selectionReadout) {
+        selectionReadout = new QCPItemText(customPlot);
+        selectionReadout->setLayer("textOverlay");
+        selectionReadout->position->setType(QCPItemPosition::ptAxisRectRatio);
+        selectionReadout->position->setCoords(0.99, 0.02);
+        selectionReadout->setPositionAlignment(Qt::AlignRight | Qt::AlignTop);
+        selectionReadout->setTextAlignment(Qt::AlignLeft);
+        selectionReadout->setFont(QFont(font().family(), 9));
+        selectionReadout->setColor(Qt::black);
+        selectionReadout->setBrush(QBrush(QColor(255, 255, 255, 200)));
+        selectionReadout->setPadding(QMargins(4, 2, 4, 2));
+        selectionReadout->setSelectable(false);
+        selectionReadout->setVisible(false);
+    }
+    onSelectionChanged();
+}
+
+// Slot to publish the statistics of the current selection
+void KinematicVisualizer::onSelectionChanged() {
+    PlotProfiler::Scope scope("selection stats", customPlot);
+    QList<SelectionStats> stats = getSelectionStats();
+    emit selectionStatsChanged(stats);
+
+    if (!selectionReadout) {
+        return;
+    }
+    QString text;
+    for (const SelectionStats &channel : stats) {
+        if (channel.valid && channel.channel == trackedParameter) {
+            text = QString("%1  %2 s\nmean %3  rms %4\nmin %5  max %6  peak %7\npath %8  peak velocity %9/s")
+                    .arg(channel.channel).arg(channel.duration, 0, 'f', 3)
+                    .arg(channel.mean, 0, 'g', 4).arg(channel.rms, 0, 'g', 4)
+                    .arg(channel.minValue, 0, 'g', 4).arg(channel.maxValue, 0, 'g', 4).arg(channel.peak, 0, 'g', 4)
+                    .arg(channel.pathLength, 0, 'g', 4).arg(channel.peakVelocity, 0, 'g', 4);
+        }
+    }
+    selectionReadout->setText(text);
+    selectionReadout->setVisible(selectionReadoutVisible && !text.isEmpty());
+    ReplotScheduler::instance()->requestLayerReplot(customPlot, "textOverlay");
+}
+
 // Mouse press event handler to clear any existing selection rectangle and start a new one
 void KinematicVisualizer::onAnyMousePress(QMouseEvent *event) {
     clearSelectionRect();  // Clear existing selection on any mouse press
     if (customPlot->viewport().contains(event->pos())) {
         selecting = true;
-        selectionRect = new QCPItemRect(customPlot);
+        QCPItemRect *selectionRect = new QCPItemRect(customPlot);
         selectionRect->setPen(QPen(Qt::NoPen));
         selectionRect->setBrush(QBrush(QColor(255, 0, 0, 50)));
         selectionRect->topLeft->setCoords(customPlot->xAxis->pixelToCoord(cursorPos.x()), customPlot->yAxis->range().upper);
         selectionRect->bottomRight->setCoords(customPlot->xAxis->pixelToCoord(cursorPos.x()), customPlot->yAxis->range().lower);
-        customPlot->replot();
+        syncGroup->setSelection(selectionRect);
+        ReplotScheduler::instance()->requestReplot(customPlot);
     }
 }
 
 // Mouse release event handler to finalize the selection rectangle
 void KinematicVisualizer::onMouseRelease() {
-    selecting = false;
-    if (selectionRect) {
+    QCPItemRect *selectionRect = syncGroup->selection();
+    if (selecting && selectionRect && selectionRect->parentPlot() == customPlot) {
         selectionRect->bottomRight->setCoords(customPlot->xAxis->pixelToCoord(cursorPos.x()), customPlot->yAxis->range().lower);
-        customPlot->replot();
+        ReplotScheduler::instance()->requestReplot(customPlot);
+        syncGroup->notifySelectionChanged();
     }
+    selecting = false;
 }
 
 // Mouse drag event handler to update the selection rectangle
 void KinematicVisualizer::onMouseDrag() {
-    if (selecting && selectionRect) {
+    PlotProfiler::Scope scope("selection", customPlot);
+    QCPItemRect *selectionRect = syncGroup->selection();
+    if (selecting && selectionRect && selectionRect->parentPlot() == customPlot) {
+        noteInteraction();
         selectionRect->bottomRight->setCoords(customPlot->xAxis->pixelToCoord(cursorPos.x()), customPlot->yAxis->range().lower);
-        customPlot->replot();
+        ReplotScheduler::instance()->requestReplot(customPlot);
+        syncGroup->notifySelectionChanged();
     }
 }
 
-// Function to clear any existing selection rectangle
+// Function to clear the selection rectangle of the group
 void KinematicVisualizer::clearSelectionRect() {
-    if (selectionRect) {
-        if (selectionRect->parentPlot()) {
-            selectionRect->parentPlot()->removeItem(selectionRect);
+    syncGroup->clearSelection();
+}
+
+// Slot to synchronize the x-axis range of all plots in the group
+void KinematicVisualizer::synchronizePlots(const QCPRange &newRange) {
+    PlotProfiler::Scope scope("sync", customPlot);
+    noteInteraction();
+
+    // Own graphs follow the new range first, the other plots do the same from their own slot
+    updateSignalLevelOfDetail();
+    if (autoscaleY) {
+        updateAutoscaleY();
+    }
+
+    // The plot that started the change broadcasts it once; the others only follow
+    syncGroup->setXRange(customPlot, newRange);
+}
+
+// Function to append raw samples first..last as graph points
+template <typename T>
+static void appendSamplePoints(const T *samples, int first, int last, double samplingRate, double scale, double offset,
+                               QVector<QCPGraphData> &points) {
+    for (int i = first; i <= last; ++i) {
+        points.append(QCPGraphData(i / samplingRate, samples[i] * scale + offset));
+    }
+}
+
+// Function to append one min/max pair per envelope bucket as graph points
+template <typename T>
+static void appendEnvelopePoints(const T *mins, const T *maxs, int firstBucket, int lastBucket, int bucketSize,
+                                 double samplingRate, double scale, double offset, QVector<QCPGraphData> &points) {
+    double halfBucketTime = bucketSize / (2 * samplingRate);
+    for (int bucket = firstBucket; bucket <= lastBucket; ++bucket) {
+        double key = static_cast<double>(bucket) * bucketSize / samplingRate;
+        points.append(QCPGraphData(key, mins[bucket] * scale + offset));
+        points.append(QCPGraphData(key + halfBucketTime, maxs[bucket] * scale + offset));
+    }
+}
+
+// Function to append the min/max of a short run at the start of every bucket as graph points
+template <typename T>
+static void appendProbePoints(const T *samples, int first, int last, int bucketSize, int probeLength,
+                              double samplingRate, double scale, double offset, QVector<QCPGraphData> &points) {
+    double halfBucketTime = bucketSize / (2 * samplingRate);
+    for (int start = first; start <= last; start += bucketSize) {
+        int end = qMin(last, start + qMin(bucketSize, probeLength) - 1);
+        T localMin = samples[start];
+        T localMax = samples[start];
+        for (int i = start + 1; i <= end; ++i) {
+            localMin = std::min(localMin, samples[i]);
+            localMax = std::max(localMax, samples[i]);
+        }
+        double key = start / samplingRate;
+        points.append(QCPGraphData(key, localMin * scale + offset));
+        points.append(QCPGraphData(key + halfBucketTime, localMax * scale + offset));
+    }
+}
+
+// Function to fill every graph with about two points per horizontal pixel of the visible range
+void KinematicVisualizer::updateSignalLevelOfDetail() {
+    if (signalTracks.isEmpty() || signalSamplingRate <= 0) {
+        return;
+    }
+    PlotProfiler::Scope scope("level of detail", customPlot);
+
+    QCPRange range = customPlot->xAxis->range();
+    int pixelWidth = qMax(1, customPlot->width());
+
+    for (auto it = signalTracks.begin(); it != signalTracks.end(); ++it) {
+        SignalTrack &track = it.value();
+        int sampleCount = track.samples.size();
+        if (!track.graph || sampleCount == 0) {
+            continue;
         }
-        selectionRect = nullptr;
-        for (QCustomPlot *plot : customPlots) {
-            plot->replot();
+
+        // Visible sample window, clamped to the recording
+        double lastIndex = sampleCount - 1;
+        double rate = track.samplingRate;
+        int first = static_cast<int>(qBound(0.0, std::floor(range.lower * rate), lastIndex));
+        int last = static_cast<int>(qBound(0.0, std::ceil(range.upper * rate), lastIndex));
+
+        // Each pixel column gets one min/max pair
+        double samplesPerPixel = static_cast<double>(last - first + 1) / pixelWidth;
+        int level = track.pyramid.levelForBucketSize(samplesPerPixel);
+
+        // Samples and envelopes are read in their stored type and scaled per point
+        QVector<QCPGraphData> points;
+        double offset = track.offset;
+        if (track.pyramidPending && samplesPerPixel >= SignalPyramid::reductionFactor) {
+            // Without the pyramid, a short run at the start of every column stands in for it,
+            // so a zoomed-out view of a mapped file reads a few pages per column, not the file
+            int bucketSize = static_cast<int>(std::ceil(samplesPerPixel));
+            double scale = track.samples.scale();
+            points.reserve(2 * ((last - first) / bucketSize + 1));
+            track.samples.visit([&](const auto *samples, int) {
+                appendProbePoints(samples, first, last, bucketSize, mappedProbeLength, rate, scale, offset, points);
+            });
+        } else if (level == 0) {
+            // Pages of the visible window and one window to either side are requested ahead
+            int margin = last - first + 1;
+            track.samples.prefetch(first - margin, last + margin);
+
+            double scale = track.samples.scale();
+            points.reserve(last - first + 1);
+            track.samples.visit([&](const auto *samples, int) {
+                appendSamplePoints(samples, first, last, rate, scale, offset, points);
+            });
+        } else {
+            const SampleBuffer &mins = track.pyramid.minValues(level);
+            const SampleBuffer &maxs = track.pyramid.maxValues(level);
+            int bucketSize = track.pyramid.bucketSize(level);
+            int firstBucket = first / bucketSize;
+            int lastBucket = last / bucketSize;
+
+            points.reserve(2 * (lastBucket - firstBucket + 1));
+            mins.visit([&](const auto *minData, int) {
+                using SampleType = typename std::remove_cv<typename std::remove_pointer<decltype(minData)>::type>::type;
+                appendEnvelopePoints(minData, maxs.data<SampleType>(), firstBucket, lastBucket, bucketSize,
+                                     rate, mins.scale(), offset, points);
+            });
         }
+        track.graph->data()->set(points, true);
     }
+
+    updateDerivedLevelOfDetail();
 }
 
-// Slot to synchronize the x-axis range of all plots
-void KinematicVisualizer::synchronizePlots(const QCPRange &newRange) {
-    for (QCustomPlot *plot : customPlots) {
-        if (plot != customPlot) {
-            plot->blockSignals(true); // Temporarily block signals to prevent infinite loop
-            plot->xAxis->setRange(newRange);
-            plot->replot();
-            plot->blockSignals(false); // Re-enable signals
+// Function to filter all channels with new settings
+void KinematicVisualizer::setSignalFilter(const FilterSettings &settings) {
+    filterSettings = settings;
+    if (!settings.isActive()) {
+        filterStage->cancel();
+        showFilteredChannels(QMap<QString, FilteredChannel>());
+    } else if (filterStage->request(settings)) {
+        showFilteredChannels(filterStage->result(settings));
+    }
+}
+
+// Function to get the filter settings
+FilterSettings KinematicVisualizer::getSignalFilter() const {
+    return filterSettings;
+}
+
+// Slot to show channels once the background filter finished
+void KinematicVisualizer::onFilterReady(const FilterSettings &settings) {
+    if (settings == filterSettings) {
+        showFilteredChannels(filterStage->result(settings));
+    }
+}
+
+// Function to swap filtered or raw samples into the tracks; graphs and offsets stay
+void KinematicVisualizer::showFilteredChannels(const QMap<QString, FilteredChannel> &filtered) {
+    if (signalTracks.isEmpty()) {
+        return;
+    }
+    QMap<QString, SampleBuffer> shownChannels;
+    QMap<QString, double> samplingRates;
+    for (auto it = signalTracks.begin(); it != signalTracks.end(); ++it) {
+        SignalTrack &track = it.value();
+        auto filteredIt = filtered.constFind(it.key());
+        const FilteredChannel &shown = filteredIt != filtered.constEnd() ? filteredIt.value() : track.raw;
+        track.samples = shown.samples;
+        track.pyramid = shown.pyramid;
+        track.rangeIndex = shown.rangeIndex;
+        track.landmarks = shown.landmarks;
+        track.stats = shown.stats;
+        track.pyramidPending = track.pyramid.levelCount() == 1 && track.samples.size() > SignalPyramid::reductionFactor;
+        cursorChannels.setChannel(it.key(), track.samples, track.samplingRate);
+        shownChannels.insert(it.key(), track.samples);
+        samplingRates.insert(it.key(), track.samplingRate);
+    }
+    aligner.setChannels(shownChannels, samplingRates);
+
+    // Everything derived from the samples follows
+    for (auto it = derivedTracks.begin(); it != derivedTracks.end(); ++it) {
+        bindDerivedTrack(it.key(), it.value());
+    }
+
+    // Offsets and the fixed y-range follow the shown samples, the raw ones once the filter is off
+    updateSignalLayout();
+    onSelectionChanged();
+    ReplotScheduler::instance()->requestReplot(customPlot);
+}
+
+// Function to define a derived channel and show it if its sources are loaded
+void KinematicVisualizer::addDerivedChannel(const QString &name, DerivedChannel::Kind kind, const QStringList &sources, int penWidth) {
+    removeDerivedChannel(name);
+    DerivedTrack &track = derivedTracks[name];
+    track.kind = kind;
+    track.sources = sources;
+    track.penWidth = penWidth;
+    bindDerivedTrack(name, track);
+    updateDerivedLevelOfDetail();
+    ReplotScheduler::instance()->requestReplot(customPlot);
+}
+
+// Function to remove a derived channel
+void KinematicVisualizer::removeDerivedChannel(const QString &name) {
+    auto it = derivedTracks.find(name);
+    if (it == derivedTracks.end()) {
+        return;
+    }
+    if (it.value().graph) {
+        fullQualityPens.remove(it.value().graph);
+        customPlot->removeGraph(it.value().graph);
+    }
+    derivedTracks.erase(it);
+
+    bool anyShown = false;
+    for (const DerivedTrack &track : derivedTracks) {
+        anyShown = anyShown || track.graph;
+    }
+    customPlot->yAxis2->setVisible(anyShown);
+    ReplotScheduler::instance()->requestReplot(customPlot);
+}
+
+// Function to connect a derived channel to the loaded samples and give it a graph
+void KinematicVisualizer::bindDerivedTrack(const QString &name, DerivedTrack &track) {
+    QVector<SampleBuffer> sources;
+    QVector<double> sourceRates;
+    track.samplingRate = 0;
+    for (const QString &source : track.sources) {
+        auto it = signalTracks.constFind(source);
+        if (it == signalTracks.constEnd()) {
+            return;   // Shown once a recording with all sources is loaded
+        }
+        sources.append(it.value().samples);
+        sourceRates.append(it.value().samplingRate);
+        track.samplingRate = qMax(track.samplingRate, it.value().samplingRate);
+    }
+
+    // Sources of different rates are differentiated on the grid of the fastest one; the slower
+    // ones are resampled only for the ranges the view computes
+    track.channel = DerivedChannel(track.kind, sources, sourceRates, track.samplingRate);
+    if (!track.channel.isValid()) {
+        return;
+    }
+
+    // Envelope chunks requested from now on belong to this binding
+    track.envelopeGeneration = ++derivedGeneration;
+
+    if (!track.graph) {
+        track.graph = customPlot->addGraph(customPlot->xAxis, customPlot->yAxis2);
+        if (!colorMap.contains("derived" + name)) {
+            colorMap["derived" + name] = generateRandomColor();
+        }
+        QPen pen(colorMap.value("derived" + name));
+        pen.setWidth(track.penWidth);
+        track.graph->setPen(pen);
+        track.graph->setName(name);
+    }
+    customPlot->yAxis2->setVisible(true);
+    customPlot->yAxis2->setTickLabels(true);
+}
+
+// Worker building envelope chunks of one derived channel on a copy of it
+class KinematicVisualizer::EnvelopeTask : public QRunnable {
+public:
+    EnvelopeTask(KinematicVisualizer *visualizer, const QString &name, quint64 generation, const DerivedChannel &channel,
+                 const QVector<int> &chunks)
+            : visualizer(visualizer), name(name), generation(generation), channel(channel), chunks(chunks) {}
+
+    void run() override {
+        channel.buildEnvelope(chunks);
+
+        KinematicVisualizer *target = visualizer;
+        QString builtName = name;
+        quint64 builtGeneration = generation;
+        DerivedChannel built = channel;
+        QVector<int> builtChunks = chunks;
+        QMetaObject::invokeMethod(target, [target, builtName, builtGeneration, built, builtChunks]() {
+            target->onDerivedEnvelopeReady(builtName, builtGeneration, built, builtChunks);
+        }, Qt::QueuedConnection);
+    }
+
+private:
+    KinematicVisualizer *visualizer;
+    QString name;
+    quint64 generation;
+    DerivedChannel channel;
+    QVector<int> chunks;
+};
+
+// Function called on the GUI thread when envelope chunks of a derived channel are built
+void KinematicVisualizer::onDerivedEnvelopeReady(const QString &name, quint64 generation, const DerivedChannel &built,
+                                                 const QVector<int> &chunks) {
+    // Chunks of a removed channel or of an earlier binding are dropped
+    auto it = derivedTracks.find(name);
+    if (it == derivedTracks.end() || it.value().envelopeGeneration != generation) {
+        return;
+    }
+    it.value().channel.setEnvelope(built, chunks);
+    updateDerivedLevelOfDetail();
+    ReplotScheduler::instance()->requestReplot(customPlot);
+}
+
+// Function to fill derived graphs for the visible range and fit the right axis to them
+void KinematicVisualizer::updateDerivedLevelOfDetail() {
+    if (derivedTracks.isEmpty() || signalSamplingRate <= 0) {
+        return;
+    }
+    PlotProfiler::Scope scope("derived channels", customPlot);
+
+    QCPRange range = customPlot->xAxis->range();
+    int pixelWidth = qMax(1, customPlot->width());
+    double low = std::numeric_limits<double>::max();
+    double high = std::numeric_limits<double>::lowest();
+
+    for (auto it = derivedTracks.begin(); it != derivedTracks.end(); ++it) {
+        DerivedTrack &track = it.value();
+        DerivedChannel &channel = track.channel;
+        if (!track.graph || !channel.isValid()) {
+            continue;
+        }
+        double rate = track.samplingRate;
+        double lastIndex = channel.size() - 1;
+        int first = static_cast<int>(qBound(0.0, std::floor(range.lower * rate), lastIndex));
+        int last = static_cast<int>(qBound(0.0, std::ceil(range.upper * rate), lastIndex));
+        double samplesPerPixel = static_cast<double>(last - first + 1) / pixelWidth;
+
+        QVector<QCPGraphData> points;
+        auto append = [&](double key, double value) {
+            points.append(QCPGraphData(key, value));
+            low = qMin(low, value);
+            high = qMax(high, value);
+        };
+
+        if (samplesPerPixel >= DerivedChannel::envelopeBucket) {
+            // Zoomed out: envelope buckets, filled once per chunk on a worker and kept
+            int firstBucket = first / DerivedChannel::envelopeBucket;
+            int lastBucket = last / DerivedChannel::envelopeBucket;
+            QVector<int> missing = channel.requestEnvelope(firstBucket, lastBucket);
+            if (!missing.isEmpty()) {
+                derivedPool.start(new EnvelopeTask(this, it.key(), track.envelopeGeneration, channel, missing));
+            }
+
+            // Buckets of chunks still being built are estimated from their first samples, as
+            // mapped recordings are while their pyramid is missing
+            const float *mins = channel.envelopeMins().constData();
+            const float *maxs = channel.envelopeMaxs().constData();
+            int group = qMax(1, static_cast<int>(samplesPerPixel / DerivedChannel::envelopeBucket));
+            double halfGroupTime = group * DerivedChannel::envelopeBucket / (2 * rate);
+            points.reserve(2 * ((lastBucket - firstBucket) / group + 1));
+            for (int bucket = firstBucket; bucket <= lastBucket; bucket += group) {
+                int end = qMin(lastBucket, bucket + group - 1);
+                float localMin = std::numeric_limits<float>::max();
+                float localMax = std::numeric_limits<float>::lowest();
+                bool probed = false;
+                for (int b = bucket; b <= end; ++b) {
+                    if (channel.isBucketReady(b)) {
+                        localMin = qMin(localMin, mins[b]);
+                        localMax = qMax(localMax, maxs[b]);
+                    } else if (!probed) {
+                        float probeMin;
+                        float probeMax;
+                        channel.probeBucket(b, mappedProbeLength, probeMin, probeMax);
+                        localMin = qMin(localMin, probeMin);
+                        localMax = qMax(localMax, probeMax);
+                        probed = true;
+                    }
+                }
+                double key = static_cast<double>(bucket) * DerivedChannel::envelopeBucket / rate;
+                append(key, localMin);
+                append(key + halfGroupTime, localMax);
+            }
+        } else {
+            // Zoomed in: the window around the visible range, recomputed when the view leaves it
+            channel.ensureWindow(first, last);
+            int windowFirst = channel.windowFirst();
+            const SignalPyramid &pyramid = channel.windowPyramid();
+            int level = pyramid.levelForBucketSize(samplesPerPixel);
+            if (level == 0) {
+                const float *values = channel.windowValues().data<float>();
+                points.reserve(last - first + 1);
+                for (int i = first; i <= last; ++i) {
+                    append(i / rate, values[i - windowFirst]);
+                }
+            } else {
+                const float *mins = pyramid.minValues(level).data<float>();
+                const float *maxs = pyramid.maxValues(level).data<float>();
+                int bucketSize = pyramid.bucketSize(level);
+                int firstBucket = (first - windowFirst) / bucketSize;
+                int lastBucket = (last - windowFirst) / bucketSize;
+                double halfBucketTime = bucketSize / (2 * rate);
+                points.reserve(2 * (lastBucket - firstBucket + 1));
+                for (int bucket = firstBucket; bucket <= lastBucket; ++bucket) {
+                    double key = (windowFirst + static_cast<double>(bucket) * bucketSize) / rate;
+                    append(key, mins[bucket]);
+                    append(key + halfBucketTime, maxs[bucket]);
+                }
+            }
+        }
+        track.graph->data()->set(points, true);
+    }
+
+    // The right axis always fits the visible derived values
+    if (low <= high) {
+        double padding = (high - low) * 0.1;
+        if (padding == 0) {
+            padding = 1;
         }
+        customPlot->yAxis2->setRange(low - padding, high + padding);
     }
 }
 
@@ -581,83 +1622,482 @@ bool KinematicVisualizer::isAtZoomOutLimit() {
     return (currentRange.lower <= xAxisMinLimit && currentRange.upper >= xAxisMaxLimit);
 }
 
+// Function to build the gradient used for spectrograms
+QCPColorGradient KinematicVisualizer::spectrogramGradient() {
+    QCPColorGradient grayGradient;
+    grayGradient.clearColorStops();
+    grayGradient.setColorInterpolation(QCPColorGradient::ciRGB);
+    grayGradient.setColorStopAt(0.0, Qt::white);
+    grayGradient.setColorStopAt(1.0, Qt::black);
+    return grayGradient;
+}
+
+// Function to select 8- or 16-bit quantized spectrogram storage (0 keeps the QCPColorMap path)
+void KinematicVisualizer::setSpectrogramQuantization(int bits) {
+    spectrogramQuantizationBits = (bits == 8 || bits == 16) ? bits : 0;
+}
+
+// Function to toggle zoom-dependent spectrogram tiles
+void KinematicVisualizer::setSpectrogramTiling(bool enabled) {
+    spectrogramTiling = enabled;
+}
+
+// Function to set the memory budget of the spectrogram tile cache
+void KinematicVisualizer::setSpectrogramTileBudget(qint64 bytes) {
+    spectrogramTiles->setMemoryBudget(bytes);
+}
+
 // Function to visualize spectrogram data
 void KinematicVisualizer::visualizeSpectrogram(const QVector<QVector<double>> &spectrogramData, const QString &configName, double duration) {
+    Q_UNUSED(configName);
+    PreparedSpectrogram prepared;
+    prepareSpectrogram(spectrogramData, duration, 5000, spectrogramQuantizationBits, prepared);
+    applySpectrogram(prepared);
+}
+
+// Function to show a prepared spectrogram matrix; the cells are handed over, not copied
+void KinematicVisualizer::applySpectrogram(PreparedSpectrogram &prepared) {
     setupCustomPlot();
 
     customPlot->setProperty("isSpectrogram", true);
     customPlot->setFixedHeight(150);
 
-    int nx = spectrogramData.size();
-    int ny = spectrogramData[0].size();
+    QCPRange timeRange(0, prepared.duration);
+    QCPRange frequencyRange(0, prepared.maxFrequency);
+
+    if (prepared.raster) {
+        spectrogramRaster = new SpectrogramPlottable(customPlot->xAxis, customPlot->yAxis);
+        spectrogramRaster->setGradient(spectrogramGradient());
+        spectrogramRaster->setRaster(prepared.raster, timeRange, frequencyRange);
+        spectrogramRaster->setDataRange(QCPRange(prepared.dataMin, prepared.dataMax / 2));
+        spectrogramRaster->setName("");
+    } else if (prepared.mapData) {
+        QCPColorMap *colorMap = new QCPColorMap(customPlot->xAxis, customPlot->yAxis);
+        colorMap->setData(prepared.takeMapData(), false);
+        colorMap->setGradient(spectrogramGradient());
+        colorMap->setDataRange(QCPRange(prepared.dataMin, prepared.dataMax / 2));
+        colorMap->setName("");
+    }
 
-    QCPColorMap *colorMap = new QCPColorMap(customPlot->xAxis, customPlot->yAxis);
-    colorMap->data()->setSize(nx, ny);
-    colorMap->data()->setRange(QCPRange(0, duration), QCPRange(0, 5000));
+    customPlot->rescaleAxes();
 
-    for (int x = 0; x < nx; ++x) {
-        for (int y = 0; y < ny; ++y) {
-            colorMap->data()->setCell(x, y, spectrogramData[x][y]);
+    customPlot->replot();
+}
+
+// Function to visualize the spectrogram of raw audio, computed in the background
+void KinematicVisualizer::visualizeSpectrogram(const QVector<double> &samples, double samplingRate, const SpectrogramParameters &parameters,
+                                               const QString &configName, const QString &recordingPath) {
+    Q_UNUSED(configName);
+    setupCustomPlot();
+
+    customPlot->setProperty("isSpectrogram", true);
+    customPlot->setFixedHeight(150);
+
+    if (spectrogramTiling) {
+        // Tiles are computed per zoom level as the view asks for them; the overview level comes first
+        SpectrogramRaster::Depth depth = spectrogramQuantizationBits == 16 ? SpectrogramRaster::Depth16 : SpectrogramRaster::Depth8;
+        spectrogramTiles->setQuantization(depth, spectrogramMinLevel, spectrogramMaxLevel);
+        spectrogramTiles->setSource(samples, samplingRate, parameters);
+        spectrogramTilePeak = std::numeric_limits<float>::lowest();
+
+        QCPRange timeRange(0, spectrogramTiles->duration());
+        QCPRange frequencyRange(0, spectrogramTiles->maxFrequency());
+        spectrogramRaster = new SpectrogramPlottable(customPlot->xAxis, customPlot->yAxis);
+        spectrogramRaster->setGradient(spectrogramGradient());
+        spectrogramRaster->setTileCache(spectrogramTiles, timeRange, frequencyRange);
+        spectrogramRaster->setName("");
+        spectrogramTiles->prefetchLevel(0);
+
+        customPlot->xAxis->setRange(timeRange);
+        customPlot->yAxis->setRange(frequencyRange);
+        customPlot->replot();
+        return;
+    }
+
+    // Frames computed before for the same samples and parameters are read from the cache
+    CachedSpectrogram cached;
+    bool fromCache = false;
+    if (viewCacheEnabled && !recordingPath.isEmpty()) {
+        QByteArray key = SignalViewCache::spectrogramKey(recordingPath, samples, samplingRate, parameters);
+        fromCache = SignalViewCache::loadSpectrogram(recordingPath, key, cached);
+        if (!fromCache) {
+            spectrogramCacheRecording = recordingPath;
+            spectrogramCacheKey = key;
         }
     }
+    spectrogramPeak = std::numeric_limits<float>::lowest();
+
+    // Otherwise the engine fixes the geometry up front, the frames follow asynchronously
+    int nx = cached.frameCount;
+    int ny = cached.binCount;
+    QCPRange timeRange(0, cached.duration);
+    QCPRange frequencyRange(0, cached.maxFrequency);
+    if (!fromCache) {
+        spectrogramEngine->compute(samples, samplingRate, parameters);
+        nx = spectrogramEngine->frameCount();
+        ny = spectrogramEngine->binCount();
+        timeRange = QCPRange(0, spectrogramEngine->duration());
+        frequencyRange = QCPRange(0, spectrogramEngine->maxFrequency());
+    }
+    if (nx == 0) {
+        customPlot->replot();
+        return;
+    }
 
-    QCPColorGradient grayGradient;
-    grayGradient.clearColorStops();
-    grayGradient.setColorInterpolation(QCPColorGradient::ciRGB);
-    grayGradient.setColorStopAt(0.0, Qt::white);
-    grayGradient.setColorStopAt(1.0, Qt::black);
-    colorMap->setGradient(grayGradient);
+    if (spectrogramQuantizationBits != 0) {
+        // Engine output is quantized block by block and released once complete
+        SpectrogramRaster::Depth depth = spectrogramQuantizationBits == 8 ? SpectrogramRaster::Depth8 : SpectrogramRaster::Depth16;
+        QSharedPointer<SpectrogramRaster> raster(new SpectrogramRaster(nx, ny, depth, spectrogramMinLevel, spectrogramMaxLevel));
+        spectrogramRaster = new SpectrogramPlottable(customPlot->xAxis, customPlot->yAxis);
+        spectrogramRaster->setGradient(spectrogramGradient());
+        spectrogramRaster->setRaster(raster, timeRange, frequencyRange);
+        spectrogramRaster->setName("");
+    } else {
+        spectrogramMap = new QCPColorMap(customPlot->xAxis, customPlot->yAxis);
+        spectrogramMap->data()->setSize(nx, ny);
+        spectrogramMap->data()->setRange(timeRange, frequencyRange);
+        spectrogramMap->data()->fill(std::numeric_limits<float>::lowest());  // Pending columns stay blank
+        spectrogramMap->setGradient(spectrogramGradient());
+        spectrogramMap->setName("");
+    }
+    if (fromCache) {
+        showSpectrogramFrames(0, nx, ny, cached.frames.data<float>());
+    }
+
+    customPlot->xAxis->setRange(timeRange);
+    customPlot->yAxis->setRange(frequencyRange);
+
+    customPlot->replot();
+}
+
+// Slot to copy a block of finished spectrogram frames into the color map
+void KinematicVisualizer::onSpectrogramFramesReady(int firstFrame, int count) {
+    showSpectrogramFrames(firstFrame, count, spectrogramEngine->binCount(), spectrogramEngine->frame(firstFrame));
+}
+
+// Function to copy consecutive spectrogram frames of bins values each into the color map or raster
+void KinematicVisualizer::showSpectrogramFrames(int firstFrame, int count, int bins, const float *frames) {
+    if (!spectrogramMap && !spectrogramRaster) {
+        return;
+    }
 
-    double dataMin = std::numeric_limits<double>::max();
-    double dataMax = std::numeric_limits<double>::lowest();
-    for (const auto& row : spectrogramData) {
-        for (const auto& value : row) {
-            if (value < dataMin) dataMin = value;
-            if (value > dataMax) dataMax = value;
+    // Dynamic range shown below the loudest bin (dB)
+    const float dynamicRange = 70.0f;
+
+    float peak = spectrogramPeak;
+    const float *end = frames + static_cast<qint64>(count) * bins;
+    for (const float *value = frames; value != end; ++value) {
+        peak = qMax(peak, *value);
+    }
+
+    if (spectrogramRaster) {
+        spectrogramRaster->raster()->setFrames(firstFrame, count, frames);
+    } else {
+        QCPColorMapData *mapData = spectrogramMap->data();
+        for (int x = 0; x < count; ++x) {
+            const float *frame = frames + static_cast<qint64>(x) * bins;
+            for (int y = 0; y < bins; ++y) {
+                mapData->setCell(firstFrame + x, y, frame[y]);
+            }
         }
     }
-    colorMap->setDataRange(QCPRange(dataMin, dataMax / 2));
 
-    customPlot->rescaleAxes();
+    if (peak > spectrogramPeak) {
+        spectrogramPeak = peak;
+        QCPRange dataRange(peak - dynamicRange, peak);
+        if (spectrogramRaster) {
+            spectrogramRaster->setDataRange(dataRange);
+        } else {
+            spectrogramMap->setDataRange(dataRange);
+        }
+    }
 
-    colorMap->setName("");
+    // Several blocks finishing close together end up in one replot
+    ReplotScheduler::instance()->requestReplot(customPlot);
+}
 
-    customPlot->replot();
+// Slot to show a newly computed spectrogram tile
+void KinematicVisualizer::onSpectrogramTileReady() {
+    if (!spectrogramRaster) {
+        return;
+    }
+
+    // Dynamic range shown below the loudest bin (dB)
+    const float dynamicRange = 70.0f;
+
+    float peak = spectrogramTiles->peak();
+    if (peak > spectrogramTilePeak) {
+        spectrogramTilePeak = peak;
+        spectrogramRaster->setDataRange(QCPRange(peak - dynamicRange, peak));
+    }
+
+    ReplotScheduler::instance()->requestReplot(customPlot);
 }
 
-// Function to set the tracked parameter (X, Y, or Z)
+// Slot to cache the finished frames and drop them once they live on in the quantized raster
+void KinematicVisualizer::onSpectrogramFinished() {
+    if (!spectrogramCacheKey.isEmpty() && spectrogramEngine->frameCount() > 0) {
+        CachedSpectrogram spectrogram;
+        spectrogram.frameCount = spectrogramEngine->frameCount();
+        spectrogram.binCount = spectrogramEngine->binCount();
+        spectrogram.duration = spectrogramEngine->duration();
+        spectrogram.maxFrequency = spectrogramEngine->maxFrequency();
+        QVector<float> frames(spectrogram.frameCount * spectrogram.binCount);
+        std::copy(spectrogramEngine->frame(0), spectrogramEngine->frame(0) + frames.size(), frames.data());
+        spectrogram.frames = SampleBuffer(frames);
+        viewCache.storeSpectrogram(spectrogramCacheRecording, spectrogramCacheKey, spectrogram);
+        spectrogramCacheKey.clear();
+    }
+    if (spectrogramRaster) {
+        spectrogramEngine->releaseFrames();
+    }
+}
+
+// Function to set the tracked parameter (any channel name)
 void KinematicVisualizer::setTrackedParameter(const QString &parameter) {
     trackedParameter = parameter;
 }
 
 // Function to set the signal data
 void KinematicVisualizer::setSignalData(const QMap<QString, QVector<double>> &dataMap) {
-    signalDataX.clear();
-    signalDataY.clear();
-    signalDataZ.clear();
+    // Cursor data set this way is indexed by sample number
+    cursorChannels.clear();
+    for (auto it = dataMap.cbegin(); it != dataMap.cend(); ++it) {
+        cursorChannels.setChannel(it.key(), it.value(), 1);
+    }
+    cursorChannelNames = cursorChannels.channelNames();
+}
+
+// Function to toggle the readout of every channel next to the cursor
+void KinematicVisualizer::setShowAllChannelValues(bool show) {
+    showAllChannelValues = show;
+}
+
+// Function to switch snapping of the cursor to landmarks
+void KinematicVisualizer::setCursorSnap(bool enabled, int radiusPixels) {
+    cursorSnap = enabled;
+    cursorSnapRadius = qMax(0, radiusPixels);
+}
+
+// Function to choose the kinds of landmarks for snapping and navigation
+void KinematicVisualizer::setLandmarkKinds(int kinds) {
+    landmarkKinds = kinds & SignalLandmarks::AllKinds;
+    cursorLandmark = SignalLandmarks::Landmark();
+}
 
-    if (dataMap.contains("X")) {
-        const QVector<double> &xData = dataMap["X"];
-        for (int i = 0; i < xData.size(); ++i) {
-            signalDataX.append(qMakePair(static_cast<double>(i), xData[i]));
+// Function to prepare the plot for live acquisition
+void KinematicVisualizer::startStreaming(const QString &configName, int penWidth) {
+    setupCustomPlot();
+    customPlot->setFixedHeight(150);
+    customPlot->legend->setVisible(true);
+
+    cursorChannels.clear();
+    cursorChannelNames.clear();
+    streamConfigName = configName;
+    streamPenWidth = penWidth;
+    streamDirty = false;
+    streamEndTime = 0;
+    streamMin = std::numeric_limits<double>::max();
+    streamMax = std::numeric_limits<double>::lowest();
+
+    // The writer drops the channels of the previous session; graphs show its snapshots from then on
+    streamGeneration = signalModel.requestClear();
+    if (!externalStreamWriter) {
+        signalModel.publish();
+        streamAppended = false;
+    }
+
+    xAxisMinLimit = 0;
+    xAxisMaxLimit = 0;
+
+    // Channels may also appear in the model from an acquisition thread, so frames run from the start
+    streamTimer->start();
+}
+
+// Function to add a live channel retaining the given length of samples
+void KinematicVisualizer::addStreamingChannel(const QString &channel, double samplingRate, double bufferSeconds) {
+    if (externalStreamWriter || samplingRate <= 0 || streamTracks.contains(channel)) {
+        return;
+    }
+    signalModel.addChannel(channel, samplingRate, bufferSeconds);
+    streamAppended = true;
+    addStreamTrack(channel, samplingRate);
+}
+
+// Function to add the graph of a live channel
+KinematicVisualizer::StreamTrack* KinematicVisualizer::addStreamTrack(const QString &channel, double samplingRate) {
+    if (!colorMap.contains(streamConfigName + channel)) {
+        colorMap[streamConfigName + channel] = generateRandomColor();
+    }
+
+    QCPGraph *graph = customPlot->addGraph();
+    if (!graph) {
+        return nullptr;
+    }
+    QPen pen(colorMap.value(streamConfigName + channel));
+    pen.setWidth(streamPenWidth);
+    graph->setPen(pen);
+    graph->setBrush(Qt::NoBrush);
+    graph->setLineStyle(QCPGraph::lsLine);
+    graph->setName(streamConfigName == channel ? channel : streamConfigName + " " + channel);
+
+    StreamTrack &track = streamTracks[channel];
+    track.graph = graph;
+    track.samplingRate = samplingRate;
+    return &track;
+}
+
+// Function to remove the graphs of all live channels
+void KinematicVisualizer::removeStreamTracks() {
+    for (const StreamTrack &track : streamTracks) {
+        fullQualityPens.remove(track.graph);
+        customPlot->removeGraph(track.graph);
+    }
+    streamTracks.clear();
+    streamEndTime = 0;
+    streamMin = std::numeric_limits<double>::max();
+    streamMax = std::numeric_limits<double>::lowest();
+}
+
+// Function to append live samples to a channel; they are published with the next frame
+void KinematicVisualizer::appendSamples(const QString &channel, const double *samples, int count) {
+    if (externalStreamWriter) {
+        return;
+    }
+    signalModel.append(channel, samples, count);
+    streamAppended = true;
+}
+
+// Function to append live samples from a vector
+void KinematicVisualizer::appendSamples(const QString &channel, const QVector<double> &samples) {
+    appendSamples(channel, samples.constData(), samples.size());
+}
+
+// Function to get the model behind the live channels
+SignalModel* KinematicVisualizer::getSignalModel() {
+    return &signalModel;
+}
+
+// Function to hand the writing of the model to another thread, or take it back
+void KinematicVisualizer::setExternalStreamWriter(bool external) {
+    if (external && streamAppended) {
+        signalModel.publish();   // The GUI thread's last samples, before the other writer takes over
+        streamAppended = false;
+    }
+    externalStreamWriter = external;
+}
+
+// Function to toggle scrolling along with the newest samples
+void KinematicVisualizer::setFollowTail(bool follow) {
+    followTail = follow;
+    streamDirty = true;
+}
+
+// Slot to draw the samples published since the last frame, then update axes and replot
+void KinematicVisualizer::onStreamFrame() {
+    // Samples appended on the GUI thread become visible once per frame, however many calls brought them
+    if (streamAppended) {
+        signalModel.publish();
+        streamAppended = false;
+    }
+
+    // Snapshots from before the clear of startStreaming() still hold the previous session
+    SignalSnapshot snapshot = signalModel.snapshot();
+    if (snapshot.generation() < streamGeneration) {
+        return;
+    }
+    if (snapshot.generation() > streamGeneration) {
+        // The writer cleared the model on its own; channels start over
+        removeStreamTracks();
+        streamGeneration = snapshot.generation();
+        streamDirty = true;
+    }
+
+    if (snapshot.version() != streamSnapshot.version()) {
+        // Channels the model no longer has lose their graphs
+        for (auto it = streamTracks.begin(); it != streamTracks.end();) {
+            if (snapshot.contains(it.key())) {
+                ++it;
+                continue;
+            }
+            fullQualityPens.remove(it.value().graph);
+            customPlot->removeGraph(it.value().graph);
+            it = streamTracks.erase(it);
+            streamDirty = true;
         }
+
+        for (const QString &name : snapshot.channelNames()) {
+            SignalSnapshotChannel channel = snapshot.channel(name);
+            auto it = streamTracks.find(name);
+            StreamTrack *track = it != streamTracks.end() ? &it.value() : addStreamTrack(name, channel.samplingRate());
+            if (!track) {
+                continue;
+            }
+
+            // A channel that was replaced under the same name is drawn again from its start
+            if (channel.totalCount() < track->shownCount) {
+                track->graph->data()->clear();
+                track->shownCount = 0;
+                streamDirty = true;
+            }
+
+            // Only the part that is still retained ends up in the graph
+            qint64 first = qMax(track->shownCount, channel.firstIndex());
+            int count = static_cast<int>(channel.totalCount() - first);
+            if (count > 0) {
+                QVector<double> values(count);
+                channel.copy(first, count, values.data());
+                QVector<QCPGraphData> points(count);
+                for (int i = 0; i < count; ++i) {
+                    double value = values[i];
+                    points[i] = QCPGraphData((first + i) / track->samplingRate, value);
+                    if (value < streamMin) streamMin = value;
+                    if (value > streamMax) streamMax = value;
+                }
+
+                // Appending sorted keys and trimming the front are both cheap on the graph container
+                track->graph->data()->add(points, true);
+                track->graph->data()->removeBefore(channel.firstIndex() / track->samplingRate);
+                streamEndTime = qMax(streamEndTime, (channel.totalCount() - 1) / track->samplingRate);
+                streamDirty = true;
+            }
+            track->shownCount = channel.totalCount();
+        }
+        streamSnapshot = snapshot;
     }
-    if (dataMap.contains("Y")) {
-        const QVector<double> &yData = dataMap["Y"];
-        for (int i = 0; i < yData.size(); ++i) {
-            signalDataY.append(qMakePair(static_cast<double>(i), yData[i]));
+
+    if (!streamDirty) {
+        return;
+    }
+    streamDirty = false;
+
+    xAxisMaxLimit = streamEndTime;
+
+    if (followTail) {
+        double span = customPlot->xAxis->range().size();
+        if (span <= 0) {
+            span = streamEndTime;
         }
+        customPlot->xAxis->setRange(streamEndTime - span, streamEndTime);
     }
-    if (dataMap.contains("Z")) {
-        const QVector<double> &zData = dataMap["Z"];
-        for (int i = 0; i < zData.size(); ++i) {
-            signalDataZ.append(qMakePair(static_cast<double>(i), zData[i]));
+
+    if (streamMin <= streamMax) {
+        double padding = (streamMax - streamMin) * 0.1; // 10% padding
+        if (padding == 0) {
+            padding = 1;
+        }
+        QCPRange yRange(streamMin - padding, streamMax + padding);
+        if (!customPlot->yAxis->range().contains(streamMin) || !customPlot->yAxis->range().contains(streamMax)) {
+            customPlot->yAxis->setRange(yRange);
         }
     }
+
+    ReplotScheduler::instance()->requestReplot(customPlot);
 }
 
 // Slot to zoom into the selected range
 void KinematicVisualizer::zoomToSelection() {
+    QCPItemRect *selectionRect = syncGroup->selection();
     if (selectionRect) {
         double xMin = selectionRect->topLeft->coords().x();
         double xMax = selectionRect->bottomRight->coords().x();
@@ -6,8 +6,25 @@
 #define KINEMATICVISUALIZER_H
 
 #include <QWidget>
+#include <QTimer>
+#include <QThreadPool>
 #include "qcustomplot.h"
 #include "label.h"
+#include "SignalPyramid.h"
+#include "SignalChannelStore.h"
+#include "SignalModel.h"
+#include "SpectrogramEngine.h"
+#include "SpectrogramPlottable.h"
+#include "SpectrogramTileCache.h"
+#include "PlotSyncGroup.h"
+#include "SignalLoader.h"
+#include "MappedSignalFile.h"
+#include "DerivedChannel.h"
+#include "SignalFilter.h"
+#include "SignalResampler.h"
+#include "WaveformPlottable.h"
+#include "SignalViewCache.h"
+#include "TokenAlignment.h"
 
 // KinematicVisualizer class for visualizing kinematic signals and spectrograms
 class KinematicVisualizer : public QWidget {
@@ -24,7 +41,52 @@ public:
 
     // Visualization methods
     void visualizeSignal(const QMap<QString, QVector<double>> &dataMap, const QString &configName, int penWidth, int samplingRate);
+    // Same as above, but takes ownership of the sample buffers without copying them
+    void visualizeSignal(QMap<QString, QVector<double>> &&dataMap, const QString &configName, int penWidth, int samplingRate);
+    // Same for channels stored as 16-bit integers with scale, floats or doubles; they stay in that type
+    void visualizeSignal(const QMap<QString, SampleBuffer> &channels, const QString &configName, int penWidth, int samplingRate);
+    // Same for channels recorded at different rates, e.g. 250 Hz articulography with 44.1 kHz audio;
+    // every channel keeps its own time axis, channels missing from samplingRates use defaultRate
+    void visualizeSignal(const QMap<QString, SampleBuffer> &channels, const QMap<QString, double> &samplingRates,
+                         const QString &configName, int penWidth, double defaultRate = 1);
+    // Show a memory-mapped recording at once; only pages of the visible range are read, the
+    // zoomed-out summary of the whole file is built in the background
+    void visualizeMappedSignal(const QSharedPointer<MappedSignalFile> &file, const QString &configName, int penWidth);
+    void setMappedInitialSpan(double seconds);
+    // Overlay repetitions of a token in one plot, time-aligned by dynamic time warping on
+    // alignmentChannels to the most central token; shows displayChannels, or the alignment
+    // channels if empty, of every token on the time axis of the reference
+    void visualizeTokenOverlay(const QVector<AlignmentToken> &tokens, const QStringList &alignmentChannels,
+                               const QString &configName, int penWidth, const QStringList &displayChannels = QStringList());
+    // Alignment behind the shown overlay, e.g. for the distances of the tokens to the reference
+    TokenAlignment getTokenAlignment() const;
+    // Keep the summary of mapped recordings (pyramids, selection indexes, statistics) and the
+    // spectrograms of recordings given by path in cache files next to them, so showing a recording
+    // again maps its cache instead of passing over all samples
+    void setViewCacheEnabled(bool enabled);
+    // Also hash all samples of a mapped recording in the background after its cached summary is
+    // shown, and summarize it again if they changed without a change of size or modification
+    // time. Off by default: the check reads the whole recording on every reopen
+    void setViewCacheVerification(bool enabled);
     void visualizeSpectrogram(const QVector<QVector<double>> &spectrogramData, const QString &configName, double duration);
+    // Compute the spectrogram of raw audio in the background and show columns as they finish;
+    // recordingPath names the file the samples came from, where the view cache keeps the result
+    void visualizeSpectrogram(const QVector<double> &samples, double samplingRate, const SpectrogramParameters &parameters,
+                              const QString &configName, const QString &recordingPath = QString());
+    // Store spectrograms as 8- or 16-bit levels and rasterize only the visible window (0 = QCPColorMap)
+    void setSpectrogramQuantization(int bits);
+    // Compute spectrogram tiles per zoom level on demand instead of the whole file at one resolution
+    void setSpectrogramTiling(bool enabled);
+    void setSpectrogramTileBudget(qint64 bytes);
+
+    // Prepare data on a worker thread and swap it into the plot when complete; the plot keeps
+    // its current content until then, and a newer load or cancelLoading() drops a pending one
+    void visualizeSignalAsync(const QMap<QString, QVector<double>> &dataMap, const QString &configName, int penWidth, int samplingRate);
+    void visualizeSignalAsync(const QMap<QString, SampleBuffer> &channels, const QString &configName, int penWidth, int samplingRate);
+    void visualizeSignalAsync(const QMap<QString, SampleBuffer> &channels, const QMap<QString, double> &samplingRates,
+                              const QString &configName, int penWidth, double defaultRate = 1);
+    void visualizeSpectrogramAsync(const QVector<QVector<double>> &spectrogramData, const QString &configName, double duration);
+    void cancelLoading();
 
     // Destructor
     ~KinematicVisualizer();
@@ -32,6 +94,57 @@ public:
     // Setters
     void setTrackedParameter(const QString &parameter);
     void setSignalData(const QMap<QString, QVector<double>> &dataMap);
+    void setShowAllChannelValues(bool show);
+
+    // Snap the cursor to the nearest landmark (extremum, velocity peak, onset or offset) of the
+    // tracked channel within radiusPixels; landmarks are indexed once when a recording is loaded
+    void setCursorSnap(bool enabled, int radiusPixels = 12);
+    // Kinds of landmarks used for snapping and navigation, a combination of SignalLandmarks::Kind
+    void setLandmarkKinds(int kinds);
+
+    // Streaming methods for live acquisition; graphs are updated in place, never rebuilt. Samples
+    // go into the signal model and are drawn from its latest snapshot once per display frame
+    void startStreaming(const QString &configName, int penWidth);
+    void addStreamingChannel(const QString &channel, double samplingRate, double bufferSeconds);
+    void appendSamples(const QString &channel, const double *samples, int count);
+    void appendSamples(const QString &channel, const QVector<double> &samples);
+    void setFollowTail(bool follow);
+    // Model behind the live channels; analysis threads read its snapshots. Instead of calling the
+    // methods above on the GUI thread, an acquisition thread may add channels to it and append and
+    // publish samples itself, as its only writer, after setExternalStreamWriter(true); from then
+    // on the methods above leave the model alone and startStreaming() has the writer clear it.
+    SignalModel* getSignalModel();
+    void setExternalStreamWriter(bool external);
+
+    // Smooth or detrend all channels with a zero-phase Butterworth filter; channels are filtered in
+    // parallel in the background and results are cached per setting, so switching back is immediate
+    void setSignalFilter(const FilterSettings &settings);
+    FilterSettings getSignalFilter() const;
+
+    // Show the velocity, acceleration or tangential speed of recorded channels on the right axis;
+    // values are computed for the visible range only, and the definition follows reloaded data
+    void addDerivedChannel(const QString &name, DerivedChannel::Kind kind, const QStringList &sources, int penWidth = 1);
+    void removeDerivedChannel(const QString &name);
+
+    // Fit the y-axis to the data of the visible x-range after every pan or zoom instead of
+    // keeping the range of the whole recording; each fit is a range query on the pyramids
+    void setAutoscaleY(bool enabled);
+
+    // Show the PlotProfiler digest (frame rate, dropped frames, section and replot times) on the plot;
+    // showing it switches the profiler on
+    void setProfilerHudVisible(bool visible);
+
+    // Draw recorded channels as column rasters cached per pixel column instead of line graphs, so a
+    // pan only computes the newly exposed columns; takes effect with the next recording
+    void setWaveformRendering(bool enabled);
+
+    // Draw thin aliased lines without the legend while the view changes continuously (pan, zoom,
+    // selection drag) and redraw at full quality once it was idle for idleMilliseconds
+    void setAdaptiveQuality(bool enabled, int idleMilliseconds = 150);
+
+    // Plots of one group share cursor, x-range and selection; null selects the default group
+    void setSyncGroup(PlotSyncGroup *group);
+    PlotSyncGroup* getSyncGroup() const;
 
     // Method to clear the selection rectangle
     void clearSelectionRect();
@@ -43,13 +156,38 @@ public:
     // Getter for selection range
     QCPRange getSelectionRange() const;
 
+    // Sampling rate of a shown channel, 0 for unknown channels
+    double getChannelSamplingRate(const QString &channel) const;
+    // The shown channels resampled onto one grid over a time range, e.g. for export; a rate of 0
+    // selects the highest channel rate. Runs on all cores and returns when done.
+    AlignedSignal getAlignedSignal(double startTime, double endTime, double samplingRate = 0,
+                                   const QStringList &channels = QStringList());
+
+    // Statistics of every channel of this plot over the group's selection, empty without one
+    QList<SelectionStats> getSelectionStats() const;
+    // Show the statistics of the tracked channel next to the selection while it changes
+    void setSelectionReadoutVisible(bool visible);
+
     // Getter for the associated label object
     Label* getLabel() const;
 
+signals:
+    // Progress of a background load in percent, and its completion after the swap
+    void loadingProgress(int percent);
+    void loadingFinished();
+
+    // Statistics of this plot's channels after the group's selection changed
+    void selectionStatsChanged(const QList<SelectionStats> &stats);
+
 public slots:
             // Slot to zoom into the selected range
             void zoomToSelection();
 
+    // Slots to move the cursor to the next or previous landmark of the tracked channel, panning
+    // the view if it lies outside
+    void goToNextLandmark();
+    void goToPreviousLandmark();
+
 private slots:
             // Overridden event handlers
             void mouseMoveEvent(QMouseEvent *event) override;
@@ -63,6 +201,32 @@ private slots:
     void onMouseDrag();
     void onAnyMousePress(QMouseEvent *event);
 
+    // Slot to draw the samples published since the last display frame
+    void onStreamFrame();
+
+    // Slot to copy finished spectrogram frames into the color map
+    void onSpectrogramFramesReady(int firstFrame, int count);
+    void onSpectrogramFinished();
+    void onSpectrogramTileReady();
+
+    // Slot to swap a finished background load into the plot
+    void onLoadFinished();
+
+    // Slot to take over the pyramids of a mapped recording once built
+    void onPyramidsReady();
+
+    // Slot to refresh the profiler HUD text
+    void onProfilerHudTimer();
+
+    // Slot to recompute the selection statistics
+    void onSelectionChanged();
+
+    // Slot to show channels filtered in the background
+    void onFilterReady(const FilterSettings &settings);
+
+    // Slot to restore full quality once interaction was idle
+    void onInteractionIdle();
+
 private:
     // Private members for graphical items
     QCPItemRect *coordFrame;       // Coordinate frame for the cursor
@@ -95,13 +259,11 @@ private:
     double yAxisMinLimit;
     double yAxisMaxLimit;
 
-        // Static methods for synchronizing Y-axes across multiple plots
-    static void synchronizeYAxes();
+    // Method for synchronizing Y-axes across the plots of the group
+    void synchronizeYAxes();
 
-    // Static members for managing multiple custom plots and their vertical lines
-    static QList<QCustomPlot*> customPlots;
-    static QMap<QCustomPlot*, QCPItemLine*> vLinesMap;
-    static QCustomPlot* lastPlotWithLine;
+    // Group of plots this plot synchronizes with
+    QPointer<PlotSyncGroup> syncGroup;
 
     // Methods for setting up and updating cursor items
     void setupCursorItems(QCustomPlot *plot);
@@ -124,20 +286,15 @@ private:
     // Method to retrieve Y-value from signal data based on the X-value
     double getYValueFromSignal(double x);
 
-    // Data for signals X, Y, and Z
-    QVector<QPair<double, double>> signalDataX;
-    QVector<QPair<double, double>> signalDataY;
-    QVector<QPair<double, double>> signalDataZ;
+    // Uniformly sampled channel data for cursor display (shared with the caller's buffers)
+    SignalChannelStore cursorChannels;
 
-    // Tracked parameter (e.g., "X", "Y", or "Z")
+    // Tracked parameter (any channel name, e.g., "X", "TT" or "jaw")
     QString trackedParameter;
 
     // Horizontal scroll bar (if needed)
     QScrollBar *horizontalScrollBar;
 
-    // Static selection rectangle for zooming
-    static QCPItemRect *selectionRect;
-
     // Flag to indicate if selection is in progress
     bool selecting;
 
@@ -146,6 +303,160 @@ private:
 
     // Label object associated with the visualizer
     Label *label;
+
+    // Per-channel drawing state used to feed graphs at screen resolution
+    struct SignalTrack {
+        QCPGraph *graph = nullptr;   // Graph showing the channel
+        WaveformPlottable *waveform = nullptr;   // Shown instead of the graph with waveform rendering
+        SampleBuffer samples;        // Original samples in their native type, shared with the caller's buffer
+        double samplingRate = 1;     // Rate of this channel, sample i lies at i / samplingRate
+        double offset = 0;           // Display offset added when the graph is filled
+        SignalPyramid pyramid;       // Min/max levels built from the samples
+        bool pyramidPending = false; // Levels are still being built in the background
+        SignalRangeIndex rangeIndex; // Running sums for selection statistics
+        SignalLandmarks landmarks;   // Extrema and movement landmarks of the shown samples
+        SignalStats stats;           // Range of the shown samples, for the offset and the fixed y-range
+        FilteredChannel raw;         // Unfiltered samples, pyramid and index, shown without a filter
+    };
+    QMap<QString, SignalTrack> signalTracks;
+    double signalSamplingRate;       // Highest rate of all channels
+    SignalAligner aligner;           // Shown samples of all tracks, for aligned views
+    TokenAligner tokenAligner;
+    TokenAlignment tokenAlignment;   // Alignment of the shown token overlay
+    bool waveformRendering;
+
+    // Method to refill the graphs from the pyramid level matching the visible x-range
+    void updateSignalLevelOfDetail();
+    // Method to center all channels on the middle of their joint range and fit the y-axis to it
+    void updateSignalLayout();
+
+    // Readout of all channels next to the cursor
+    bool showAllChannelValues;
+    QStringList cursorChannelNames;   // Channel names in cursorChannels order
+    QVector<double> cursorValues;     // Reused buffer for the per-move channel values
+
+    // Landmark snapping and navigation on the tracked channel
+    bool cursorSnap;
+    int cursorSnapRadius;                        // Pixels
+    int landmarkKinds;                           // Combination of SignalLandmarks::Kind
+    SignalLandmarks::Landmark cursorLandmark;    // Landmark the cursor is on, invalid if none
+
+    // Method to move the cursor x onto a landmark and remember it in cursorLandmark
+    double snapCursorToLandmark(QCustomPlot *plot, double x);
+    // Method to move the cursor to the neighbouring landmark
+    void stepLandmark(bool forward);
+
+    // Per-channel state of live acquisition
+    struct StreamTrack {
+        QCPGraph *graph = nullptr;   // Graph showing the retained window
+        double samplingRate = 1;
+        qint64 shownCount = 0;       // Samples added to the graph so far
+    };
+    QMap<QString, StreamTrack> streamTracks;
+    SignalModel signalModel;
+    SignalSnapshot streamSnapshot;   // Snapshot the graphs show
+    bool externalStreamWriter;       // Another thread writes the model
+    bool streamAppended;             // Samples appended on the GUI thread since the last publication
+    int streamGeneration;            // Clears of the model the graphs follow
+    QString streamConfigName;
+    int streamPenWidth;
+    bool followTail;                 // Keep the newest samples in view
+    bool streamDirty;                // Samples arrived since the last frame
+    double streamEndTime;            // Time of the newest sample over all channels
+    double streamMin;                // Value range seen so far, for the y-axis
+    double streamMax;
+    QTimer *streamTimer;
+
+    // Method to add the graph of a live channel, and to remove the graphs of all of them
+    StreamTrack* addStreamTrack(const QString &channel, double samplingRate);
+    void removeStreamTracks();
+
+    // Background spectrogram computation
+    SpectrogramEngine *spectrogramEngine;
+    QCPColorMap *spectrogramMap;     // Color map filled by the engine, owned by customPlot
+    float spectrogramPeak;           // Highest power (dB) received so far
+    void showSpectrogramFrames(int firstFrame, int count, int bins, const float *frames);
+
+    // Quantized spectrogram rendering
+    SpectrogramPlottable *spectrogramRaster;   // Raster plottable, owned by customPlot
+    int spectrogramQuantizationBits;           // 8, 16 or 0 for the QCPColorMap path
+    static const double spectrogramMinLevel;
+    static const double spectrogramMaxLevel;
+    static QCPColorGradient spectrogramGradient();
+
+    // Tiled spectrogram rendering
+    SpectrogramTileCache *spectrogramTiles;
+    bool spectrogramTiling;
+    float spectrogramTilePeak;       // Peak the current data range was derived from
+
+    // Background loading; the GUI thread only swaps prepared data in
+    SignalLoader *signalLoader;
+    QString pendingConfigName;       // Settings of the load in progress
+    int pendingPenWidth;
+    bool pendingSpectrogram;
+    void applySignal(PreparedSignal &&prepared, const QString &configName, int penWidth);
+    void applySpectrogram(PreparedSpectrogram &prepared);
+
+    // Memory-mapped recordings
+    SignalLoader *pyramidLoader;     // Summarizes mapped files after they are shown
+    double mappedInitialSpan;        // Seconds shown first (s)
+    static const int mappedProbeLength = 64;   // Samples read per column while the pyramid is missing
+    void applyPyramids(PreparedSignal &summary);
+
+    // Cache files of recordings
+    SignalViewCache viewCache;
+    bool viewCacheEnabled;
+    bool viewCacheVerification;      // Check the contents behind a cached summary
+    QSharedPointer<MappedSignalFile> viewCacheSource;   // Recording summarized in the background
+    QSharedPointer<MappedSignalFile> viewCacheShown;    // Recording shown from its cache while the cache is checked
+    QString spectrogramCacheRecording;                  // Recording and key of the computed spectrogram
+    QByteArray spectrogramCacheKey;
+
+    // Profiler HUD
+    QCPItemText *profilerHud;        // Created when first shown, owned by customPlot
+    QTimer *profilerHudTimer;
+
+    // Y-axis autoscale to the visible data
+    bool autoscaleY;
+    QCPRange fixedYRange;            // Range of all channels, shown while autoscale is off
+    void updateAutoscaleY();
+
+    // Derived channels, bound to the recorded channels of the current signal
+    struct DerivedTrack {
+        QCPGraph *graph = nullptr;   // Graph on the right axis, null while the sources are missing
+        DerivedChannel::Kind kind = DerivedChannel::Velocity;
+        QStringList sources;
+        int penWidth = 1;
+        double samplingRate = 1;     // Highest rate of the sources, the others are resampled to it
+        DerivedChannel channel;      // Computed window and envelope
+        quint64 envelopeGeneration = 0;   // Binding the envelope chunks being built belong to
+    };
+    QMap<QString, DerivedTrack> derivedTracks;
+    class EnvelopeTask;
+    QThreadPool derivedPool;         // Builds envelope chunks of derived channels
+    quint64 derivedGeneration;       // Increases with every binding of a derived channel
+    void bindDerivedTrack(const QString &name, DerivedTrack &track);
+    void updateDerivedLevelOfDetail();
+    void onDerivedEnvelopeReady(const QString &name, quint64 generation, const DerivedChannel &built, const QVector<int> &chunks);
+
+    // Filter stage; tracks show its result for filterSettings, or their raw samples
+    SignalFilterStage *filterStage;
+    FilterSettings filterSettings;
+    void showFilteredChannels(const QMap<QString, FilteredChannel> &filtered);
+
+    // Interaction-time render quality
+    bool adaptiveQuality;
+    bool draftQuality;                         // Graphs currently use draft pens
+    QTimer *qualityTimer;                      // Single shot, restarted by every interaction step
+    QHash<QCPGraph*, QPen> fullQualityPens;    // Pens replaced while drafting
+    QCP::AntialiasedElements fullQualityNotAntialiased;
+    bool fullQualityLegendVisible;
+    void noteInteraction();
+    void setDraftQuality(bool draft);
+
+    // Selection statistics readout
+    QCPItemText *selectionReadout;   // Created when first shown, owned by customPlot
+    bool selectionReadoutVisible;
 };
 
 #endif // KINEMATICVISUALIZER_H
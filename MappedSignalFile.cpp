@@ -0,0 +1,264 @@
+//
+// Memory-mapped signal files (WAV and raw binary) exposed as sample buffers.
+//
+
+#include "MappedSignalFile.h"
+#include <QtEndian>
+#include <limits>
+
+#ifdef Q_OS_UNIX
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// WAV format tags
+static const quint16 wavePcm = 1;
+static const quint16 waveFloat = 3;
+static const quint16 waveExtensible = 0xFFFE;
+
+// Function to set an error message if the caller asked for one
+static void setError(QString *error, const QString &message) {
+    if (error) {
+        *error = message;
+    }
+}
+
+// Constructor
+MappedSignalFile::MappedSignalFile()
+        : mapping(nullptr), mappedBytes(0), type(SampleBuffer::Int16), scale(1), rate(1), sampleCount(0) {
+}
+
+// Destructor, the mapping goes away with the last channel referring to it
+MappedSignalFile::~MappedSignalFile() {
+    if (mapping) {
+        file.unmap(mapping);
+    }
+}
+
+// Function to map a mono WAV file
+QSharedPointer<MappedSignalFile> MappedSignalFile::openWav(const QString &path, const QString &channelName, QString *error) {
+    QSharedPointer<MappedSignalFile> result(new MappedSignalFile);
+    QFile &file = result->file;
+    file.setFileName(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        setError(error, file.errorString());
+        return QSharedPointer<MappedSignalFile>();
+    }
+
+    QByteArray riff = file.read(12);
+    if (riff.size() < 12 || !riff.startsWith("RIFF") || riff.mid(8, 4) != "WAVE") {
+        setError(error, QString("%1 is not a WAV file").arg(path));
+        return QSharedPointer<MappedSignalFile>();
+    }
+
+    // Walk the chunks; only their headers are read, the samples stay on disk
+    quint16 format = 0;
+    quint16 channels = 0;
+    quint16 bitsPerSample = 0;
+    quint32 sampleRate = 0;
+    qint64 dataOffset = -1;
+    qint64 dataSize = 0;
+    while (dataOffset < 0) {
+        QByteArray header = file.read(8);
+        if (header.size() < 8) {
+            break;
+        }
+        qint64 chunkSize = qFromLittleEndian<quint32>(reinterpret_cast<const uchar *>(header.constData() + 4));
+        qint64 chunkStart = file.pos();
+
+        if (header.startsWith("fmt ")) {
+            QByteArray fmt = file.read(qMin<qint64>(chunkSize, 40));
+            if (fmt.size() < 16) {
+                break;
+            }
+            const uchar *bytes = reinterpret_cast<const uchar *>(fmt.constData());
+            format = qFromLittleEndian<quint16>(bytes);
+            channels = qFromLittleEndian<quint16>(bytes + 2);
+            sampleRate = qFromLittleEndian<quint32>(bytes + 4);
+            bitsPerSample = qFromLittleEndian<quint16>(bytes + 14);
+            if (format == waveExtensible && fmt.size() >= 26) {
+                format = qFromLittleEndian<quint16>(bytes + 24);   // First bytes of the sub-format GUID
+            }
+        } else if (header.startsWith("data")) {
+            dataOffset = chunkStart;
+            // Streaming writers leave the size open; the samples then run to the end of the file
+            dataSize = qMin(chunkSize, file.size() - chunkStart);
+            break;
+        }
+
+        // Chunks are padded to an even size
+        file.seek(chunkStart + chunkSize + (chunkSize & 1));
+    }
+
+    if (dataOffset < 0 || sampleRate == 0) {
+        setError(error, QString("%1 has no sample data").arg(path));
+        return QSharedPointer<MappedSignalFile>();
+    }
+    if (channels != 1) {
+        setError(error, QString("%1 has %2 interleaved channels, only mono files can be mapped").arg(path).arg(channels));
+        return QSharedPointer<MappedSignalFile>();
+    }
+
+    if (format == wavePcm && bitsPerSample == 16) {
+        result->type = SampleBuffer::Int16;
+        result->scale = 1.0 / 32768;
+    } else if (format == waveFloat && bitsPerSample == 32) {
+        result->type = SampleBuffer::Float32;
+    } else {
+        setError(error, QString("%1 uses an unsupported sample format").arg(path));
+        return QSharedPointer<MappedSignalFile>();
+    }
+
+    result->rate = sampleRate;
+    result->names = QStringList() << channelName;
+    if (!result->map(path, dataOffset, dataSize, error)) {
+        return QSharedPointer<MappedSignalFile>();
+    }
+    return result;
+}
+
+// Function to map a raw file with contiguous channels
+QSharedPointer<MappedSignalFile> MappedSignalFile::openRaw(const QString &path, SampleBuffer::Type type,
+                                                           const QStringList &channelNames, double samplingRate,
+                                                           qint64 headerBytes, double scale, QString *error) {
+    QSharedPointer<MappedSignalFile> result(new MappedSignalFile);
+    QFile &file = result->file;
+    file.setFileName(path);
+    if (channelNames.isEmpty() || !file.open(QIODevice::ReadOnly)) {
+        setError(error, channelNames.isEmpty() ? QString("No channels given for %1").arg(path) : file.errorString());
+        return QSharedPointer<MappedSignalFile>();
+    }
+
+    result->type = type;
+    result->scale = type == SampleBuffer::Int16 ? scale : 1;
+    result->rate = samplingRate > 0 ? samplingRate : 1;
+    result->names = channelNames;
+    if (!result->map(path, headerBytes, file.size() - headerBytes, error)) {
+        return QSharedPointer<MappedSignalFile>();
+    }
+    return result;
+}
+
+// Function to map a whole file of derived data
+QSharedPointer<MappedSignalFile> MappedSignalFile::openData(const QString &path, QString *error) {
+    QSharedPointer<MappedSignalFile> result(new MappedSignalFile);
+    QFile &file = result->file;
+    file.setFileName(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        setError(error, file.errorString());
+        return QSharedPointer<MappedSignalFile>();
+    }
+    if (file.size() <= 0) {
+        setError(error, QString("%1 is empty").arg(path));
+        return QSharedPointer<MappedSignalFile>();
+    }
+
+    result->mappedBytes = file.size();
+    result->mapping = file.map(0, result->mappedBytes);
+    if (!result->mapping) {
+        setError(error, file.errorString());
+        return QSharedPointer<MappedSignalFile>();
+    }
+    return result;
+}
+
+// Function to map the sample data and derive the channel length
+bool MappedSignalFile::map(const QString &path, qint64 offset, qint64 size, QString *error) {
+    int bytesPerSample = SampleBuffer::sampleSize(type);
+
+    // Samples are read in place, so they must sit at a multiple of their size from a page boundary
+    if (offset < 0 || size <= 0 || offset % bytesPerSample != 0) {
+        setError(error, QString("%1 has no aligned sample data").arg(path));
+        return false;
+    }
+
+    qint64 samples = size / bytesPerSample / names.size();
+    if (samples > std::numeric_limits<int>::max()) {
+        setError(error, QString("%1 has too many samples per channel").arg(path));
+        return false;
+    }
+
+    mappedBytes = samples * bytesPerSample * names.size();
+    mapping = file.map(offset, mappedBytes);
+    if (!mapping) {
+        setError(error, file.errorString());
+        return false;
+    }
+    sampleCount = static_cast<int>(samples);
+    return true;
+}
+
+// Function to get the path of the mapped file
+QString MappedSignalFile::fileName() const {
+    return file.fileName();
+}
+
+// Function to get the sampling rate
+double MappedSignalFile::samplingRate() const {
+    return rate;
+}
+
+// Function to get the number of channels
+int MappedSignalFile::channelCount() const {
+    return names.size();
+}
+
+// Function to get the channel names
+QStringList MappedSignalFile::channelNames() const {
+    return names;
+}
+
+// Function to get the number of samples per channel
+int MappedSignalFile::samplesPerChannel() const {
+    return sampleCount;
+}
+
+// Function to get the samples of one channel
+SampleBuffer MappedSignalFile::channel(int index) const {
+    if (index < 0 || index >= names.size() || !mapping) {
+        return SampleBuffer();
+    }
+    const uchar *start = mapping + static_cast<qint64>(index) * sampleCount * SampleBuffer::sampleSize(type);
+    return SampleBuffer(type, start, sampleCount, scale, sharedFromThis());
+}
+
+// Function to get the mapped bytes
+const uchar *MappedSignalFile::bytes() const {
+    return mapping;
+}
+
+// Function to get the number of mapped bytes
+qint64 MappedSignalFile::byteCount() const {
+    return mappedBytes;
+}
+
+// Function to get samples at a byte offset into the mapping
+SampleBuffer MappedSignalFile::region(qint64 offset, SampleBuffer::Type type, int count, double scale) const {
+    int bytesPerSample = SampleBuffer::sampleSize(type);
+    if (!mapping || offset < 0 || count <= 0 || offset % bytesPerSample != 0
+        || offset + static_cast<qint64>(count) * bytesPerSample > mappedBytes) {
+        return SampleBuffer();
+    }
+    return SampleBuffer(type, mapping + offset, count, scale, sharedFromThis());
+}
+
+// Function to pass an access pattern hint to the system
+void MappedSignalFile::advise(const void *address, qint64 bytes, Advice advice) {
+#ifdef Q_OS_UNIX
+    if (!address || bytes <= 0) {
+        return;
+    }
+
+    // Hints apply to whole pages
+    static const quintptr pageSize = static_cast<quintptr>(sysconf(_SC_PAGESIZE));
+    quintptr begin = reinterpret_cast<quintptr>(address) & ~(pageSize - 1);
+    quintptr end = reinterpret_cast<quintptr>(address) + static_cast<quintptr>(bytes);
+
+    int flag = advice == Sequential ? MADV_SEQUENTIAL : MADV_WILLNEED;
+    madvise(reinterpret_cast<void *>(begin), end - begin, flag);
+#else
+    Q_UNUSED(address);
+    Q_UNUSED(bytes);
+    Q_UNUSED(advice);
+#endif
+}
@@ -0,0 +1,71 @@
+//
+// Memory-mapped signal files (WAV and raw binary) exposed as sample buffers.
+//
+
+#ifndef MAPPEDSIGNALFILE_H
+#define MAPPEDSIGNALFILE_H
+
+#include <QEnableSharedFromThis>
+#include <QFile>
+#include <QSharedPointer>
+#include <QString>
+#include <QStringList>
+#include "SampleBuffer.h"
+
+// MappedSignalFile maps a recording into memory without reading it. Its channels are sample
+// buffers pointing into the mapping, so only pages that are actually accessed become resident
+// and the system can drop them again at any time. Channels must be stored contiguously:
+// mono WAV files, or raw files with one block per channel.
+class MappedSignalFile : public QEnableSharedFromThis<MappedSignalFile> {
+public:
+    // Access pattern hints passed on to the system
+    enum Advice { WillNeed, Sequential };
+
+    // Map a mono PCM16 or float32 WAV file; returns null and sets error on failure
+    static QSharedPointer<MappedSignalFile> openWav(const QString &path, const QString &channelName, QString *error = nullptr);
+
+    // Map a raw file holding channelNames.size() equally long channels one after another,
+    // starting at headerBytes; 16-bit samples are multiplied by scale
+    static QSharedPointer<MappedSignalFile> openRaw(const QString &path, SampleBuffer::Type type,
+                                                    const QStringList &channelNames, double samplingRate,
+                                                    qint64 headerBytes = 0, double scale = 1, QString *error = nullptr);
+
+    // Map a whole file of derived data, e.g. a view cache; it has no channels, its contents are
+    // read with bytes() and region()
+    static QSharedPointer<MappedSignalFile> openData(const QString &path, QString *error = nullptr);
+
+    ~MappedSignalFile();
+
+    QString fileName() const;
+    double samplingRate() const;
+    int channelCount() const;
+    QStringList channelNames() const;
+    int samplesPerChannel() const;
+
+    // Samples of one channel, sharing the mapping
+    SampleBuffer channel(int index) const;
+
+    // Mapped bytes, and count samples at offset bytes into them sharing the mapping; the buffer
+    // is empty if the samples lie outside the mapping or are not aligned to their size
+    const uchar *bytes() const;
+    qint64 byteCount() const;
+    SampleBuffer region(qint64 offset, SampleBuffer::Type type, int count, double scale = 1) const;
+
+    // Pass an access pattern hint for a byte range of any mapping to the system
+    static void advise(const void *address, qint64 bytes, Advice advice);
+
+private:
+    MappedSignalFile();
+    bool map(const QString &path, qint64 offset, qint64 size, QString *error);
+
+    QFile file;
+    uchar *mapping;                  // Start of the mapped sample data
+    qint64 mappedBytes;
+    SampleBuffer::Type type;
+    double scale;
+    double rate;
+    QStringList names;
+    int sampleCount;                 // Samples per channel
+};
+
+#endif // MAPPEDSIGNALFILE_H
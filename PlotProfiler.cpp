@@ -0,0 +1,380 @@
+//
+// Frame-time instrumentation of the replot, cursor and sync paths.
+//
+
+#include "PlotProfiler.h"
+#include "qcustomplot.h"
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QStringList>
+#include <algorithm>
+
+// Length of one rate window (ns)
+static const qint64 rateWindow = 1000000000;
+
+// Trace events kept by default
+static const int defaultTraceCapacity = 100000;
+
+// Function to get the average duration in milliseconds
+double ProfileCounter::averageMilliseconds() const {
+    return count > 0 ? totalNanoseconds / 1e6 / count : 0;
+}
+
+// Function to get the longest duration in milliseconds
+double ProfileCounter::maxMilliseconds() const {
+    return maxNanoseconds / 1e6;
+}
+
+// Function to get the profiler shared by all plots
+PlotProfiler *PlotProfiler::instance() {
+    static PlotProfiler *profiler = new PlotProfiler;
+    return profiler;
+}
+
+// Constructor
+PlotProfiler::PlotProfiler(QObject *parent)
+        : QObject(parent), enabled(false), dropped(0), nextPlotNumber(1),
+          traceCapacity(defaultTraceCapacity), traceNext(0) {
+    clock.start();
+}
+
+// Constructor of a scope, takes the start time if the profiler is on
+PlotProfiler::Scope::Scope(const char *section, QCustomPlot *plot)
+        : section(section), plot(plot), start(-1) {
+    PlotProfiler *profiler = PlotProfiler::instance();
+    if (profiler->isEnabled()) {
+        start = profiler->now();
+    }
+}
+
+// Destructor of a scope, records the section
+PlotProfiler::Scope::~Scope() {
+    if (start >= 0) {
+        PlotProfiler *profiler = PlotProfiler::instance();
+        profiler->recordSection(section, plot, start, profiler->now() - start);
+    }
+}
+
+// Function to switch recording on or off
+void PlotProfiler::setEnabled(bool on) {
+    if (enabled == on) {
+        return;
+    }
+    enabled = on;
+    emit enabledChanged(enabled);
+}
+
+// Function to set how many trace events are kept
+void PlotProfiler::setTraceCapacity(int events) {
+    traceCapacity = qMax(0, events);
+    trace.clear();
+    traceNext = 0;
+}
+
+// Function to get the current time on the profiler's clock
+qint64 PlotProfiler::now() const {
+    return clock.nsecsElapsed();
+}
+
+// Function to add one duration to a counter
+void PlotProfiler::add(ProfileCounter &counter, qint64 nanoseconds) {
+    ++counter.count;
+    counter.totalNanoseconds += nanoseconds;
+    counter.maxNanoseconds = qMax(counter.maxNanoseconds, nanoseconds);
+}
+
+// Function to store one event in the ring buffer
+void PlotProfiler::appendTrace(const TraceEvent &event) {
+    if (traceCapacity == 0) {
+        return;
+    }
+    if (trace.size() < traceCapacity) {
+        trace.append(event);
+    } else {
+        trace[traceNext] = event;
+    }
+    traceNext = (traceNext + 1) % traceCapacity;
+}
+
+// Function to count one event in its rate window
+void PlotProfiler::tickRate(RateWindow &window, qint64 time) {
+    if (window.windowCount == 0 && window.lastRate == 0) {
+        window.windowStart = time;
+    } else if (time - window.windowStart >= rateWindow) {
+        window.lastRate = window.windowCount * 1e9 / (time - window.windowStart);
+        window.windowStart = time;
+        window.windowCount = 0;
+    }
+    ++window.windowCount;
+}
+
+// Function to get a stable name for a plot: its object name, or a number in order of appearance
+QString PlotProfiler::plotName(QCustomPlot *plot) {
+    if (!plot) {
+        return QString();
+    }
+    auto it = plotNames.find(plot);
+    if (it == plotNames.end()) {
+        QString name = plot->objectName().isEmpty() ? QString("plot %1").arg(nextPlotNumber++) : plot->objectName();
+        it = plotNames.insert(plot, name);
+        connect(plot, &QObject::destroyed, this, [this, plot]() {
+            plotNames.remove(plot);
+            replotStarts.remove(plot);
+        });
+    }
+    return it.value();
+}
+
+// Function to record one timed section
+void PlotProfiler::recordSection(const char *section, QCustomPlot *plot, qint64 startNanoseconds, qint64 nanoseconds) {
+    if (!enabled) {
+        return;
+    }
+    add(sections[QString::fromLatin1(section)], nanoseconds);
+
+    TraceEvent event;
+    event.name = section;
+    event.category = "section";
+    event.plot = plotName(plot);
+    event.start = startNanoseconds;
+    event.duration = nanoseconds;
+    appendTrace(event);
+}
+
+// Function to record one full or layer replot
+void PlotProfiler::recordReplot(QCustomPlot *plot, const QString &layer, qint64 startNanoseconds, qint64 nanoseconds) {
+    if (!enabled) {
+        return;
+    }
+    QString name = plotName(plot);
+    add(replots[qMakePair(name, layer)], nanoseconds);
+
+    TraceEvent event;
+    event.label = layer;
+    event.category = "replot";
+    event.plot = name;
+    event.start = startNanoseconds;
+    event.duration = nanoseconds;
+    appendTrace(event);
+}
+
+// Function to record one flushed frame and the frame slots it missed
+void PlotProfiler::recordFrame(qint64 startNanoseconds, qint64 nanoseconds, int droppedFrames) {
+    if (!enabled) {
+        return;
+    }
+    add(frames, nanoseconds);
+    dropped += qMax(0, droppedFrames);
+    tickRate(frameRate, startNanoseconds);
+
+    TraceEvent event;
+    event.label = droppedFrames > 0 ? QString("frame (%1 dropped)").arg(droppedFrames) : QString("frame");
+    event.category = "frame";
+    event.start = startNanoseconds;
+    event.duration = nanoseconds;
+    appendTrace(event);
+}
+
+// Function to count one input or update event, e.g. a mouse move
+void PlotProfiler::countEvent(const char *name) {
+    if (!enabled) {
+        return;
+    }
+    tickRate(eventRates[QString::fromLatin1(name)], now());
+}
+
+// Function to time the full replots of a plot
+void PlotProfiler::watch(QCustomPlot *plot) {
+    if (!plot) {
+        return;
+    }
+    connect(plot, &QCustomPlot::beforeReplot, this, [this, plot]() {
+        if (enabled) {
+            replotStarts.insert(plot, now());
+        }
+    });
+    connect(plot, &QCustomPlot::afterReplot, this, [this, plot]() {
+        auto it = replotStarts.find(plot);
+        if (it != replotStarts.end()) {
+            qint64 start = it.value();
+            replotStarts.erase(it);
+            recordReplot(plot, QString(), start, now() - start);
+        }
+    });
+}
+
+// Function to get the totals of all timed sections
+QHash<QString, ProfileCounter> PlotProfiler::sectionCounters() const {
+    return sections;
+}
+
+// Function to get the replot totals per plot and layer
+QList<ReplotCounter> PlotProfiler::replotCounters() const {
+    QList<ReplotCounter> result;
+    for (auto it = replots.cbegin(); it != replots.cend(); ++it) {
+        ReplotCounter entry;
+        entry.plot = it.key().first;
+        entry.layer = it.key().second;
+        entry.counter = it.value();
+        result.append(entry);
+    }
+    std::sort(result.begin(), result.end(), [](const ReplotCounter &a, const ReplotCounter &b) {
+        return a.plot != b.plot ? a.plot < b.plot : a.layer < b.layer;
+    });
+    return result;
+}
+
+// Function to get the rate of one event over the last complete second
+double PlotProfiler::eventsPerSecond(const QString &name) const {
+    auto it = eventRates.constFind(name);
+    if (it == eventRates.constEnd()) {
+        return 0;
+    }
+    const RateWindow &window = it.value();
+    qint64 age = now() - window.windowStart;
+    if (age >= 2 * rateWindow) {
+        return 0;   // Nothing arrived to close the previous window
+    }
+    return age >= rateWindow ? window.windowCount * 1e9 / age : window.lastRate;
+}
+
+// Function to get the flushed frames per second over the last complete second
+double PlotProfiler::framesPerSecond() const {
+    qint64 age = now() - frameRate.windowStart;
+    if (frames.count == 0 || age >= 2 * rateWindow) {
+        return 0;
+    }
+    return age >= rateWindow ? frameRate.windowCount * 1e9 / age : frameRate.lastRate;
+}
+
+// Function to get the number of flushed frames
+qint64 PlotProfiler::frameCount() const {
+    return frames.count;
+}
+
+// Function to get the number of frame slots missed
+qint64 PlotProfiler::droppedFrames() const {
+    return dropped;
+}
+
+// Function to get the flush durations
+ProfileCounter PlotProfiler::frameCounter() const {
+    return frames;
+}
+
+// Function to summarize the counters in a few lines
+QString PlotProfiler::summary() const {
+    QStringList lines;
+    lines << QString("frames %1/s  dropped %2  flush avg %3 ms max %4 ms")
+            .arg(framesPerSecond(), 0, 'f', 0).arg(dropped)
+            .arg(frames.averageMilliseconds(), 0, 'f', 2).arg(frames.maxMilliseconds(), 0, 'f', 2);
+
+    QStringList sectionNames = sections.keys();
+    std::sort(sectionNames.begin(), sectionNames.end());
+    for (const QString &name : sectionNames) {
+        const ProfileCounter &counter = sections[name];
+        lines << QString("%1 avg %2 ms max %3 ms  n %4")
+                .arg(name).arg(counter.averageMilliseconds(), 0, 'f', 3)
+                .arg(counter.maxMilliseconds(), 0, 'f', 3).arg(counter.count);
+    }
+
+    ProfileCounter replotTotal;
+    for (const ProfileCounter &counter : replots) {
+        replotTotal.count += counter.count;
+        replotTotal.totalNanoseconds += counter.totalNanoseconds;
+        replotTotal.maxNanoseconds = qMax(replotTotal.maxNanoseconds, counter.maxNanoseconds);
+    }
+    lines << QString("replot avg %1 ms max %2 ms  n %3")
+            .arg(replotTotal.averageMilliseconds(), 0, 'f', 3)
+            .arg(replotTotal.maxMilliseconds(), 0, 'f', 3).arg(replotTotal.count);
+
+    QStringList eventNames = eventRates.keys();
+    std::sort(eventNames.begin(), eventNames.end());
+    for (const QString &name : eventNames) {
+        lines << QString("%1 %2/s").arg(name).arg(eventsPerSecond(name), 0, 'f', 0);
+    }
+    return lines.join('\n');
+}
+
+// Function to build Chrome trace JSON of the events in the buffer, oldest first
+QByteArray PlotProfiler::chromeTrace() const {
+    QJsonArray events;
+
+    QJsonObject threadName;
+    threadName["name"] = "thread_name";
+    threadName["ph"] = "M";
+    threadName["pid"] = 1;
+    threadName["tid"] = 1;
+    threadName["args"] = QJsonObject{{"name", "GUI"}};
+    events.append(threadName);
+
+    int count = trace.size();
+    int oldest = count < traceCapacity ? 0 : traceNext;
+    for (int i = 0; i < count; ++i) {
+        const TraceEvent &event = trace[(oldest + i) % count];
+        QJsonObject object;
+        if (event.name) {
+            object["name"] = QString::fromLatin1(event.name);
+        } else if (qstrcmp(event.category, "replot") == 0) {
+            object["name"] = event.label.isEmpty() ? QString("replot") : QString("replot %1").arg(event.label);
+        } else {
+            object["name"] = event.label;
+        }
+        object["cat"] = QString::fromLatin1(event.category);
+        object["ph"] = "X";
+        object["pid"] = 1;
+        object["tid"] = 1;
+        object["ts"] = event.start / 1000.0;            // Microseconds
+        object["dur"] = event.duration / 1000.0;
+        QJsonObject args;
+        if (!event.plot.isEmpty()) {
+            args["plot"] = event.plot;
+        }
+        if (!event.label.isEmpty() && qstrcmp(event.category, "replot") == 0) {
+            args["layer"] = event.label;
+        }
+        if (!args.isEmpty()) {
+            object["args"] = args;
+        }
+        events.append(object);
+    }
+
+    QJsonObject root;
+    root["traceEvents"] = events;
+    root["displayTimeUnit"] = "ms";
+    return QJsonDocument(root).toJson(QJsonDocument::Compact);
+}
+
+// Function to write the trace to a file
+bool PlotProfiler::exportChromeTrace(const QString &path, QString *error) const {
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        if (error) {
+            *error = file.errorString();
+        }
+        return false;
+    }
+    QByteArray json = chromeTrace();
+    if (file.write(json) != json.size()) {
+        if (error) {
+            *error = file.errorString();
+        }
+        return false;
+    }
+    return true;
+}
+
+// Function to clear all counters and the trace
+void PlotProfiler::reset() {
+    sections.clear();
+    replots.clear();
+    eventRates.clear();
+    frameRate = RateWindow();
+    frames = ProfileCounter();
+    dropped = 0;
+    replotStarts.clear();
+    trace.clear();
+    traceNext = 0;
+}
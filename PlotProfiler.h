@@ -0,0 +1,142 @@
+//
+// Frame-time instrumentation of the replot, cursor and sync paths.
+//
+
+#ifndef PLOTPROFILER_H
+#define PLOTPROFILER_H
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QPair>
+#include <QString>
+#include <QVector>
+
+class QCustomPlot;
+
+// Timing totals of one instrumented section or plot layer
+struct ProfileCounter {
+    qint64 count = 0;
+    qint64 totalNanoseconds = 0;
+    qint64 maxNanoseconds = 0;
+
+    double averageMilliseconds() const;
+    double maxMilliseconds() const;
+};
+
+// Replot totals of one layer of one plot; layer is empty for full replots
+struct ReplotCounter {
+    QString plot;
+    QString layer;
+    ProfileCounter counter;
+};
+
+// PlotProfiler collects durations of replots, cursor updates, selection updates and axis sync,
+// event rates and frame statistics of the GUI thread. It is off by default; while off, every
+// hook is a single flag test. Recent events are kept in a bounded buffer and can be exported
+// in the Chrome trace format (chrome://tracing, Perfetto) for bug reports.
+class PlotProfiler : public QObject {
+    Q_OBJECT
+
+public:
+    // Profiler shared by all plots of the GUI thread
+    static PlotProfiler *instance();
+
+    void setEnabled(bool enabled);
+    bool isEnabled() const { return enabled; }
+
+    // Number of trace events kept; older ones are overwritten
+    void setTraceCapacity(int events);
+
+    // Times the enclosing block as one section, e.g. "cursor" or "sync"
+    class Scope {
+    public:
+        explicit Scope(const char *section, QCustomPlot *plot = nullptr);
+        ~Scope();
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+
+    private:
+        const char *section;
+        QCustomPlot *plot;
+        qint64 start;                // -1 while the profiler is off
+    };
+
+    // Record calls for code that cannot use a scope
+    void recordSection(const char *section, QCustomPlot *plot, qint64 startNanoseconds, qint64 nanoseconds);
+    void recordReplot(QCustomPlot *plot, const QString &layer, qint64 startNanoseconds, qint64 nanoseconds);
+    void recordFrame(qint64 startNanoseconds, qint64 nanoseconds, int dropped);
+    void countEvent(const char *name);
+
+    // Time base of all recorded start times
+    qint64 now() const;
+
+    // Full replots of a plot are timed through its replot signals
+    void watch(QCustomPlot *plot);
+
+    // Queries
+    QHash<QString, ProfileCounter> sectionCounters() const;
+    QList<ReplotCounter> replotCounters() const;
+    double eventsPerSecond(const QString &name) const;   // Over the last complete second
+    double framesPerSecond() const;
+    qint64 frameCount() const;
+    qint64 droppedFrames() const;
+    ProfileCounter frameCounter() const;
+
+    // Short multi-line digest for the on-plot HUD
+    QString summary() const;
+
+    // Recent events as Chrome trace JSON
+    QByteArray chromeTrace() const;
+    bool exportChromeTrace(const QString &path, QString *error = nullptr) const;
+
+    void reset();
+
+signals:
+    // Enabled or disabled, so HUDs can follow
+    void enabledChanged(bool enabled);
+
+private:
+    explicit PlotProfiler(QObject *parent = nullptr);
+
+    // One completed span of the trace
+    struct TraceEvent {
+        const char *name = nullptr;  // Section name, or nullptr for replots and frames
+        QString label;               // Replot layer or frame label
+        const char *category = nullptr;
+        QString plot;
+        qint64 start = 0;
+        qint64 duration = 0;
+    };
+
+    // Events counted in fixed one-second windows
+    struct RateWindow {
+        qint64 windowStart = 0;
+        qint64 windowCount = 0;
+        double lastRate = 0;
+    };
+
+    void appendTrace(const TraceEvent &event);
+    void tickRate(RateWindow &window, qint64 time);
+    QString plotName(QCustomPlot *plot);
+    static void add(ProfileCounter &counter, qint64 nanoseconds);
+
+    bool enabled;
+    QElapsedTimer clock;
+    QHash<QString, ProfileCounter> sections;
+    QHash<QPair<QString, QString>, ProfileCounter> replots;   // (plot, layer)
+    QHash<QString, RateWindow> eventRates;
+    RateWindow frameRate;
+    ProfileCounter frames;
+    qint64 dropped;
+    QHash<QCustomPlot*, QString> plotNames;
+    QHash<QCustomPlot*, qint64> replotStarts;                 // Full replots in progress
+    int nextPlotNumber;
+    QVector<TraceEvent> trace;                                 // Ring buffer
+    int traceCapacity;
+    int traceNext;                                             // Slot written next
+};
+
+#endif // PLOTPROFILER_H
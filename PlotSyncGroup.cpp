@@ -0,0 +1,131 @@
+//
+// Group of plots sharing cursor, x-range and selection.
+//
+
+#include "PlotSyncGroup.h"
+#include "ReplotScheduler.h"
+#include "qcustomplot.h"
+
+// Constructor
+PlotSyncGroup::PlotSyncGroup(QObject *parent)
+        : QObject(parent), broadcasting(false) {
+}
+
+// Function to get the group of plots without an explicit group
+PlotSyncGroup *PlotSyncGroup::defaultGroup() {
+    static PlotSyncGroup *group = new PlotSyncGroup;
+    return group;
+}
+
+// Function to add a plot to the group
+void PlotSyncGroup::join(QCustomPlot *plot, QCPItemLine *cursorLine) {
+    if (!plot || members.contains(plot)) {
+        return;
+    }
+    members.append(plot);
+    cursorLines.insert(plot, cursorLine);
+}
+
+// Function to remove a plot from the group
+void PlotSyncGroup::leave(QCustomPlot *plot) {
+    if (selectionRect && selectionRect->parentPlot() == plot) {
+        clearSelection();
+    }
+    members.removeAll(plot);
+    cursorLines.remove(plot);
+}
+
+// Function to check whether a plot is a member
+bool PlotSyncGroup::contains(QCustomPlot *plot) const {
+    return cursorLines.contains(plot);
+}
+
+// Function to get the member plots
+QList<QCustomPlot*> PlotSyncGroup::plots() const {
+    return members;
+}
+
+// Function to get the cursor line of a member plot
+QCPItemLine *PlotSyncGroup::cursorLine(QCustomPlot *plot) const {
+    return cursorLines.value(plot, nullptr);
+}
+
+// Function to move the cursor line of every member to time x
+void PlotSyncGroup::setCursor(double x) {
+    for (QCustomPlot *plot : members) {
+        QCPItemLine *line = cursorLines.value(plot);
+        if (line) {
+            line->start->setCoords(x, plot->yAxis->range().lower);
+            line->end->setCoords(x, plot->yAxis->range().upper);
+            line->setVisible(true);
+            ReplotScheduler::instance()->requestLayerReplot(plot, "overlay");
+        }
+    }
+}
+
+// Function to hide the cursor line of every member
+void PlotSyncGroup::hideCursor() {
+    for (QCustomPlot *plot : members) {
+        QCPItemLine *line = cursorLines.value(plot);
+        if (line && line->visible()) {
+            line->setVisible(false);
+            ReplotScheduler::instance()->requestLayerReplot(plot, "overlay");
+        }
+    }
+}
+
+// Function to apply the x-range of one member to all others
+void PlotSyncGroup::setXRange(QCustomPlot *source, const QCPRange &range) {
+    if (broadcasting) {
+        return;
+    }
+    broadcasting = true;
+    for (QCustomPlot *plot : members) {
+        if (plot != source) {
+            plot->xAxis->setRange(range);
+            ReplotScheduler::instance()->requestReplot(plot);
+        }
+    }
+    broadcasting = false;
+}
+
+// Function to check whether a range broadcast is in progress
+bool PlotSyncGroup::isBroadcasting() const {
+    return broadcasting;
+}
+
+// Function to get the selection rectangle of the group
+QCPItemRect *PlotSyncGroup::selection() const {
+    return selectionRect;
+}
+
+// Function to replace the selection rectangle of the group
+void PlotSyncGroup::setSelection(QCPItemRect *rect) {
+    if (selectionRect == rect) {
+        return;
+    }
+    clearSelection();
+    selectionRect = rect;
+    emit selectionChanged();
+}
+
+// Function to remove the selection rectangle from its plot
+void PlotSyncGroup::clearSelection() {
+    if (selectionRect) {
+        // Only the plot that holds the rectangle changes
+        QCustomPlot *plot = selectionRect->parentPlot();
+        if (plot) {
+            plot->removeItem(selectionRect);
+            ReplotScheduler::instance()->requestReplot(plot);
+        }
+        selectionRect = nullptr;
+        emit selectionChanged();
+    }
+}
+
+// Function to tell the group that the selection was resized
+void PlotSyncGroup::notifySelectionChanged() {
+    if (selectionRect) {
+        emit selectionChanged();
+    }
+}
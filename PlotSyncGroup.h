@@ -0,0 +1,64 @@
+//
+// Group of plots sharing cursor, x-range and selection.
+//
+
+#ifndef PLOTSYNCGROUP_H
+#define PLOTSYNCGROUP_H
+
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QPointer>
+
+class QCustomPlot;
+class QCPItemLine;
+class QCPItemRect;
+class QCPRange;
+
+// PlotSyncGroup scopes cursor, x-range and selection broadcasts to the plots of one document.
+// Plots join with the item line they use as cursor; every broadcast only touches the members
+// of the group, so several recordings can be compared side by side without interfering.
+class PlotSyncGroup : public QObject {
+    Q_OBJECT
+
+public:
+    explicit PlotSyncGroup(QObject *parent = nullptr);
+
+    // Group used by plots that were not assigned one explicitly
+    static PlotSyncGroup *defaultGroup();
+
+    // Membership; the cursor line is owned by the plot
+    void join(QCustomPlot *plot, QCPItemLine *cursorLine);
+    void leave(QCustomPlot *plot);
+    bool contains(QCustomPlot *plot) const;
+    QList<QCustomPlot*> plots() const;
+    QCPItemLine *cursorLine(QCustomPlot *plot) const;
+
+    // Show the cursor at time x in every plot of the group, or hide it
+    void setCursor(double x);
+    void hideCursor();
+
+    // Apply an x-range change of one plot to the other plots of the group
+    void setXRange(QCustomPlot *source, const QCPRange &range);
+    // True while setXRange() updates the other plots, so they do not broadcast back
+    bool isBroadcasting() const;
+
+    // The one selection of the group, held by one of its plots
+    QCPItemRect *selection() const;
+    void setSelection(QCPItemRect *rect);
+    void clearSelection();
+    // Called by the plot holding the selection after it moved the rectangle's edges
+    void notifySelectionChanged();
+
+signals:
+    // The selection was replaced, cleared or resized
+    void selectionChanged();
+
+private:
+    QList<QCustomPlot*> members;                  // In join order
+    QHash<QCustomPlot*, QCPItemLine*> cursorLines;
+    QPointer<QCPItemRect> selectionRect;           // Null once its plot deleted it
+    bool broadcasting;
+};
+
+#endif // PLOTSYNCGROUP_H
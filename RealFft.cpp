@@ -0,0 +1,131 @@
+//
+// Power-of-two real FFT used by the spectrogram engine.
+//
+
+#include "RealFft.h"
+#include <cmath>
+
+// Function to round a sample count up to a supported FFT size
+int RealFft::sizeFor(int samples) {
+    int size = 4;
+    while (size < samples) {
+        size <<= 1;
+    }
+    return size;
+}
+
+// Constructor, precomputes the bit-reversal permutation and all twiddle factors
+RealFft::RealFft(int size)
+        : n(sizeFor(size)), half(n / 2) {
+    const double twoPi = 2.0 * M_PI;
+
+    bitReverse.resize(half);
+    int bits = 0;
+    while ((1 << bits) < half) {
+        ++bits;
+    }
+    for (int i = 0; i < half; ++i) {
+        int reversed = 0;
+        for (int bit = 0; bit < bits; ++bit) {
+            if (i & (1 << bit)) {
+                reversed |= 1 << (bits - 1 - bit);
+            }
+        }
+        bitReverse[i] = reversed;
+    }
+
+    // Stage with butterfly span len uses exp(-2*pi*i*j/len) for j < len/2
+    stageCos.reserve(half);
+    stageSin.reserve(half);
+    for (int len = 2; len <= half; len <<= 1) {
+        for (int j = 0; j < len / 2; ++j) {
+            stageCos.append(static_cast<float>(std::cos(twoPi * j / len)));
+            stageSin.append(static_cast<float>(-std::sin(twoPi * j / len)));
+        }
+    }
+
+    // Twiddles exp(-2*pi*i*k/n) for recombining the packed even/odd spectrum
+    splitCos.resize(half + 1);
+    splitSin.resize(half + 1);
+    for (int k = 0; k <= half; ++k) {
+        splitCos[k] = static_cast<float>(std::cos(twoPi * k / n));
+        splitSin[k] = static_cast<float>(-std::sin(twoPi * k / n));
+    }
+
+    re.resize(half);
+    im.resize(half);
+}
+
+// Function to get the transform size
+int RealFft::size() const {
+    return n;
+}
+
+// Function to get the number of non-redundant output bins
+int RealFft::binCount() const {
+    return half + 1;
+}
+
+// Function to run the in-place complex FFT on the scratch arrays
+void RealFft::transformHalf() {
+    float *real = re.data();
+    float *imag = im.data();
+    const float *twiddleCos = stageCos.constData();
+    const float *twiddleSin = stageSin.constData();
+
+    for (int len = 2; len <= half; len <<= 1) {
+        int halfLen = len / 2;
+        for (int start = 0; start < half; start += len) {
+            float *aRe = real + start;
+            float *aIm = imag + start;
+            float *bRe = aRe + halfLen;
+            float *bIm = aIm + halfLen;
+            for (int j = 0; j < halfLen; ++j) {
+                float tRe = bRe[j] * twiddleCos[j] - bIm[j] * twiddleSin[j];
+                float tIm = bRe[j] * twiddleSin[j] + bIm[j] * twiddleCos[j];
+                bRe[j] = aRe[j] - tRe;
+                bIm[j] = aIm[j] - tIm;
+                aRe[j] += tRe;
+                aIm[j] += tIm;
+            }
+        }
+        twiddleCos += halfLen;
+        twiddleSin += halfLen;
+    }
+}
+
+// Function to compute the power spectrum of a real frame
+void RealFft::powerSpectrum(const float *input, float *power) {
+    // Pack even samples into the real part and odd samples into the imaginary part
+    const int *order = bitReverse.constData();
+    float *real = re.data();
+    float *imag = im.data();
+    for (int i = 0; i < half; ++i) {
+        int source = order[i];
+        real[i] = input[2 * source];
+        imag[i] = input[2 * source + 1];
+    }
+
+    transformHalf();
+
+    // Separate the even/odd spectra and combine them into the real spectrum
+    const float *wCos = splitCos.constData();
+    const float *wSin = splitSin.constData();
+    for (int k = 0; k <= half; ++k) {
+        int a = (k == half) ? 0 : k;
+        int b = (k == 0) ? 0 : half - k;
+        float zRe = real[a];
+        float zIm = imag[a];
+        float cRe = real[b];
+        float cIm = -imag[b];
+
+        float evenRe = 0.5f * (zRe + cRe);
+        float evenIm = 0.5f * (zIm + cIm);
+        float oddRe = 0.5f * (zIm - cIm);
+        float oddIm = -0.5f * (zRe - cRe);
+
+        float xRe = evenRe + wCos[k] * oddRe - wSin[k] * oddIm;
+        float xIm = evenIm + wCos[k] * oddIm + wSin[k] * oddRe;
+        power[k] = xRe * xRe + xIm * xIm;
+    }
+}
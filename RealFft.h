@@ -0,0 +1,42 @@
+//
+// Power-of-two real FFT used by the spectrogram engine.
+//
+
+#ifndef REALFFT_H
+#define REALFFT_H
+
+#include <QVector>
+
+// RealFft transforms N real samples through one N/2-point complex FFT.
+// Data is kept in split real/imaginary arrays with per-stage twiddle tables,
+// so every butterfly loop runs over contiguous memory and vectorizes.
+// An instance holds scratch buffers and must not be shared between threads.
+class RealFft {
+public:
+    // Size is rounded up to the next power of two (at least 4)
+    explicit RealFft(int size);
+
+    int size() const;
+    int binCount() const;   // size() / 2 + 1
+
+    // Power spectrum |X[k]|^2 of size() real samples, written to binCount() outputs
+    void powerSpectrum(const float *input, float *power);
+
+    // Smallest supported FFT size that holds the requested number of samples
+    static int sizeFor(int samples);
+
+private:
+    void transformHalf();
+
+    int n;        // Real transform size
+    int half;     // Complex transform size
+    QVector<int> bitReverse;
+    QVector<float> stageCos;    // Twiddles of all butterfly stages, stage after stage
+    QVector<float> stageSin;
+    QVector<float> splitCos;    // Twiddles for separating the real spectrum
+    QVector<float> splitSin;
+    QVector<float> re;          // Scratch, half entries each
+    QVector<float> im;
+};
+
+#endif // REALFFT_H
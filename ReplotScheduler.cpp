@@ -0,0 +1,170 @@
+//
+// Frame-coalesced replot scheduling for all plots of the process.
+//
+
+#include "ReplotScheduler.h"
+#include "qcustomplot.h"
+#include "PlotProfiler.h"
+#include <QEvent>
+
+// Function to get the scheduler shared by all plots
+ReplotScheduler *ReplotScheduler::instance() {
+    static ReplotScheduler *scheduler = new ReplotScheduler;
+    return scheduler;
+}
+
+// Constructor
+ReplotScheduler::ReplotScheduler(QObject *parent)
+        : QObject(parent), frameInterval(16), flushDue(-1) {
+    flushTimer.setSingleShot(true);
+    flushTimer.setTimerType(Qt::PreciseTimer);
+    connect(&flushTimer, &QTimer::timeout, this, &ReplotScheduler::flush);
+}
+
+// Function to mark a plot for a full replot
+void ReplotScheduler::requestReplot(QCustomPlot *plot) {
+    if (!plot) {
+        return;
+    }
+    Request &request = requestFor(plot);
+    request.full = true;
+    request.layers.clear();
+    scheduleFlush();
+}
+
+// Function to mark a layer of a plot for repainting
+void ReplotScheduler::requestLayerReplot(QCustomPlot *plot, const QString &layerName) {
+    if (!plot) {
+        return;
+    }
+    Request &request = requestFor(plot);
+    if (!request.full) {
+        request.layers.insert(layerName);
+    }
+    scheduleFlush();
+}
+
+// Function to set the minimum time between flushes
+void ReplotScheduler::setFrameInterval(int milliseconds) {
+    frameInterval = qMax(0, milliseconds);
+}
+
+// Function to get the pending request of a plot, watching plots seen for the first time
+ReplotScheduler::Request &ReplotScheduler::requestFor(QCustomPlot *plot) {
+    if (!watched.contains(plot)) {
+        watched.insert(plot);
+        plot->installEventFilter(this);
+        connect(plot, &QObject::destroyed, this, [this, plot]() {
+            pending.remove(plot);
+            deferred.remove(plot);
+            watched.remove(plot);
+        });
+    }
+
+    Request &request = pending[plot];
+    request.plot = plot;
+    return request;
+}
+
+// Function to start the flush timer so the next flush is one frame after the previous one
+void ReplotScheduler::scheduleFlush() {
+    if (flushTimer.isActive()) {
+        return;
+    }
+    qint64 wait = 0;
+    if (sinceLastFlush.isValid()) {
+        wait = qMax<qint64>(0, frameInterval - sinceLastFlush.elapsed());
+    }
+    flushTimer.start(static_cast<int>(wait));
+    flushDue = PlotProfiler::instance()->now() + wait * 1000000;
+}
+
+// Function to merge the work of one request into another
+void ReplotScheduler::merge(Request &into, const Request &from) {
+    into.full = into.full || from.full;
+    if (into.full) {
+        into.layers.clear();   // A full replot repaints every layer anyway
+    } else {
+        into.layers.unite(from.layers);
+    }
+}
+
+// Function to check whether any part of a plot is on screen
+bool ReplotScheduler::isOnScreen(QCustomPlot *plot) {
+    // The visible region is empty when a scroll area or another widget clips the plot away
+    return plot->isVisible() && !plot->visibleRegion().isEmpty();
+}
+
+// Function to replot everything pending
+void ReplotScheduler::flush() {
+    flushTimer.stop();
+    sinceLastFlush.restart();
+    PlotProfiler *profiler = PlotProfiler::instance();
+    qint64 frameStart = profiler->isEnabled() ? profiler->now() : -1;
+
+    QHash<QCustomPlot*, Request> work;
+    work.swap(pending);
+
+    for (auto it = work.begin(); it != work.end(); ++it) {
+        Request &request = it.value();
+        QCustomPlot *plot = request.plot;
+        if (!plot) {
+            continue;
+        }
+
+        // Work skipped while the plot was off screen is done together with the new request
+        auto waiting = deferred.find(it.key());
+        if (waiting != deferred.end()) {
+            merge(request, *waiting);
+            deferred.erase(waiting);
+        }
+
+        if (!isOnScreen(plot)) {
+            deferred.insert(it.key(), request);
+            continue;
+        }
+
+        if (request.full) {
+            // Render now, paint with the next regular widget update; timed through the replot signals
+            plot->replot(QCustomPlot::rpQueuedRefresh);
+        } else {
+            for (const QString &name : request.layers) {
+                if (QCPLayer *layer = plot->layer(name)) {
+                    qint64 layerStart = frameStart >= 0 ? profiler->now() : -1;
+                    layer->replot();
+                    // Unbuffered layers fall back to a full replot, which is counted as such
+                    if (layerStart >= 0 && layer->mode() == QCPLayer::lmBuffered) {
+                        profiler->recordReplot(plot, name, layerStart, profiler->now() - layerStart);
+                    }
+                }
+            }
+        }
+    }
+
+    // A frame that started late or ran long covers the frame slots it missed
+    if (frameStart >= 0) {
+        qint64 duration = profiler->now() - frameStart;
+        int dropped = 0;
+        if (frameInterval > 0 && flushDue >= 0) {
+            qint64 late = qMax<qint64>(0, frameStart - flushDue);
+            dropped = static_cast<int>((late + duration) / (frameInterval * qint64(1000000)));
+        }
+        profiler->recordFrame(frameStart, duration, dropped);
+    }
+    flushDue = -1;
+}
+
+// Event filter bringing deferred plots up to date when they are shown or scrolled into view
+bool ReplotScheduler::eventFilter(QObject *object, QEvent *event) {
+    if (event->type() == QEvent::Show || event->type() == QEvent::Paint) {
+        QCustomPlot *plot = static_cast<QCustomPlot*>(object);
+        auto waiting = deferred.find(plot);
+        if (waiting != deferred.end()) {
+            Request &request = requestFor(plot);
+            merge(request, *waiting);
+            deferred.erase(waiting);
+            scheduleFlush();
+        }
+    }
+    return QObject::eventFilter(object, event);
+}
@@ -0,0 +1,68 @@
+//
+// Frame-coalesced replot scheduling for all plots of the process.
+//
+
+#ifndef REPLOTSCHEDULER_H
+#define REPLOTSCHEDULER_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QObject>
+#include <QPointer>
+#include <QSet>
+#include <QString>
+#include <QTimer>
+
+class QCustomPlot;
+
+// ReplotScheduler collects replot requests and flushes them at most once per display frame.
+// Repeated requests for the same plot or layer within a frame collapse into one, a full
+// replot absorbs pending layer replots, and plots that are hidden or scrolled out of view
+// are only replotted once they become visible again.
+class ReplotScheduler : public QObject {
+    Q_OBJECT
+
+public:
+    // Scheduler shared by all plots of the GUI thread
+    static ReplotScheduler *instance();
+
+    // Mark a plot for a full replot in the next frame
+    void requestReplot(QCustomPlot *plot);
+
+    // Mark one buffered layer of a plot, e.g. a cursor overlay, for repainting in the next frame
+    void requestLayerReplot(QCustomPlot *plot, const QString &layerName);
+
+    // Replot everything pending right away
+    void flush();
+
+    // Minimum time between two flushes (ms)
+    void setFrameInterval(int milliseconds);
+
+protected:
+    bool eventFilter(QObject *object, QEvent *event) override;
+
+private:
+    explicit ReplotScheduler(QObject *parent = nullptr);
+
+    // Pending work of one plot
+    struct Request {
+        QPointer<QCustomPlot> plot;
+        bool full = false;
+        QSet<QString> layers;
+    };
+
+    Request &requestFor(QCustomPlot *plot);
+    void scheduleFlush();
+    static void merge(Request &into, const Request &from);
+    static bool isOnScreen(QCustomPlot *plot);
+
+    QHash<QCustomPlot*, Request> pending;   // Replotted in the next frame
+    QHash<QCustomPlot*, Request> deferred;  // Waiting for the plot to become visible
+    QSet<QCustomPlot*> watched;             // Plots with the event filter installed
+    QTimer flushTimer;
+    QElapsedTimer sinceLastFlush;
+    int frameInterval;
+    qint64 flushDue;                        // Profiler time the timed flush should run at, -1 if none
+};
+
+#endif // REPLOTSCHEDULER_H
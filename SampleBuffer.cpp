@@ -0,0 +1,123 @@
+//
+// Typed, implicitly shared sample storage for signal channels.
+//
+
+#include "SampleBuffer.h"
+#include "MappedSignalFile.h"
+
+// Constructor for an empty buffer
+SampleBuffer::SampleBuffer()
+        : sampleType(Float64), sampleScale(1), mappedData(nullptr), mappedCount(0) {
+}
+
+// Constructor sharing double samples
+SampleBuffer::SampleBuffer(const QVector<double> &samples)
+        : sampleType(Float64), sampleScale(1), float64Samples(samples), mappedData(nullptr), mappedCount(0) {
+}
+
+// Constructor sharing float samples
+SampleBuffer::SampleBuffer(const QVector<float> &samples)
+        : sampleType(Float32), sampleScale(1), float32Samples(samples), mappedData(nullptr), mappedCount(0) {
+}
+
+// Constructor sharing 16-bit samples with their scale factor
+SampleBuffer::SampleBuffer(const QVector<qint16> &samples, double scale)
+        : sampleType(Int16), sampleScale(scale), int16Samples(samples), mappedData(nullptr), mappedCount(0) {
+}
+
+// Constructor referring to samples inside a mapped file
+SampleBuffer::SampleBuffer(Type type, const void *mappedSamples, int count, double scale,
+                           const QSharedPointer<const MappedSignalFile> &file)
+        : sampleType(type), sampleScale(type == Int16 ? scale : 1), mappedData(mappedSamples),
+          mappedCount(mappedSamples ? qMax(0, count) : 0), mappedFile(file) {
+}
+
+// Function to get the stored type
+SampleBuffer::Type SampleBuffer::type() const {
+    return sampleType;
+}
+
+// Function to get the number of samples
+int SampleBuffer::size() const {
+    if (mappedData) {
+        return mappedCount;
+    }
+    switch (sampleType) {
+        case Int16:
+            return int16Samples.size();
+        case Float32:
+            return float32Samples.size();
+        case Float64:
+            return float64Samples.size();
+    }
+    return 0;
+}
+
+// Function to check whether the buffer holds no samples
+bool SampleBuffer::isEmpty() const {
+    return size() == 0;
+}
+
+// Function to get the scale factor
+double SampleBuffer::scale() const {
+    return sampleScale;
+}
+
+// Function to get the bytes held by the samples
+qint64 SampleBuffer::byteCount() const {
+    return static_cast<qint64>(size()) * sampleSize();
+}
+
+// Function to get the bytes per stored sample
+int SampleBuffer::sampleSize() const {
+    return sampleSize(sampleType);
+}
+
+// Function to get the bytes per sample of a type
+int SampleBuffer::sampleSize(Type type) {
+    switch (type) {
+        case Int16:
+            return sizeof(qint16);
+        case Float32:
+            return sizeof(float);
+        case Float64:
+            return sizeof(double);
+    }
+    return 0;
+}
+
+// Function to check whether the samples live in a mapped file
+bool SampleBuffer::isMapped() const {
+    return mappedData != nullptr;
+}
+
+// Function to announce reads of a sample range
+void SampleBuffer::prefetch(int first, int last) const {
+    first = qMax(0, first);
+    last = qMin(mappedCount - 1, last);
+    if (!mappedData || last < first) {
+        return;
+    }
+    const char *begin = static_cast<const char *>(mappedData) + static_cast<qint64>(first) * sampleSize();
+    MappedSignalFile::advise(begin, static_cast<qint64>(last - first + 1) * sampleSize(), MappedSignalFile::WillNeed);
+}
+
+// Function to announce one sequential pass over all samples
+void SampleBuffer::adviseSequential() const {
+    if (mappedData) {
+        MappedSignalFile::advise(mappedData, byteCount(), MappedSignalFile::Sequential);
+    }
+}
+
+// Function to get the physical value of one sample
+double SampleBuffer::valueAt(int index) const {
+    switch (sampleType) {
+        case Int16:
+            return data<qint16>()[index] * sampleScale;
+        case Float32:
+            return data<float>()[index];
+        case Float64:
+            return data<double>()[index];
+    }
+    return 0.0;
+}
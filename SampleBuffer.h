@@ -0,0 +1,127 @@
+//
+// Typed, implicitly shared sample storage for signal channels.
+//
+
+#ifndef SAMPLEBUFFER_H
+#define SAMPLEBUFFER_H
+
+#include <QSharedPointer>
+#include <QVector>
+#include <QtGlobal>
+
+class MappedSignalFile;
+
+// SampleBuffer keeps the samples of a channel in their native type: 16-bit integers with a
+// scale factor (value = sample * scale), 32-bit floats or doubles. Buffers are shared with the
+// QVector they were created from, or point into a memory-mapped file that they keep open.
+// Loops over samples use visit(), which dispatches once on the type and hands the raw array
+// to a generic function, so they run on the native type.
+class SampleBuffer {
+public:
+    enum Type { Int16, Float32, Float64 };
+
+    SampleBuffer();
+    SampleBuffer(const QVector<double> &samples);
+    SampleBuffer(const QVector<float> &samples);
+    SampleBuffer(const QVector<qint16> &samples, double scale);
+
+    // Samples inside a mapping owned by file; nothing is read until the samples are accessed
+    SampleBuffer(Type type, const void *mappedSamples, int count, double scale,
+                 const QSharedPointer<const MappedSignalFile> &file);
+
+    Type type() const;
+    int size() const;
+    bool isEmpty() const;
+
+    // Factor from stored to physical values, 1 for floating point buffers
+    double scale() const;
+
+    // Bytes held by the samples
+    qint64 byteCount() const;
+
+    // Bytes per stored sample
+    int sampleSize() const;
+    static int sampleSize(Type type);
+
+    // True if the samples live in a memory-mapped file
+    bool isMapped() const;
+
+    // Hint that samples first..last will be read soon, or that the whole buffer will be
+    // read once front to back; both are no-ops for buffers held in memory
+    void prefetch(int first, int last) const;
+    void adviseSequential() const;
+
+    // Physical value of one sample
+    double valueAt(int index) const;
+
+    // Raw array of the stored type; nullptr unless T matches type()
+    template <typename T>
+    const T *data() const;
+
+    // Call function(const T *samples, int count) with the stored type T
+    template <typename Function>
+    void visit(Function &&function) const {
+        switch (sampleType) {
+            case Int16:
+                function(data<qint16>(), size());
+                break;
+            case Float32:
+                function(data<float>(), size());
+                break;
+            case Float64:
+                function(data<double>(), size());
+                break;
+        }
+    }
+
+private:
+    Type sampleType;
+    double sampleScale;
+    QVector<qint16> int16Samples;     // Only the vector of sampleType is used
+    QVector<float> float32Samples;
+    QVector<double> float64Samples;
+
+    // Mapped storage, used instead of the vectors when mappedData is set
+    const void *mappedData;
+    int mappedCount;
+    QSharedPointer<const MappedSignalFile> mappedFile;
+};
+
+template <>
+inline const qint16 *SampleBuffer::data<qint16>() const {
+    if (sampleType != Int16) {
+        return nullptr;
+    }
+    return mappedData ? static_cast<const qint16 *>(mappedData) : int16Samples.constData();
+}
+
+template <>
+inline const float *SampleBuffer::data<float>() const {
+    if (sampleType != Float32) {
+        return nullptr;
+    }
+    return mappedData ? static_cast<const float *>(mappedData) : float32Samples.constData();
+}
+
+template <>
+inline const double *SampleBuffer::data<double>() const {
+    if (sampleType != Float64) {
+        return nullptr;
+    }
+    return mappedData ? static_cast<const double *>(mappedData) : float64Samples.constData();
+}
+
+// Buffer of the same type as T, used to store values derived from typed samples
+inline SampleBuffer makeSampleBuffer(const QVector<qint16> &samples, double scale) {
+    return SampleBuffer(samples, scale);
+}
+
+inline SampleBuffer makeSampleBuffer(const QVector<float> &samples, double) {
+    return SampleBuffer(samples);
+}
+
+inline SampleBuffer makeSampleBuffer(const QVector<double> &samples, double) {
+    return SampleBuffer(samples);
+}
+
+#endif // SAMPLEBUFFER_H
@@ -0,0 +1,120 @@
+//
+// Uniformly sampled channel storage used for cursor readout.
+//
+
+#include "SignalChannelStore.h"
+
+// Function to interpolate between the two samples around a position, in stored units
+template <typename T>
+static double interpolateSamples(const T *data, int count, double position) {
+    if (position <= 0) {
+        return data[0];
+    } else if (position >= count - 1) {
+        return data[count - 1];
+    }
+
+    int index = static_cast<int>(position);
+    double fraction = position - index;
+    return data[index] + (static_cast<double>(data[index + 1]) - data[index]) * fraction;
+}
+
+// Function to interpolate the channel value at a given time
+double SignalChannel::valueAt(double time) const {
+    if (samples.isEmpty()) {
+        return 0.0;
+    }
+
+    // Samples are uniformly spaced, so the neighbours follow directly from the time
+    double position = time * samplingRate;
+    double value = 0.0;
+    samples.visit([&value, position](const auto *data, int count) {
+        value = interpolateSamples(data, count, position);
+    });
+    return value * samples.scale();
+}
+
+// Function to add or replace a channel
+void SignalChannelStore::setChannel(const QString &name, const SampleBuffer &samples, double samplingRate) {
+    auto it = channelIndex.constFind(name);
+    if (it == channelIndex.constEnd()) {
+        channelIndex.insert(name, channels.size());
+        channels.append(SignalChannel());
+        it = channelIndex.constFind(name);
+    }
+
+    SignalChannel &channel = channels[it.value()];
+    channel.name = name;
+    channel.samples = samples;
+    channel.samplingRate = samplingRate > 0 ? samplingRate : 1;
+}
+
+// Function to remove a channel
+void SignalChannelStore::removeChannel(const QString &name) {
+    auto it = channelIndex.find(name);
+    if (it == channelIndex.end()) {
+        return;
+    }
+
+    int index = it.value();
+    channelIndex.erase(it);
+    channels.remove(index);
+
+    // Channels behind the removed one moved one slot forward
+    for (auto indexIt = channelIndex.begin(); indexIt != channelIndex.end(); ++indexIt) {
+        if (indexIt.value() > index) {
+            --indexIt.value();
+        }
+    }
+}
+
+// Function to remove all channels
+void SignalChannelStore::clear() {
+    channels.clear();
+    channelIndex.clear();
+}
+
+// Function to check whether a channel exists
+bool SignalChannelStore::contains(const QString &name) const {
+    return channelIndex.contains(name);
+}
+
+// Function to check whether the store has no channels
+bool SignalChannelStore::isEmpty() const {
+    return channels.isEmpty();
+}
+
+// Function to get the number of channels
+int SignalChannelStore::channelCount() const {
+    return channels.size();
+}
+
+// Function to get the channel names in storage order
+QStringList SignalChannelStore::channelNames() const {
+    QStringList names;
+    names.reserve(channels.size());
+    for (const SignalChannel &channel : channels) {
+        names.append(channel.name);
+    }
+    return names;
+}
+
+// Function to look up a channel by name
+const SignalChannel *SignalChannelStore::channel(const QString &name) const {
+    auto it = channelIndex.constFind(name);
+    return it == channelIndex.constEnd() ? nullptr : &channels[it.value()];
+}
+
+// Function to get the value of one channel at a given time
+double SignalChannelStore::valueAt(const QString &name, double time) const {
+    const SignalChannel *found = channel(name);
+    return found ? found->valueAt(time) : 0.0;
+}
+
+// Function to get the values of all channels at a given time
+void SignalChannelStore::valuesAt(double time, QVector<double> &values) const {
+    values.resize(channels.size());
+    double *out = values.data();
+    for (int i = 0; i < channels.size(); ++i) {
+        out[i] = channels[i].valueAt(time);
+    }
+}
@@ -0,0 +1,53 @@
+//
+// Uniformly sampled channel storage used for cursor readout.
+//
+
+#ifndef SIGNALCHANNELSTORE_H
+#define SIGNALCHANNELSTORE_H
+
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include "SampleBuffer.h"
+
+// One channel: a contiguous value array on an implicit time axis t = index / samplingRate
+struct SignalChannel {
+    QString name;
+    SampleBuffer samples;        // Native type, read without conversion to double
+    double samplingRate = 1;
+
+    // Linearly interpolated value at the given time, clamped to the channel ends
+    double valueAt(double time) const;
+};
+
+// SignalChannelStore keeps any number of named channels and resolves values by index arithmetic
+class SignalChannelStore {
+public:
+    // Add or replace a channel; the sample buffer is shared, not copied
+    void setChannel(const QString &name, const SampleBuffer &samples, double samplingRate);
+    void removeChannel(const QString &name);
+    void clear();
+
+    bool contains(const QString &name) const;
+    bool isEmpty() const;
+    int channelCount() const;
+
+    // Channel names in insertion order, matching the order of valuesAt()
+    QStringList channelNames() const;
+
+    // Channel lookup, nullptr if the channel does not exist
+    const SignalChannel *channel(const QString &name) const;
+
+    // Value of one channel at the given time, 0 for unknown or empty channels
+    double valueAt(const QString &name, double time) const;
+
+    // Values of all channels at the given time, written into a caller-owned buffer
+    void valuesAt(double time, QVector<double> &values) const;
+
+private:
+    QVector<SignalChannel> channels;    // Contiguous channel array
+    QHash<QString, int> channelIndex;   // Channel name to position in channels
+};
+
+#endif // SIGNALCHANNELSTORE_H
@@ -0,0 +1,264 @@
+//
+// Zero-phase Butterworth filtering of signal channels on a worker pool.
+//
+
+#include "SignalFilter.h"
+#include <QRunnable>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+// Function to compare filter settings
+bool FilterSettings::operator==(const FilterSettings &other) const {
+    if (type == None || other.type == None) {
+        return type == other.type;
+    }
+    return type == other.type && cutoff == other.cutoff && order == other.order;
+}
+
+// Function to hash filter settings
+uint qHash(const FilterSettings &settings, uint seed) {
+    if (settings.type == FilterSettings::None) {
+        return seed;
+    }
+    return qHash(settings.cutoff, seed) ^ (static_cast<uint>(settings.type) << 8) ^ static_cast<uint>(settings.order);
+}
+
+// Function to design the second-order sections of a Butterworth filter
+QVector<Biquad> designButterworth(const FilterSettings &settings, double samplingRate) {
+    QVector<Biquad> sections;
+    if (!settings.isActive() || samplingRate <= 0 || settings.cutoff <= 0 || settings.cutoff >= samplingRate / 2) {
+        return sections;
+    }
+
+    // Bilinear transform prewarped at the cutoff; each section takes one conjugate pole pair
+    int order = qBound(2, settings.order + (settings.order & 1), 8);
+    double w0 = 2 * M_PI * settings.cutoff / samplingRate;
+    double cosW0 = std::cos(w0);
+    double sinW0 = std::sin(w0);
+    for (int k = 0; k < order / 2; ++k) {
+        double q = 1 / (2 * std::cos(M_PI * (2 * k + 1) / (2.0 * order)));
+        double alpha = sinW0 / (2 * q);
+        double a0 = 1 + alpha;
+        Biquad section;
+        if (settings.type == FilterSettings::LowPass) {
+            section.b0 = (1 - cosW0) / 2 / a0;
+            section.b1 = (1 - cosW0) / a0;
+            section.b2 = section.b0;
+        } else {
+            section.b0 = (1 + cosW0) / 2 / a0;
+            section.b1 = -(1 + cosW0) / a0;
+            section.b2 = section.b0;
+        }
+        section.a1 = -2 * cosW0 / a0;
+        section.a2 = (1 - alpha) / a0;
+        sections.append(section);
+    }
+    return sections;
+}
+
+// Function to run one section over a buffer in transposed direct form II, starting from the
+// state a constant input equal to the first value would have settled to
+static void runSection(const Biquad &s, float *data, int count, int step) {
+    double input = data[0];
+    double gain = (s.b0 + s.b1 + s.b2) / (1 + s.a1 + s.a2);
+    double z2 = (s.b2 - s.a2 * gain) * input;
+    double z1 = (gain - s.b0) * input;
+
+    // The recursion carries from sample to sample; only two state variables stay in registers.
+    // Walking an index keeps a backward run from forming a pointer in front of the buffer
+    for (qint64 k = 0; k < count; ++k) {
+        float &value = data[k * step];
+        double x = value;
+        double y = s.b0 * x + z1;
+        z1 = s.b1 * x - s.a1 * y + z2;
+        z2 = s.b2 * x - s.a2 * y;
+        value = static_cast<float>(y);
+    }
+}
+
+// Function to copy typed samples into the middle of the work buffer, with odd extensions at both ends
+template <typename T>
+static void extend(const T *samples, int count, double scale, int pad, float *work) {
+    float *middle = work + pad;
+    for (int i = 0; i < count; ++i) {
+        middle[i] = static_cast<float>(samples[i] * scale);
+    }
+    double head = middle[0];
+    double tail = middle[count - 1];
+    for (int k = 1; k <= pad; ++k) {
+        work[pad - k] = static_cast<float>(2 * head - middle[k]);
+        middle[count - 1 + k] = static_cast<float>(2 * tail - middle[count - 1 - k]);
+    }
+}
+
+// Function to filter a channel forward and backward
+SampleBuffer filterZeroPhase(const SampleBuffer &samples, const QVector<Biquad> &sections, const QAtomicInt *cancelled) {
+    int count = samples.size();
+    if (count == 0 || sections.isEmpty()) {
+        return samples;
+    }
+
+    // Extension long enough for the start-up of the cascade, as in common filtfilt defaults
+    int pad = std::min(count - 1, 3 * (2 * sections.size() + 1));
+    QVector<float> work(count + 2 * pad);
+    samples.visit([&](const auto *data, int) {
+        extend(data, count, samples.scale(), pad, work.data());
+    });
+
+    int length = work.size();
+    for (const Biquad &section : sections) {
+        if (cancelled && cancelled->loadRelaxed()) {
+            return SampleBuffer();
+        }
+        runSection(section, work.data(), length, 1);
+    }
+    for (const Biquad &section : sections) {
+        if (cancelled && cancelled->loadRelaxed()) {
+            return SampleBuffer();
+        }
+        runSection(section, work.data() + length - 1, length, -1);
+    }
+
+    QVector<float> result(count);
+    std::memcpy(result.data(), work.constData() + pad, sizeof(float) * count);
+    return SampleBuffer(result);
+}
+
+// State of one request, shared between the stage and its channel tasks
+struct SignalFilterStage::Job {
+    FilterSettings settings;
+    QAtomicInt cancelled;
+    int remaining = 0;                          // Channels still running, GUI thread only
+    QMap<QString, FilteredChannel> channels;    // Finished channels, GUI thread only
+};
+
+// Worker filtering one channel
+class SignalFilterStage::FilterTask : public QRunnable {
+public:
+    FilterTask(SignalFilterStage *stage, const QSharedPointer<Job> &job, const QString &name,
+               const SampleBuffer &samples, double samplingRate)
+            : stage(stage), job(job), name(name), samples(samples), samplingRate(samplingRate) {}
+
+    void run() override {
+        if (job->cancelled.loadRelaxed()) {
+            return;
+        }
+        FilteredChannel channel;
+        // Channels may differ in rate, so each designs its own sections
+        channel.samples = filterZeroPhase(samples, designButterworth(job->settings, samplingRate), &job->cancelled);
+        if (job->cancelled.loadRelaxed()) {
+            return;
+        }
+        channel.pyramid.build(channel.samples);
+        channel.rangeIndex.build(channel.samples);
+        channel.landmarks.build(channel.samples, samplingRate);
+        channel.stats = computeSignalStats(channel.samples);
+
+        SignalFilterStage *target = stage;
+        QSharedPointer<Job> finishedJob = job;
+        QString finishedName = name;
+        QMetaObject::invokeMethod(target, [target, finishedJob, finishedName, channel]() {
+            target->onChannelFiltered(finishedJob, finishedName, channel);
+        }, Qt::QueuedConnection);
+    }
+
+private:
+    SignalFilterStage *stage;
+    QSharedPointer<Job> job;
+    QString name;
+    SampleBuffer samples;
+    double samplingRate;
+};
+
+// Constructor
+SignalFilterStage::SignalFilterStage(QObject *parent)
+        : QObject(parent) {
+    setMemoryBudget(512ll * 1024 * 1024);
+}
+
+// Destructor, workers must not outlive the stage they report to
+SignalFilterStage::~SignalFilterStage() {
+    cancel();
+    pool.waitForDone();
+}
+
+// Function to set the recording to filter
+void SignalFilterStage::setSource(const QMap<QString, SampleBuffer> &channels, const QMap<QString, double> &samplingRates) {
+    cancel();
+    source = channels;
+    this->samplingRates = samplingRates;
+    cache.clear();
+    lastSettings = FilterSettings();
+    lastResult.clear();
+}
+
+// Function to set the memory budget of the cache
+void SignalFilterStage::setMemoryBudget(qint64 bytes) {
+    cache.setMaxCost(static_cast<int>(qBound<qint64>(1, bytes / 1024, std::numeric_limits<int>::max())));
+}
+
+// Function to start filtering unless the result is cached
+bool SignalFilterStage::request(const FilterSettings &settings) {
+    if (!settings.isActive() || source.isEmpty() || (settings == lastSettings && !lastResult.isEmpty()) || cache.contains(settings)) {
+        return true;
+    }
+    if (job && job->settings == settings) {
+        return false;   // Already running
+    }
+
+    cancel();
+    job.reset(new Job);
+    job->settings = settings;
+    job->remaining = source.size();
+    for (auto it = source.cbegin(); it != source.cend(); ++it) {
+        pool.start(new FilterTask(this, job, it.key(), it.value(), samplingRates.value(it.key(), 1)));
+    }
+    return false;
+}
+
+// Function to get the filtered channels for a setting
+QMap<QString, FilteredChannel> SignalFilterStage::result(const FilterSettings &settings) const {
+    if (settings == lastSettings && !lastResult.isEmpty()) {
+        return lastResult;
+    }
+    if (QMap<QString, FilteredChannel> *cached = cache.object(settings)) {
+        return *cached;
+    }
+    return QMap<QString, FilteredChannel>();
+}
+
+// Function to stop the running request
+void SignalFilterStage::cancel() {
+    if (job) {
+        job->cancelled.storeRelaxed(1);
+        job.reset();
+    }
+    pool.clear();   // Queued channels of the dropped request do not start
+}
+
+// Function called on the GUI thread when a worker finished one channel
+void SignalFilterStage::onChannelFiltered(const QSharedPointer<Job> &finishedJob, const QString &name, const FilteredChannel &channel) {
+    // Channels of a replaced or cancelled request are dropped
+    if (finishedJob != job) {
+        return;
+    }
+    job->channels.insert(name, channel);
+    if (--job->remaining > 0) {
+        return;
+    }
+
+    // Cost is the size of the filtered samples and their indexes, in kilobytes
+    qint64 bytes = 0;
+    for (const FilteredChannel &filtered : job->channels) {
+        bytes += filtered.samples.byteCount() * 3 / 2;
+    }
+    lastSettings = job->settings;
+    lastResult = job->channels;
+    cache.insert(job->settings, new QMap<QString, FilteredChannel>(job->channels),
+                 static_cast<int>(qMin<qint64>(bytes / 1024 + 1, std::numeric_limits<int>::max())));
+    FilterSettings settings = job->settings;
+    job.reset();
+    emit ready(settings);
+}
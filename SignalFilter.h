@@ -0,0 +1,108 @@
+//
+// Zero-phase Butterworth filtering of signal channels on a worker pool.
+//
+
+#ifndef SIGNALFILTER_H
+#define SIGNALFILTER_H
+
+#include <QAtomicInt>
+#include <QCache>
+#include <QMap>
+#include <QObject>
+#include <QSharedPointer>
+#include <QString>
+#include <QThreadPool>
+#include <QVector>
+#include "SampleBuffer.h"
+#include "SignalLandmarks.h"
+#include "SignalPyramid.h"
+#include "SignalRangeIndex.h"
+#include "SignalStats.h"
+
+// Filter applied to all channels of a recording
+struct FilterSettings {
+    enum Type { None, LowPass, HighPass };
+
+    Type type = None;
+    double cutoff = 0;           // -6 dB frequency of the zero-phase response (Hz)
+    int order = 4;               // Order of the one-way filter, even, 2 to 8
+
+    bool isActive() const { return type != None; }
+    bool operator==(const FilterSettings &other) const;
+    bool operator!=(const FilterSettings &other) const { return !(*this == other); }
+};
+
+uint qHash(const FilterSettings &settings, uint seed = 0);
+
+// One second-order section, normalized so a0 = 1
+struct Biquad {
+    double b0 = 1;
+    double b1 = 0;
+    double b2 = 0;
+    double a1 = 0;
+    double a2 = 0;
+};
+
+// Butterworth cascade for the settings; empty if the cutoff is not below the Nyquist frequency
+QVector<Biquad> designButterworth(const FilterSettings &settings, double samplingRate);
+
+// Run the cascade forward and backward over the samples (odd extension at the ends, start-up
+// states for a constant input), so the result has no phase shift. The result is stored as floats.
+// Returns an empty buffer once cancelled becomes non-zero.
+SampleBuffer filterZeroPhase(const SampleBuffer &samples, const QVector<Biquad> &sections,
+                             const QAtomicInt *cancelled = nullptr);
+
+// A filtered channel with what the widget derives from its samples
+struct FilteredChannel {
+    SampleBuffer samples;
+    SignalPyramid pyramid;
+    SignalRangeIndex rangeIndex;
+    SignalLandmarks landmarks;
+    SignalStats stats;
+};
+
+// SignalFilterStage filters all channels of a recording in parallel, one task per channel, and
+// caches the results per filter setting, so switching between settings seen before is immediate.
+// Requests for a new setting replace a running one.
+class SignalFilterStage : public QObject {
+    Q_OBJECT
+
+public:
+    explicit SignalFilterStage(QObject *parent = nullptr);
+    ~SignalFilterStage();
+
+    // Set the recording to filter and the rate of every channel; drops cached results of the previous one
+    void setSource(const QMap<QString, SampleBuffer> &channels, const QMap<QString, double> &samplingRates);
+
+    // Start filtering with the settings unless cached; returns true if result() is ready now
+    bool request(const FilterSettings &settings);
+
+    // Filtered channels for the settings, empty unless ready
+    QMap<QString, FilteredChannel> result(const FilterSettings &settings) const;
+
+    // Upper bound of memory held by cached results
+    void setMemoryBudget(qint64 bytes);
+
+    // Stop the running request
+    void cancel();
+
+signals:
+    // All channels were filtered with the settings
+    void ready(const FilterSettings &settings);
+
+private:
+    struct Job;
+    class FilterTask;
+
+    void onChannelFiltered(const QSharedPointer<Job> &finishedJob, const QString &name, const FilteredChannel &channel);
+
+    QThreadPool pool;                // Workers owned by this stage, one channel each
+    QMap<QString, SampleBuffer> source;
+    QMap<QString, double> samplingRates;
+    QCache<FilterSettings, QMap<QString, FilteredChannel>> cache;   // LRU, cost in kilobytes
+    FilterSettings lastSettings;     // Most recent result, kept even if the cache cannot hold it
+    QMap<QString, FilteredChannel> lastResult;
+    QSharedPointer<Job> job;
+};
+
+#endif // SIGNALFILTER_H
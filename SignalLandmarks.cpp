@@ -0,0 +1,251 @@
+//
+// Landmark index of movement extrema, velocity peaks and onsets for cursor snapping and navigation.
+//
+
+#include "SignalLandmarks.h"
+#include <algorithm>
+#include <cmath>
+
+// Distance in samples below which a landmark counts as lying at a position
+static const double positionTolerance = 0.01;
+
+// Function to get the array of a kind
+int SignalLandmarks::slot(Kind kind) {
+    int index = 0;
+    while (index < kindCount - 1 && !(kind & (1 << index))) {
+        ++index;
+    }
+    return index;
+}
+
+// Function to find the extrema and the movements between them in the stored sample type
+template <typename T>
+void SignalLandmarks::buildLandmarks(const T *samples, int count, double samplingRate, const LandmarkSettings &settings) {
+    T low = samples[0];
+    T high = samples[0];
+    for (int i = 1; i < count; ++i) {
+        low = std::min(low, samples[i]);
+        high = std::max(high, samples[i]);
+    }
+
+    // Swings are compared in stored units; the scale factor does not change which ones are large enough
+    double delta = settings.prominence * (static_cast<double>(high) - low);
+    if (delta <= 0) {
+        return;
+    }
+
+    // Turning points confirmed by a swing of at least delta in the opposite direction; until the
+    // first swing, the direction is open and the lowest and highest samples are both candidates
+    QVector<int> turns;
+    QVector<bool> turnIsMaximum;
+    int direction = 0;
+    int lowest = 0;
+    int highest = 0;
+    int candidate = 0;
+    for (int i = 1; i < count; ++i) {
+        double value = samples[i];
+        if (direction == 0) {
+            if (value > samples[highest]) {
+                highest = i;
+            }
+            if (value < samples[lowest]) {
+                lowest = i;
+            }
+            if (static_cast<double>(samples[highest]) - samples[lowest] >= delta) {
+                bool rising = highest > lowest;
+                turns.append(rising ? lowest : highest);
+                turnIsMaximum.append(!rising);
+                direction = rising ? 1 : -1;
+                candidate = rising ? highest : lowest;
+            }
+        } else if (direction > 0) {
+            if (value > samples[candidate]) {
+                candidate = i;
+            } else if (samples[candidate] - value >= delta) {
+                turns.append(candidate);
+                turnIsMaximum.append(true);
+                direction = -1;
+                candidate = i;
+            }
+        } else {
+            if (value < samples[candidate]) {
+                candidate = i;
+            } else if (value - samples[candidate] >= delta) {
+                turns.append(candidate);
+                turnIsMaximum.append(false);
+                direction = 1;
+                candidate = i;
+            }
+        }
+    }
+
+    for (int k = 0; k < turns.size(); ++k) {
+        indexes[slot(turnIsMaximum[k] ? Maximum : Minimum)].append(turns[k]);
+    }
+
+    // Speed as the change over the velocity span centred on a sample, in stored units per span
+    int half = std::max(1, static_cast<int>(std::lround(settings.velocitySpan * samplingRate / 2)));
+    auto speed = [&](int i) {
+        return std::abs(static_cast<double>(samples[std::min(i + half, count - 1)]) - samples[std::max(i - half, 0)]);
+    };
+
+    // Every movement runs from one turning point to the next
+    for (int k = 0; k + 1 < turns.size(); ++k) {
+        int start = turns[k];
+        int end = turns[k + 1];
+        int peak = start;
+        double peakSpeed = 0;
+        for (int i = start; i <= end; ++i) {
+            double s = speed(i);
+            if (s > peakSpeed) {
+                peakSpeed = s;
+                peak = i;
+            }
+        }
+        if (peakSpeed <= 0) {
+            continue;
+        }
+
+        double threshold = settings.onsetThreshold * peakSpeed;
+        int onset = start;
+        while (onset < peak && speed(onset) < threshold) {
+            ++onset;
+        }
+        int offset = end;
+        while (offset > peak && speed(offset) < threshold) {
+            --offset;
+        }
+        indexes[slot(Onset)].append(onset);
+        indexes[slot(VelocityPeak)].append(peak);
+        indexes[slot(Offset)].append(offset);
+    }
+}
+
+// Function to build the landmarks of a channel
+void SignalLandmarks::build(const SampleBuffer &samples, double samplingRate, const LandmarkSettings &settings) {
+    clear();
+    if (samples.size() < 3 || samplingRate <= 0 || samplingRate > settings.maximumRate) {
+        return;
+    }
+    samples.visit([&](const auto *data, int count) {
+        buildLandmarks(data, count, samplingRate, settings);
+    });
+}
+
+// Function to drop all landmarks
+void SignalLandmarks::clear() {
+    for (QVector<int> &kind : indexes) {
+        kind.clear();
+    }
+}
+
+// Function to check whether there are any landmarks
+bool SignalLandmarks::isEmpty() const {
+    return count() == 0;
+}
+
+// Function to count the landmarks of some kinds
+int SignalLandmarks::count(int kinds) const {
+    int total = 0;
+    for (int k = 0; k < kindCount; ++k) {
+        if (kinds & (1 << k)) {
+            total += indexes[k].size();
+        }
+    }
+    return total;
+}
+
+// Function to find the nearest landmark of some kinds
+SignalLandmarks::Landmark SignalLandmarks::nearest(double position, int kinds) const {
+    Landmark result;
+    double bestDistance = 0;
+    for (int k = 0; k < kindCount; ++k) {
+        const QVector<int> &kind = indexes[k];
+        if (!(kinds & (1 << k)) || kind.isEmpty()) {
+            continue;
+        }
+
+        // The nearest one is the first at or after the position, or the one before it
+        auto it = std::lower_bound(kind.constBegin(), kind.constEnd(), position,
+                                   [](int index, double value) { return index < value; });
+        auto consider = [&](int index) {
+            double distance = std::abs(index - position);
+            if (!result.isValid() || distance < bestDistance) {
+                result.index = index;
+                result.kind = static_cast<Kind>(1 << k);
+                bestDistance = distance;
+            }
+        };
+        if (it != kind.constBegin()) {
+            consider(*(it - 1));
+        }
+        if (it != kind.constEnd()) {
+            consider(*it);
+        }
+    }
+    return result;
+}
+
+// Function to find the first landmark of some kinds after a position
+SignalLandmarks::Landmark SignalLandmarks::next(double position, int kinds) const {
+    Landmark result;
+    for (int k = 0; k < kindCount; ++k) {
+        const QVector<int> &kind = indexes[k];
+        if (!(kinds & (1 << k))) {
+            continue;
+        }
+        auto it = std::upper_bound(kind.constBegin(), kind.constEnd(), position + positionTolerance,
+                                   [](double value, int index) { return value < index; });
+        if (it != kind.constEnd() && (!result.isValid() || *it < result.index)) {
+            result.index = *it;
+            result.kind = static_cast<Kind>(1 << k);
+        }
+    }
+    return result;
+}
+
+// Function to find the last landmark of some kinds before a position
+SignalLandmarks::Landmark SignalLandmarks::previous(double position, int kinds) const {
+    Landmark result;
+    for (int k = 0; k < kindCount; ++k) {
+        const QVector<int> &kind = indexes[k];
+        if (!(kinds & (1 << k))) {
+            continue;
+        }
+        auto it = std::lower_bound(kind.constBegin(), kind.constEnd(), position - positionTolerance,
+                                   [](int index, double value) { return index < value; });
+        if (it != kind.constBegin() && (!result.isValid() || *(it - 1) > result.index)) {
+            result.index = *(it - 1);
+            result.kind = static_cast<Kind>(1 << k);
+        }
+    }
+    return result;
+}
+
+// Function to get the sorted indexes of one kind
+QVector<int> SignalLandmarks::positions(Kind kind) const {
+    return indexes[slot(kind)];
+}
+
+// Function to take over the indexes of one kind
+void SignalLandmarks::setPositions(Kind kind, const QVector<int> &indexes) {
+    this->indexes[slot(kind)] = indexes;
+}
+
+// Function to get the name of a kind
+QString SignalLandmarks::kindName(Kind kind) {
+    switch (kind) {
+        case Minimum:
+            return "minimum";
+        case Maximum:
+            return "maximum";
+        case VelocityPeak:
+            return "peak velocity";
+        case Onset:
+            return "onset";
+        case Offset:
+            return "offset";
+        default:
+            return QString();
+    }
+}
@@ -0,0 +1,77 @@
+//
+// Landmark index of movement extrema, velocity peaks and onsets for cursor snapping and navigation.
+//
+
+#ifndef SIGNALLANDMARKS_H
+#define SIGNALLANDMARKS_H
+
+#include <QString>
+#include <QVector>
+#include "SampleBuffer.h"
+
+// Parameters of the landmark detection
+struct LandmarkSettings {
+    double prominence = 0.05;      // Smallest swing between neighbouring extrema, fraction of the channel range
+    double onsetThreshold = 0.2;   // Fraction of the peak speed of a movement marking its onset and offset
+    double velocitySpan = 0.02;    // Seconds over which the speed is measured
+    double maximumRate = 2000;     // Channels sampled faster (audio) get no landmarks
+};
+
+// SignalLandmarks finds the landmarks of one channel in a single pass at load time. Extrema are
+// the turning points of movements whose swing exceeds the prominence, i.e. the zero crossings of
+// the velocity of every real movement; smaller wiggles are ignored. Between two extrema, the
+// sample of the highest speed is the velocity peak, and the first and last samples whose speed
+// reaches the onset threshold times that peak are the onset and offset of the movement.
+// Landmarks are kept as sorted sample indexes per kind, so every query is a binary search.
+class SignalLandmarks {
+public:
+    enum Kind {
+        Minimum = 0x01,
+        Maximum = 0x02,
+        VelocityPeak = 0x04,
+        Onset = 0x08,
+        Offset = 0x10,
+        Extrema = Minimum | Maximum,
+        AllKinds = 0x1f
+    };
+    static constexpr int kindCount = 5;
+
+    struct Landmark {
+        int index = -1;            // Sample index, -1 if there is no landmark
+        Kind kind = Minimum;
+        bool isValid() const { return index >= 0; }
+    };
+
+    // Build the landmarks of the samples, sample i lying at i / samplingRate
+    void build(const SampleBuffer &samples, double samplingRate, const LandmarkSettings &settings = LandmarkSettings());
+    void clear();
+    bool isEmpty() const;
+
+    // Number of landmarks of the given kinds (a combination of Kind values)
+    int count(int kinds = AllKinds) const;
+
+    // Landmark of the given kinds nearest to a fractional sample position
+    Landmark nearest(double position, int kinds = AllKinds) const;
+
+    // First landmark after and last landmark before a fractional sample position; landmarks within
+    // a hundredth of a sample count as lying at the position
+    Landmark next(double position, int kinds = AllKinds) const;
+    Landmark previous(double position, int kinds = AllKinds) const;
+
+    // Sorted sample indexes of one kind, and landmarks stored elsewhere, e.g. in a view cache
+    QVector<int> positions(Kind kind) const;
+    void setPositions(Kind kind, const QVector<int> &indexes);
+
+    // Readable name of a kind
+    static QString kindName(Kind kind);
+
+private:
+    template <typename T>
+    void buildLandmarks(const T *samples, int count, double samplingRate, const LandmarkSettings &settings);
+
+    static int slot(Kind kind);
+
+    QVector<int> indexes[kindCount];   // Sorted sample indexes, one array per kind
+};
+
+#endif // SIGNALLANDMARKS_H
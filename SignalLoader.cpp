@@ -0,0 +1,310 @@
+//
+// Background preparation of signals and spectrograms for display.
+//
+
+#include "SignalLoader.h"
+#include "qcustomplot.h"
+#include <QRunnable>
+#include <limits>
+
+// Interval at which worker progress is published (ms)
+static const int progressInterval = 50;
+
+// Destructor, frees color map data nobody took
+PreparedSpectrogram::~PreparedSpectrogram() {
+    delete mapData;
+}
+
+// Function to release ownership of the color map data
+QCPColorMapData *PreparedSpectrogram::takeMapData() {
+    QCPColorMapData *data = mapData;
+    mapData = nullptr;
+    return data;
+}
+
+// Function to compute stats and pyramids of all channels
+bool prepareSignal(const QMap<QString, SampleBuffer> &channels, double samplingRate, PreparedSignal &out,
+                   const QAtomicInt *cancelled, QAtomicInt *percent) {
+    return prepareSignal(channels, QMap<QString, double>(), samplingRate, out, cancelled, percent);
+}
+
+// Function to prepare channels recorded at different rates
+bool prepareSignal(const QMap<QString, SampleBuffer> &channels, const QMap<QString, double> &samplingRates,
+                   double defaultRate, PreparedSignal &out, const QAtomicInt *cancelled, QAtomicInt *percent) {
+    out = PreparedSignal();
+    out.samplingRate = 0;
+    out.globalMin = std::numeric_limits<double>::max();
+    out.globalMax = std::numeric_limits<double>::lowest();
+
+    int channelCount = channels.size();
+    int done = 0;
+    for (auto it = channels.cbegin(); it != channels.cend(); ++it) {
+        if (cancelled && cancelled->loadRelaxed()) {
+            return false;
+        }
+
+        PreparedChannel channel;
+        channel.name = it.key();
+        channel.samples = it.value();
+        channel.samplingRate = samplingRates.value(it.key(), defaultRate);
+        if (channel.samplingRate <= 0) {
+            channel.samplingRate = 1;
+        }
+
+        // A mapped channel is read front to back once; its pages stay cached for the view to draw
+        channel.samples.adviseSequential();
+        channel.stats = computeSignalStats(channel.samples);
+        if (channel.stats.valid) {
+            out.globalMin = qMin(out.globalMin, channel.stats.minValue);
+            out.globalMax = qMax(out.globalMax, channel.stats.maxValue);
+            out.samplingRate = qMax(out.samplingRate, channel.samplingRate);
+            out.maxTime = qMax(out.maxTime, static_cast<double>(channel.samples.size() - 1) / channel.samplingRate);
+            channel.pyramid.build(channel.samples);
+            channel.rangeIndex.build(channel.samples);
+            channel.landmarks.build(channel.samples, channel.samplingRate);
+            out.channels.append(std::move(channel));
+        }
+
+        ++done;
+        if (percent) {
+            percent->storeRelaxed(100 * done / channelCount);
+        }
+    }
+    if (out.samplingRate <= 0) {
+        out.samplingRate = defaultRate > 0 ? defaultRate : 1;
+    }
+    return true;
+}
+
+// Function to scan and convert a spectrogram matrix
+bool prepareSpectrogram(const QVector<QVector<double>> &matrix, double duration, double maxFrequency, int bits,
+                        PreparedSpectrogram &out, const QAtomicInt *cancelled, QAtomicInt *percent) {
+    delete out.takeMapData();
+    out.raster.reset();
+    out.frames = matrix.size();
+    out.bins = out.frames > 0 ? matrix[0].size() : 0;
+    out.duration = duration;
+    out.maxFrequency = maxFrequency;
+    out.dataMin = std::numeric_limits<double>::max();
+    out.dataMax = std::numeric_limits<double>::lowest();
+
+    int nx = out.frames;
+    int ny = out.bins;
+    if (nx == 0 || ny == 0) {
+        return true;
+    }
+
+    // The scan is about a third of the work, the conversion the rest
+    for (int x = 0; x < nx; ++x) {
+        if (cancelled && cancelled->loadRelaxed()) {
+            return false;
+        }
+        for (double value : matrix[x]) {
+            if (value < out.dataMin) out.dataMin = value;
+            if (value > out.dataMax) out.dataMax = value;
+        }
+        if (percent) {
+            percent->storeRelaxed(33 * (x + 1) / nx);
+        }
+    }
+
+    if (bits == 8 || bits == 16) {
+        SpectrogramRaster::Depth depth = bits == 8 ? SpectrogramRaster::Depth8 : SpectrogramRaster::Depth16;
+        out.raster.reset(new SpectrogramRaster(nx, ny, depth, out.dataMin, out.dataMax));
+    } else {
+        out.mapData = new QCPColorMapData(nx, ny, QCPRange(0, duration), QCPRange(0, maxFrequency));
+    }
+
+    for (int x = 0; x < nx; ++x) {
+        if (cancelled && cancelled->loadRelaxed()) {
+            return false;
+        }
+        const QVector<double> &column = matrix[x];
+        if (out.raster) {
+            if (column.size() >= ny) {
+                out.raster->setFrame(x, column.constData());
+            }
+        } else {
+            int count = qMin(ny, column.size());
+            for (int y = 0; y < count; ++y) {
+                out.mapData->setCell(x, y, column[y]);
+            }
+        }
+        if (percent) {
+            percent->storeRelaxed(33 + 67 * (x + 1) / nx);
+        }
+    }
+    return true;
+}
+
+// State of one preparation, shared between the loader and its worker task
+struct SignalLoader::Job {
+    enum Kind { Signal, Spectrogram };
+
+    Kind kind = Signal;
+
+    // Input
+    QMap<QString, SampleBuffer> channels;
+    QMap<QString, double> samplingRates;
+    double samplingRate = 1;     // Rate of channels missing from samplingRates
+    QVector<QVector<double>> matrix;
+    double duration = 0;
+    double maxFrequency = 0;
+    int bits = 0;
+
+    // Output
+    PreparedSignal signal;
+    QSharedPointer<PreparedSpectrogram> spectrogram;
+
+    QAtomicInt cancelled;
+    QAtomicInt percent;
+};
+
+// Worker running one preparation
+class SignalLoader::LoadTask : public QRunnable {
+public:
+    LoadTask(SignalLoader *loader, const QSharedPointer<Job> &job)
+            : loader(loader), job(job) {}
+
+    void run() override {
+        bool completed;
+        if (job->kind == Job::Signal) {
+            completed = prepareSignal(job->channels, job->samplingRates, job->samplingRate, job->signal,
+                                      &job->cancelled, &job->percent);
+            job->channels.clear();
+        } else {
+            job->spectrogram.reset(new PreparedSpectrogram);
+            completed = prepareSpectrogram(job->matrix, job->duration, job->maxFrequency, job->bits,
+                                           *job->spectrogram, &job->cancelled, &job->percent);
+            job->matrix = QVector<QVector<double>>();
+        }
+        if (!completed) {
+            return;
+        }
+
+        // Hand the result over to the GUI thread
+        SignalLoader *target = loader;
+        QSharedPointer<Job> doneJob = job;
+        QMetaObject::invokeMethod(target, [target, doneJob]() {
+            target->onJobDone(doneJob);
+        }, Qt::QueuedConnection);
+    }
+
+private:
+    SignalLoader *loader;
+    QSharedPointer<Job> job;
+};
+
+// Constructor
+SignalLoader::SignalLoader(QObject *parent)
+        : QObject(parent), lastPercent(-1) {
+    pool.setMaxThreadCount(1);
+    pollTimer.setInterval(progressInterval);
+    connect(&pollTimer, &QTimer::timeout, this, &SignalLoader::onPoll);
+}
+
+// Destructor, the worker must not outlive the loader it reports to
+SignalLoader::~SignalLoader() {
+    cancel();
+    pool.waitForDone();
+}
+
+// Function to start preparing a recording
+void SignalLoader::loadSignal(const QMap<QString, SampleBuffer> &channels, double samplingRate) {
+    QSharedPointer<Job> next(new Job);
+    next->kind = Job::Signal;
+    next->channels = channels;
+    next->samplingRate = samplingRate;
+    start(next);
+}
+
+// Function to start preparing a recording whose channels have their own rates
+void SignalLoader::loadSignal(const QMap<QString, SampleBuffer> &channels, const QMap<QString, double> &samplingRates,
+                              double defaultRate) {
+    QSharedPointer<Job> next(new Job);
+    next->kind = Job::Signal;
+    next->channels = channels;
+    next->samplingRates = samplingRates;
+    next->samplingRate = defaultRate;
+    start(next);
+}
+
+// Function to start preparing a spectrogram matrix
+void SignalLoader::loadSpectrogram(const QVector<QVector<double>> &matrix, double duration, double maxFrequency, int bits) {
+    QSharedPointer<Job> next(new Job);
+    next->kind = Job::Spectrogram;
+    next->matrix = matrix;
+    next->duration = duration;
+    next->maxFrequency = maxFrequency;
+    next->bits = bits;
+    start(next);
+}
+
+// Function to replace the current preparation
+void SignalLoader::start(const QSharedPointer<Job> &next) {
+    cancel();
+    job = next;
+    lastPercent = -1;
+    pollTimer.start();
+    pool.start(new LoadTask(this, job));
+}
+
+// Function to cancel the running preparation
+void SignalLoader::cancel() {
+    if (job) {
+        job->cancelled.storeRelaxed(1);
+        job.reset();
+    }
+    pollTimer.stop();
+}
+
+// Function to check whether a preparation is running
+bool SignalLoader::isLoading() const {
+    return job && pollTimer.isActive();
+}
+
+// Function to take the prepared recording
+PreparedSignal SignalLoader::takeSignal() {
+    PreparedSignal result;
+    if (job && !pollTimer.isActive()) {
+        result = std::move(job->signal);
+        job.reset();
+    }
+    return result;
+}
+
+// Function to take the prepared spectrogram
+QSharedPointer<PreparedSpectrogram> SignalLoader::takeSpectrogram() {
+    QSharedPointer<PreparedSpectrogram> result;
+    if (job && !pollTimer.isActive()) {
+        result = job->spectrogram;
+        job.reset();
+    }
+    return result;
+}
+
+// Function called on the GUI thread when the worker completed a preparation
+void SignalLoader::onJobDone(const QSharedPointer<Job> &doneJob) {
+    // Results of a replaced or cancelled preparation are dropped
+    if (doneJob != job) {
+        return;
+    }
+    pollTimer.stop();
+    if (lastPercent != 100) {
+        lastPercent = 100;
+        emit progress(100);
+    }
+    emit finished();
+}
+
+// Function to publish the worker's progress
+void SignalLoader::onPoll() {
+    if (!job) {
+        return;
+    }
+    int percent = job->percent.loadRelaxed();
+    if (percent != lastPercent) {
+        lastPercent = percent;
+        emit progress(percent);
+    }
+}
@@ -0,0 +1,121 @@
+//
+// Background preparation of signals and spectrograms for display.
+//
+
+#ifndef SIGNALLOADER_H
+#define SIGNALLOADER_H
+
+#include <QAtomicInt>
+#include <QMap>
+#include <QObject>
+#include <QSharedPointer>
+#include <QString>
+#include <QThreadPool>
+#include <QTimer>
+#include <QVector>
+#include "SignalLandmarks.h"
+#include "SignalPyramid.h"
+#include "SignalRangeIndex.h"
+#include "SignalStats.h"
+#include "SpectrogramRaster.h"
+
+class QCPColorMapData;
+
+// One channel with everything the widget derives from its samples
+struct PreparedChannel {
+    QString name;
+    SampleBuffer samples;        // Shared with the caller's buffer, native type
+    double samplingRate = 1;
+    SignalStats stats;
+    SignalPyramid pyramid;
+    SignalRangeIndex rangeIndex;
+    SignalLandmarks landmarks;
+};
+
+// A recording ready to be swapped into the widget
+struct PreparedSignal {
+    QVector<PreparedChannel> channels;   // Valid channels in map order
+    double samplingRate = 1;             // Highest rate of all channels
+    double globalMin = 0;
+    double globalMax = 0;
+    double maxTime = 0;                  // Time of the last sample of the longest channel
+    double initialSpan = 0;              // Seconds shown first, 0 for the whole recording
+};
+
+// A spectrogram matrix ready to be swapped into the widget
+struct PreparedSpectrogram {
+    int frames = 0;
+    int bins = 0;
+    double duration = 0;
+    double maxFrequency = 0;
+    double dataMin = 0;
+    double dataMax = 0;
+    QCPColorMapData *mapData = nullptr;            // QCPColorMap path, handed over with takeMapData()
+    QSharedPointer<SpectrogramRaster> raster;      // Quantized path
+
+    PreparedSpectrogram() = default;
+    PreparedSpectrogram(const PreparedSpectrogram &) = delete;
+    PreparedSpectrogram &operator=(const PreparedSpectrogram &) = delete;
+    ~PreparedSpectrogram();
+
+    // Release ownership of the color map data, e.g. to QCPColorMap::setData()
+    QCPColorMapData *takeMapData();
+};
+
+// Compute stats and pyramids of all channels; returns false once cancelled becomes non-zero.
+// percent, if given, is advanced from 0 to 100 as channels complete.
+bool prepareSignal(const QMap<QString, SampleBuffer> &channels, double samplingRate, PreparedSignal &out,
+                   const QAtomicInt *cancelled = nullptr, QAtomicInt *percent = nullptr);
+// Same for channels with their own rates; channels missing from samplingRates use defaultRate
+bool prepareSignal(const QMap<QString, SampleBuffer> &channels, const QMap<QString, double> &samplingRates,
+                   double defaultRate, PreparedSignal &out,
+                   const QAtomicInt *cancelled = nullptr, QAtomicInt *percent = nullptr);
+
+// Scan and convert a frame-major spectrogram matrix for the color map (bits 0) or an 8/16-bit raster
+bool prepareSpectrogram(const QVector<QVector<double>> &matrix, double duration, double maxFrequency, int bits,
+                        PreparedSpectrogram &out, const QAtomicInt *cancelled = nullptr, QAtomicInt *percent = nullptr);
+
+// SignalLoader runs one preparation at a time on a worker thread. Starting a new load cancels
+// the previous one, whose result is then dropped. Results are taken on the GUI thread.
+class SignalLoader : public QObject {
+    Q_OBJECT
+
+public:
+    explicit SignalLoader(QObject *parent = nullptr);
+    ~SignalLoader();
+
+    // Start preparing a recording or a spectrogram matrix and return immediately
+    void loadSignal(const QMap<QString, SampleBuffer> &channels, double samplingRate);
+    void loadSignal(const QMap<QString, SampleBuffer> &channels, const QMap<QString, double> &samplingRates,
+                    double defaultRate);
+    void loadSpectrogram(const QVector<QVector<double>> &matrix, double duration, double maxFrequency, int bits);
+
+    // Stop the running preparation; no finished() follows for it
+    void cancel();
+    bool isLoading() const;
+
+    // Hand over the result after finished(); valid once per load
+    PreparedSignal takeSignal();
+    QSharedPointer<PreparedSpectrogram> takeSpectrogram();
+
+signals:
+    // Emitted on the GUI thread while preparing, at most once per poll interval
+    void progress(int percent);
+    // Emitted on the GUI thread once the result is ready to be taken
+    void finished();
+
+private:
+    struct Job;
+    class LoadTask;
+
+    void start(const QSharedPointer<Job> &next);
+    void onJobDone(const QSharedPointer<Job> &doneJob);
+    void onPoll();
+
+    QSharedPointer<Job> job;   // Current preparation, shared with its worker task
+    QThreadPool pool;
+    QTimer pollTimer;          // Publishes the worker's progress
+    int lastPercent;
+};
+
+#endif // SIGNALLOADER_H
@@ -0,0 +1,198 @@
+//
+// Live channel model with one writer and any number of readers working on immutable snapshots.
+//
+
+#include "SignalModel.h"
+#include <QMutexLocker>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// Function to check whether the channel exists in its snapshot
+bool SignalSnapshotChannel::isValid() const {
+    return rate > 0;
+}
+
+// Function to get the sampling rate
+double SignalSnapshotChannel::samplingRate() const {
+    return rate;
+}
+
+// Function to get the absolute index of the oldest retained sample
+qint64 SignalSnapshotChannel::firstIndex() const {
+    return retainedFrom;
+}
+
+// Function to get the number of published samples
+qint64 SignalSnapshotChannel::totalCount() const {
+    return count;
+}
+
+// Function to get a sample by absolute index
+double SignalSnapshotChannel::at(qint64 index) const {
+    qint64 chunk = index / SignalChunk::size;
+    return table->chunks.at(static_cast<int>(chunk - table->firstChunk))->samples[index % SignalChunk::size];
+}
+
+// Function to interpolate the value at a given time
+double SignalSnapshotChannel::valueAt(double time) const {
+    if (count <= retainedFrom) {
+        return 0.0;
+    }
+
+    double position = time * rate;
+    qint64 last = count - 1;
+    if (position <= retainedFrom) {
+        return at(retainedFrom);
+    } else if (position >= last) {
+        return at(last);
+    }
+
+    qint64 index = static_cast<qint64>(position);
+    double fraction = position - index;
+    double y1 = at(index);
+    double y2 = at(index + 1);
+    return y1 + (y2 - y1) * fraction;
+}
+
+// Function to copy samples out of the chunks, one contiguous run per chunk
+int SignalSnapshotChannel::copy(qint64 first, int count, double *out) const {
+    first = std::max(first, retainedFrom);
+    int total = static_cast<int>(std::max<qint64>(0, std::min<qint64>(count, this->count - first)));
+    int copied = 0;
+    while (copied < total) {
+        qint64 index = first + copied;
+        int inChunk = static_cast<int>(index % SignalChunk::size);
+        int run = std::min(total - copied, SignalChunk::size - inChunk);
+        const SignalChunk *chunk = table->chunks.at(static_cast<int>(index / SignalChunk::size - table->firstChunk)).data();
+        std::memcpy(out + copied, chunk->samples + inChunk, sizeof(double) * run);
+        copied += run;
+    }
+    return total;
+}
+
+// Function to get the number of the publication
+quint64 SignalSnapshot::version() const {
+    return state ? state->version : 0;
+}
+
+// Function to get the number of clears before the publication
+int SignalSnapshot::generation() const {
+    return state ? state->generation : 0;
+}
+
+// Function to get the names of all channels
+QStringList SignalSnapshot::channelNames() const {
+    return state ? QStringList(state->channels.keys()) : QStringList();
+}
+
+// Function to check whether a channel exists
+bool SignalSnapshot::contains(const QString &channel) const {
+    return state && state->channels.contains(channel);
+}
+
+// Function to get the state of one channel
+SignalSnapshotChannel SignalSnapshot::channel(const QString &channel) const {
+    return state ? state->channels.value(channel) : SignalSnapshotChannel();
+}
+
+// Constructor
+SignalModel::SignalModel()
+        : version(0), generation(0) {}
+
+// Function to drop all channels if a clear was requested since the last one
+void SignalModel::applyClear() {
+    int requested = clearRequests.loadAcquire();
+    if (requested != generation) {
+        channels.clear();
+        generation = requested;
+    }
+}
+
+// Function to add a channel
+void SignalModel::addChannel(const QString &channel, double samplingRate, double retentionSeconds) {
+    applyClear();
+    if (samplingRate <= 0 || channels.contains(channel)) {
+        return;
+    }
+    Channel state;
+    state.rate = samplingRate;
+    state.retention = std::max<qint64>(1, static_cast<qint64>(std::ceil(samplingRate * retentionSeconds)));
+    channels.insert(channel, state);
+}
+
+// Function to give a channel the chunk of the given number, in a new table if the current one is full
+void SignalModel::addChunk(Channel &state, qint64 chunk) {
+    const SignalChunkTable *table = state.table.data();
+    if (!table || chunk - table->firstChunk >= table->chunks.size()) {
+        // The new table starts at the oldest retained chunk; older ones go with the last snapshot
+        // of the old table. Twice the chunks in use keep the copies amortized constant per chunk
+        qint64 firstChunk = std::max<qint64>(0, state.count - state.retention) / SignalChunk::size;
+        qint64 used = chunk - firstChunk + 1;
+        QSharedPointer<SignalChunkTable> grown = QSharedPointer<SignalChunkTable>::create();
+        grown->firstChunk = firstChunk;
+        grown->chunks.resize(static_cast<int>(std::max<qint64>(4, 2 * used)));
+        for (qint64 n = firstChunk; n < chunk; ++n) {
+            grown->chunks[static_cast<int>(n - firstChunk)] = table->chunks.at(static_cast<int>(n - table->firstChunk));
+        }
+        state.table = grown;
+    }
+    state.table->chunks[static_cast<int>(chunk - state.table->firstChunk)] = QSharedPointer<SignalChunk>::create();
+}
+
+// Function to append samples to a channel
+void SignalModel::append(const QString &channel, const double *samples, int count) {
+    applyClear();
+    auto it = channels.find(channel);
+    if (it == channels.end() || !samples || count <= 0) {
+        return;
+    }
+    Channel &state = it.value();
+
+    // Samples go behind the published count of the tail chunk, which no reader looks at yet
+    int written = 0;
+    while (written < count) {
+        qint64 chunk = state.count / SignalChunk::size;
+        int inChunk = static_cast<int>(state.count % SignalChunk::size);
+        if (inChunk == 0) {
+            addChunk(state, chunk);
+        }
+        int run = std::min(count - written, SignalChunk::size - inChunk);
+        SignalChunk *tail = state.table->chunks.at(static_cast<int>(chunk - state.table->firstChunk)).data();
+        std::memcpy(tail->samples + inChunk, samples + written, sizeof(double) * run);
+        written += run;
+        state.count += run;
+    }
+}
+
+// Function to make the appended samples and added channels visible to readers
+void SignalModel::publish() {
+    applyClear();
+    QSharedPointer<SignalSnapshot::State> state = QSharedPointer<SignalSnapshot::State>::create();
+    state->version = ++version;
+    state->generation = generation;
+    for (auto it = channels.cbegin(); it != channels.cend(); ++it) {
+        SignalSnapshotChannel channel;
+        channel.rate = it.value().rate;
+        channel.count = it.value().count;
+        channel.retainedFrom = std::max<qint64>(0, channel.count - it.value().retention);
+        channel.table = it.value().table;
+        state->channels.insert(it.key(), channel);
+    }
+
+    QMutexLocker locker(&publishMutex);
+    published = state;
+}
+
+// Function to ask the writer to drop all channels
+int SignalModel::requestClear() {
+    return clearRequests.fetchAndAddOrdered(1) + 1;
+}
+
+// Function to get the latest published state
+SignalSnapshot SignalModel::snapshot() const {
+    SignalSnapshot snapshot;
+    QMutexLocker locker(&publishMutex);
+    snapshot.state = published;
+    return snapshot;
+}
@@ -0,0 +1,136 @@
+//
+// Live channel model with one writer and any number of readers working on immutable snapshots.
+//
+
+#ifndef SIGNALMODEL_H
+#define SIGNALMODEL_H
+
+#include <QAtomicInt>
+#include <QMap>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QtGlobal>
+
+// Samples of one channel are kept in fixed-size chunks that are only ever appended to; chunk n
+// holds the samples n * size..(n + 1) * size - 1
+struct SignalChunk {
+    static constexpr int size = 4096;
+    double samples[size];
+};
+
+// Chunks of one channel by number, shared by the writer and the snapshots. The table never
+// changes size: the writer fills its free slots, which no snapshot looks at yet, and moves to
+// a new table when it runs out
+struct SignalChunkTable {
+    qint64 firstChunk = 0;                             // Number of the chunk in slot 0
+    QVector<QSharedPointer<SignalChunk>> chunks;
+};
+
+// Published state of one channel; samples are addressed by their absolute index since the
+// channel was added, sample i lying at i / samplingRate
+class SignalSnapshotChannel {
+public:
+    bool isValid() const;
+    double samplingRate() const;
+
+    // Absolute index of the oldest retained sample and one past the newest published one
+    qint64 firstIndex() const;
+    qint64 totalCount() const;
+
+    // Sample by absolute index; the index must be in [firstIndex(), totalCount())
+    double at(qint64 index) const;
+
+    // Linearly interpolated value at the given time, clamped to the retained samples
+    double valueAt(double time) const;
+
+    // Copy up to count samples starting at an absolute index; returns the number copied
+    int copy(qint64 first, int count, double *out) const;
+
+private:
+    friend class SignalModel;
+
+    double rate = 0;
+    qint64 retainedFrom = 0;                     // Oldest index inside the retention
+    qint64 count = 0;
+    QSharedPointer<const SignalChunkTable> table;
+};
+
+// Consistent state of all channels at one publication; cheap to copy and safe to read on any thread
+class SignalSnapshot {
+public:
+    // Number of the publication, 0 before the first one
+    quint64 version() const;
+
+    // Number of clears applied before the publication
+    int generation() const;
+
+    QStringList channelNames() const;
+    bool contains(const QString &channel) const;
+
+    // Channel state, invalid for unknown channels
+    SignalSnapshotChannel channel(const QString &channel) const;
+
+private:
+    friend class SignalModel;
+
+    struct State {
+        quint64 version = 0;
+        int generation = 0;
+        QMap<QString, SignalSnapshotChannel> channels;
+    };
+    QSharedPointer<const State> state;
+};
+
+// SignalModel holds live channels apart from any widget. A single writer thread, e.g. the
+// acquisition, adds channels and appends samples; publish() makes everything appended so far
+// visible at once. Readers on any thread take a snapshot() and keep reading it while the writer
+// goes on: samples are written once into chunks that are never modified below the published
+// count, and the chunk tables are shared, so a publication costs one entry per channel however
+// long the channels are. Chunks older than the retention are released when the writer moves to
+// a new table, which holds at most twice the retained chunks, and once no snapshot refers to
+// them. The only lock guards the exchange of the published state pointer; appending and reading
+// samples take none. Writer methods must not be called from several threads at once; any
+// thread may requestClear(), which the writer carries out before its next change.
+class SignalModel {
+public:
+    SignalModel();
+
+    // Writer: add a channel keeping the newest retentionSeconds of samples
+    void addChannel(const QString &channel, double samplingRate, double retentionSeconds);
+
+    // Writer: append samples to a channel; readers see them after the next publish()
+    void append(const QString &channel, const double *samples, int count);
+    void publish();
+
+    // Any thread: have the writer drop all channels; returns the generation of the snapshots
+    // published after the drop
+    int requestClear();
+
+    // Reader: the latest published state
+    SignalSnapshot snapshot() const;
+
+private:
+    // Writer's state of one channel, ahead of the published one
+    struct Channel {
+        double rate = 0;
+        qint64 retention = 1;                    // Samples kept
+        qint64 count = 0;
+        QSharedPointer<SignalChunkTable> table;
+    };
+
+    void applyClear();
+    static void addChunk(Channel &state, qint64 chunk);
+
+    QMap<QString, Channel> channels;
+    quint64 version;
+    int generation;                              // Clears applied by the writer
+    QAtomicInt clearRequests;                    // Clears requested so far
+
+    mutable QMutex publishMutex;
+    QSharedPointer<const SignalSnapshot::State> published;
+};
+
+#endif // SIGNALMODEL_H
@@ -0,0 +1,181 @@
+//
+// Min/max decimation pyramid for drawing long signals at screen resolution.
+//
+
+#include "SignalPyramid.h"
+#include <algorithm>
+#include <type_traits>
+
+// Constructor
+SignalPyramid::SignalPyramid() = default;
+
+// Function to reduce one min/max envelope by the reduction factor
+template <typename T>
+static void reduceLevel(const T *sourceMins, const T *sourceMaxs, int sourceSize, QVector<T> &mins, QVector<T> &maxs) {
+    int count = (sourceSize + SignalPyramid::reductionFactor - 1) / SignalPyramid::reductionFactor;
+    mins.resize(count);
+    maxs.resize(count);
+    T *outMins = mins.data();
+    T *outMaxs = maxs.data();
+    for (int bucket = 0; bucket < count; ++bucket) {
+        int begin = bucket * SignalPyramid::reductionFactor;
+        int end = std::min(begin + SignalPyramid::reductionFactor, sourceSize);
+        T localMin = sourceMins[begin];
+        T localMax = sourceMaxs[begin];
+        for (int i = begin + 1; i < end; ++i) {
+            localMin = std::min(localMin, sourceMins[i]);
+            localMax = std::max(localMax, sourceMaxs[i]);
+        }
+        outMins[bucket] = localMin;
+        outMaxs[bucket] = localMax;
+    }
+}
+
+// Function to build all levels of samples stored as T, envelopes keep the sample type
+template <typename T>
+void SignalPyramid::buildLevels(const T *source, int sourceSize, double scale) {
+    // First level is reduced directly from the raw samples, min and max read the same array
+    if (sourceSize <= reductionFactor) {
+        return;
+    }
+
+    QVector<T> mins;
+    QVector<T> maxs;
+    reduceLevel(source, source, sourceSize, mins, maxs);
+    levelMins.append(makeSampleBuffer(mins, scale));
+    levelMaxs.append(makeSampleBuffer(maxs, scale));
+
+    // Every further level is reduced from the previous one until it fits into a few buckets
+    while (mins.size() > reductionFactor) {
+        QVector<T> nextMins;
+        QVector<T> nextMaxs;
+        reduceLevel(mins.constData(), maxs.constData(), mins.size(), nextMins, nextMaxs);
+        levelMins.append(makeSampleBuffer(nextMins, scale));
+        levelMaxs.append(makeSampleBuffer(nextMaxs, scale));
+        mins = nextMins;
+        maxs = nextMaxs;
+    }
+}
+
+// Function to build the min/max levels from raw samples
+void SignalPyramid::build(const QVector<double> &samples) {
+    build(SampleBuffer(samples));
+}
+
+// Function to build the min/max levels from typed samples
+void SignalPyramid::build(const SampleBuffer &samples) {
+    clear();
+    samples.visit([this, &samples](const auto *data, int count) {
+        buildLevels(data, count, samples.scale());
+    });
+}
+
+// Function to drop all levels
+void SignalPyramid::clear() {
+    levelMins.clear();
+    levelMaxs.clear();
+}
+
+// Function to take over stored levels
+void SignalPyramid::setLevels(const QVector<SampleBuffer> &mins, const QVector<SampleBuffer> &maxs) {
+    levelMins = mins;
+    levelMaxs = maxs;
+}
+
+// Function to get the number of levels including the raw level
+int SignalPyramid::levelCount() const {
+    return levelMins.size() + 1;
+}
+
+// Function to get the number of raw samples per bucket at a level
+int SignalPyramid::bucketSize(int level) const {
+    int size = 1;
+    for (int i = 0; i < level; ++i) {
+        size *= reductionFactor;
+    }
+    return size;
+}
+
+// Function to get the number of buckets at a level
+int SignalPyramid::bucketCount(int level) const {
+    return levelMins[level - 1].size();
+}
+
+// Function to get the minimum envelope of a level
+const SampleBuffer &SignalPyramid::minValues(int level) const {
+    return levelMins[level - 1];
+}
+
+// Function to get the maximum envelope of a level
+const SampleBuffer &SignalPyramid::maxValues(int level) const {
+    return levelMaxs[level - 1];
+}
+
+// Function to find the stored min/max of a raw range, climbing the levels like a segment tree
+template <typename T>
+void SignalPyramid::rangeExtrema(const T *raw, int first, int last, T &low, T &high) const {
+    low = raw[first];
+    high = raw[first];
+    const T *mins = raw;
+    const T *maxs = raw;
+    int level = 0;
+    while (first <= last) {
+        // Move up while the range still spans whole buckets of the next level
+        bool climb = level + 1 < levelCount() && last - first + 1 >= 2 * reductionFactor;
+        if (!climb) {
+            for (int i = first; i <= last; ++i) {
+                low = std::min(low, mins[i]);
+                high = std::max(high, maxs[i]);
+            }
+            break;
+        }
+
+        // Partial buckets at both ends are read at this level, at most reductionFactor - 1 each
+        while (first % reductionFactor != 0) {
+            low = std::min(low, mins[first]);
+            high = std::max(high, maxs[first]);
+            ++first;
+        }
+        while ((last + 1) % reductionFactor != 0) {
+            low = std::min(low, mins[last]);
+            high = std::max(high, maxs[last]);
+            --last;
+        }
+        first /= reductionFactor;
+        last = (last + 1) / reductionFactor - 1;
+        ++level;
+        mins = levelMins[level - 1].template data<T>();
+        maxs = levelMaxs[level - 1].template data<T>();
+    }
+}
+
+// Function to get the physical min/max of a sample range
+bool SignalPyramid::rangeMinMax(const SampleBuffer &samples, int first, int last, double &minValue, double &maxValue) const {
+    first = qMax(0, first);
+    last = qMin(samples.size() - 1, last);
+    if (first > last) {
+        return false;
+    }
+    samples.visit([&](const auto *data, int) {
+        using SampleType = std::remove_const_t<std::remove_pointer_t<decltype(data)>>;
+        SampleType low;
+        SampleType high;
+        rangeExtrema(data, first, last, low, high);
+        double scale = samples.scale();
+        minValue = low * scale;
+        maxValue = high * scale;
+        if (scale < 0) {
+            std::swap(minValue, maxValue);
+        }
+    });
+    return true;
+}
+
+// Function to pick the coarsest level that still has at least one bucket per requested span
+int SignalPyramid::levelForBucketSize(double samplesPerBucket) const {
+    int level = 0;
+    while (level + 1 < levelCount() && bucketSize(level + 1) <= samplesPerBucket) {
+        ++level;
+    }
+    return level;
+}
@@ -0,0 +1,63 @@
+//
+// Min/max decimation pyramid for drawing long signals at screen resolution.
+//
+
+#ifndef SIGNALPYRAMID_H
+#define SIGNALPYRAMID_H
+
+#include <QVector>
+#include "SampleBuffer.h"
+
+// SignalPyramid keeps successively coarser min/max envelopes of a sample array.
+// Level 0 refers to the raw samples; level L stores one min/max pair for every
+// reductionFactor^L raw samples. Envelopes are stored in the type and scale of the samples.
+class SignalPyramid {
+public:
+    // Number of buckets of level L-1 merged into one bucket of level L
+    static constexpr int reductionFactor = 4;
+
+    SignalPyramid();
+
+    // Build all levels from the given samples (the samples themselves are not copied)
+    void build(const QVector<double> &samples);
+    void build(const SampleBuffer &samples);
+    void clear();
+
+    // Take over levels 1.. stored elsewhere, e.g. in a view cache; they must be the levels
+    // build() makes from the same samples
+    void setLevels(const QVector<SampleBuffer> &mins, const QVector<SampleBuffer> &maxs);
+
+    // Number of levels including the raw level 0
+    int levelCount() const;
+
+    // Number of raw samples covered by one bucket of the given level
+    int bucketSize(int level) const;
+
+    // Number of buckets at the given level (level > 0)
+    int bucketCount(int level) const;
+
+    // Min/max envelope of the given level (level > 0)
+    const SampleBuffer &minValues(int level) const;
+    const SampleBuffer &maxValues(int level) const;
+
+    // Coarsest level whose bucket does not exceed the requested number of samples
+    int levelForBucketSize(double samplesPerBucket) const;
+
+    // Physical min/max of samples first..last, read from whole buckets of the coarsest levels
+    // that fit and from raw samples only at the edges, so a query costs O(log n); samples must
+    // be the buffer the pyramid was built from. Returns false for an empty range.
+    bool rangeMinMax(const SampleBuffer &samples, int first, int last, double &minValue, double &maxValue) const;
+
+private:
+    template <typename T>
+    void buildLevels(const T *source, int sourceSize, double scale);
+
+    template <typename T>
+    void rangeExtrema(const T *raw, int first, int last, T &low, T &high) const;
+
+    // Envelopes for levels 1..levelCount()-1, index 0 holds level 1
+    QVector<SampleBuffer> levelMins;
+    QVector<SampleBuffer> levelMaxs;
+};
+
+#endif // SIGNALPYRAMID_H
@@ -0,0 +1,190 @@
+//
+// Block prefix sums for constant-time statistics over sample ranges.
+//
+
+#include "SignalRangeIndex.h"
+#include <algorithm>
+#include <cmath>
+
+// Function to accumulate the running sums block by block
+template <typename T>
+void SignalRangeIndex::buildBlocks(const T *samples, int count, double scale) {
+    int blocks = (count + blockSize - 1) / blockSize;
+    QVector<double> sums(blocks + 1);
+    QVector<double> squareSums(blocks + 1);
+    QVector<double> pathSums(blocks + 1);
+    QVector<double> maxSteps(blocks);
+    sums[0] = 0;
+    squareSums[0] = 0;
+    pathSums[0] = 0;
+
+    for (int block = 0; block < blocks; ++block) {
+        int begin = block * blockSize;
+        int end = std::min(begin + blockSize, count);
+        double sum = 0;
+        double squares = 0;
+        double path = 0;
+        double maxStep = 0;
+        for (int i = begin; i < end; ++i) {
+            double value = samples[i] * scale;
+            sum += value;
+            squares += value * value;
+            // Step i joins sample i and i + 1, so the last step of a block reaches into the next one
+            if (i + 1 < count) {
+                double step = std::abs((samples[i + 1] - static_cast<double>(samples[i])) * scale);
+                path += step;
+                maxStep = std::max(maxStep, step);
+            }
+        }
+        sums[block + 1] = sums[block] + sum;
+        squareSums[block + 1] = squareSums[block] + squares;
+        pathSums[block + 1] = pathSums[block] + path;
+        maxSteps[block] = maxStep;
+    }
+
+    sumPrefix = SampleBuffer(sums);
+    squarePrefix = SampleBuffer(squareSums);
+    pathPrefix = SampleBuffer(pathSums);
+    blockMaxSteps = SampleBuffer(maxSteps);
+    stepPyramid.build(blockMaxSteps);
+}
+
+// Function to build the index
+void SignalRangeIndex::build(const SampleBuffer &samples) {
+    clear();
+    sampleCount = samples.size();
+    samples.visit([this, &samples](const auto *data, int count) {
+        buildBlocks(data, count, samples.scale());
+    });
+}
+
+// Function to drop the index
+void SignalRangeIndex::clear() {
+    sampleCount = 0;
+    sumPrefix = SampleBuffer();
+    squarePrefix = SampleBuffer();
+    pathPrefix = SampleBuffer();
+    blockMaxSteps = SampleBuffer();
+    stepPyramid.clear();
+}
+
+// Function to check whether the index was built
+bool SignalRangeIndex::isEmpty() const {
+    return sumPrefix.isEmpty();
+}
+
+// Function to get the running sums
+SignalRangeIndex::Blocks SignalRangeIndex::blocks() const {
+    Blocks result;
+    result.sampleCount = sampleCount;
+    result.sumPrefix = sumPrefix;
+    result.squarePrefix = squarePrefix;
+    result.pathPrefix = pathPrefix;
+    result.maxSteps = blockMaxSteps;
+    return result;
+}
+
+// Function to restore the index from running sums; inconsistent sums leave it empty
+void SignalRangeIndex::restore(const Blocks &blocks) {
+    clear();
+    int blockCount = (blocks.sampleCount + blockSize - 1) / blockSize;
+    const SampleBuffer *prefixes[] = {&blocks.sumPrefix, &blocks.squarePrefix, &blocks.pathPrefix};
+    for (const SampleBuffer *prefix : prefixes) {
+        if (prefix->type() != SampleBuffer::Float64 || prefix->size() != blockCount + 1) {
+            return;
+        }
+    }
+    if (blocks.maxSteps.type() != SampleBuffer::Float64 || blocks.maxSteps.size() != blockCount) {
+        return;
+    }
+    sampleCount = blocks.sampleCount;
+    sumPrefix = blocks.sumPrefix;
+    squarePrefix = blocks.squarePrefix;
+    pathPrefix = blocks.pathPrefix;
+    blockMaxSteps = blocks.maxSteps;
+    stepPyramid.build(blockMaxSteps);
+}
+
+// Function to sum values and squared values of samples first..last
+template <typename T>
+void SignalRangeIndex::scanRange(const T *samples, int first, int last, double scale, double &sum, double &squares) const {
+    for (int i = first; i <= last; ++i) {
+        double value = samples[i] * scale;
+        sum += value;
+        squares += value * value;
+    }
+}
+
+// Function to sum and maximize the absolute steps first..last
+template <typename T>
+void SignalRangeIndex::scanSteps(const T *samples, int first, int last, double scale, double &path, double &maxStep) const {
+    for (int k = first; k <= last; ++k) {
+        double step = std::abs((samples[k + 1] - static_cast<double>(samples[k])) * scale);
+        path += step;
+        maxStep = std::max(maxStep, step);
+    }
+}
+
+// Function to get the statistics of a sample range
+SelectionStats SignalRangeIndex::stats(const SampleBuffer &samples, const SignalPyramid &pyramid,
+                                       int first, int last, double samplingRate) const {
+    SelectionStats result;
+    first = std::max(0, first);
+    last = std::min(sampleCount - 1, last);
+    if (isEmpty() || samples.size() != sampleCount || first > last || samplingRate <= 0) {
+        return result;
+    }
+
+    double sum = 0;
+    double squares = 0;
+    double path = 0;
+    double maxStep = 0;
+    double scale = samples.scale();
+    int firstBlock = first / blockSize;
+    int lastBlock = last / blockSize;
+    int lastStep = last - 1;
+    int lastStepBlock = lastStep / blockSize;
+    const double *sums = sumPrefix.data<double>();
+    const double *squareSums = squarePrefix.data<double>();
+    const double *pathSums = pathPrefix.data<double>();
+    samples.visit([&](const auto *data, int) {
+        // Values: partial blocks at the edges are scanned, whole blocks come from the running sums
+        if (lastBlock - firstBlock < 2) {
+            scanRange(data, first, last, scale, sum, squares);
+        } else {
+            scanRange(data, first, (firstBlock + 1) * blockSize - 1, scale, sum, squares);
+            sum += sums[lastBlock] - sums[firstBlock + 1];
+            squares += squareSums[lastBlock] - squareSums[firstBlock + 1];
+            scanRange(data, lastBlock * blockSize, last, scale, sum, squares);
+        }
+
+        // Steps first..last-1 in the same way, the largest one of whole blocks from the step pyramid
+        if (lastStep < first) {
+            return;
+        }
+        if (lastStepBlock - firstBlock < 2) {
+            scanSteps(data, first, lastStep, scale, path, maxStep);
+        } else {
+            scanSteps(data, first, (firstBlock + 1) * blockSize - 1, scale, path, maxStep);
+            path += pathSums[lastStepBlock] - pathSums[firstBlock + 1];
+            double blockMin;
+            double blockMax;
+            if (stepPyramid.rangeMinMax(blockMaxSteps, firstBlock + 1, lastStepBlock - 1, blockMin, blockMax)) {
+                maxStep = std::max(maxStep, blockMax);
+            }
+            scanSteps(data, lastStepBlock * blockSize, lastStep, scale, path, maxStep);
+        }
+    });
+
+    result.count = last - first + 1;
+    result.duration = result.count / samplingRate;
+    result.mean = sum / result.count;
+    result.rms = std::sqrt(std::max(0.0, squares) / result.count);
+    result.energy = squares / samplingRate;
+    pyramid.rangeMinMax(samples, first, last, result.minValue, result.maxValue);
+    result.peak = std::max(std::abs(result.minValue), std::abs(result.maxValue));
+    result.pathLength = path;
+    result.peakVelocity = maxStep * samplingRate;
+    result.valid = true;
+    return result;
+}
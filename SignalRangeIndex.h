@@ -0,0 +1,79 @@
+//
+// Block prefix sums for constant-time statistics over sample ranges.
+//
+
+#ifndef SIGNALRANGEINDEX_H
+#define SIGNALRANGEINDEX_H
+
+#include <QString>
+#include <QVector>
+#include "SampleBuffer.h"
+#include "SignalPyramid.h"
+
+// Statistics of one channel over a time range, in physical units
+struct SelectionStats {
+    QString channel;
+    int count = 0;               // Samples in the range
+    double duration = 0;         // Seconds covered by the samples
+    double mean = 0;
+    double rms = 0;
+    double energy = 0;           // Sum of squared values times the sample interval
+    double minValue = 0;
+    double maxValue = 0;
+    double peak = 0;             // Largest absolute value
+    double pathLength = 0;       // Sum of absolute steps between neighbouring samples
+    double peakVelocity = 0;     // Largest absolute step times the sampling rate
+    bool valid = false;          // False for empty ranges and channels without an index
+};
+
+// SignalRangeIndex stores running sums of values, squared values and absolute steps at every
+// blockSize-th sample, plus a min/max pyramid of the largest step per block. A query adds the
+// whole blocks inside the range from the running sums and scans at most two partial blocks at
+// its edges, so its cost does not depend on the length of the range. Min/max come from the
+// channel's own pyramid. The index takes about 4 doubles per block, i.e. 1/2 byte per sample.
+class SignalRangeIndex {
+public:
+    static constexpr int blockSize = 64;
+
+    // Running sums as built, Float64 buffers with one entry per block plus one for the prefixes
+    struct Blocks {
+        int sampleCount = 0;
+        SampleBuffer sumPrefix;
+        SampleBuffer squarePrefix;
+        SampleBuffer pathPrefix;
+        SampleBuffer maxSteps;
+    };
+
+    // Build the index from the samples; they must be passed again to stats()
+    void build(const SampleBuffer &samples);
+    void clear();
+    bool isEmpty() const;
+
+    // Running sums of the index, and an index restored from them, e.g. from a view cache; the
+    // buffers are shared, not copied, and only the small step pyramid is built again
+    Blocks blocks() const;
+    void restore(const Blocks &blocks);
+
+    // Statistics of samples first..last, with pyramid built from the same samples
+    SelectionStats stats(const SampleBuffer &samples, const SignalPyramid &pyramid,
+                         int first, int last, double samplingRate) const;
+
+private:
+    template <typename T>
+    void buildBlocks(const T *samples, int count, double scale);
+
+    template <typename T>
+    void scanRange(const T *samples, int first, int last, double scale, double &sum, double &squares) const;
+
+    template <typename T>
+    void scanSteps(const T *samples, int first, int last, double scale, double &path, double &maxStep) const;
+
+    int sampleCount = 0;
+    SampleBuffer sumPrefix;          // Sum of samples in blocks 0..b-1 at index b
+    SampleBuffer squarePrefix;
+    SampleBuffer pathPrefix;         // Sum of |x[k+1] - x[k]| for k in blocks 0..b-1
+    SampleBuffer blockMaxSteps;      // Largest |x[k+1] - x[k]| of each block
+    SignalPyramid stepPyramid;       // Range maximum over blockMaxSteps
+};
+
+#endif // SIGNALRANGEINDEX_H
@@ -0,0 +1,273 @@
+//
+// Polyphase resampling of channels recorded at different rates onto a common time grid.
+//
+
+#include "SignalResampler.h"
+#include <QRunnable>
+#include <QSharedPointer>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+// Function to check whether a rate is a whole number of hertz
+static bool isWholeRate(double rate) {
+    return rate >= 1 && rate < std::numeric_limits<int>::max() && rate == std::floor(rate);
+}
+
+// Constructor, designs the phases of the interpolation filter
+PolyphaseResampler::PolyphaseResampler(double inputRate, double outputRate, int zeroCrossings)
+        : inRate(inputRate > 0 ? inputRate : 1), outRate(outputRate > 0 ? outputRate : 1), step(1),
+          halfTaps(0), taps(0), phases(1) {
+    step = inRate / outRate;
+    if (inRate == outRate) {
+        return;   // Samples are copied
+    }
+
+    // Cutoff in cycles per input sample, below the Nyquist frequency of the lower rate
+    double cutoff = 0.45 * std::min(1.0, outRate / inRate);
+    halfTaps = static_cast<int>(std::ceil(std::max(1, zeroCrossings) / (2 * cutoff)));
+    taps = (2 * halfTaps + lanes - 1) / lanes * lanes;
+
+    // One phase per fractional position if the rates have a small exact ratio, else a bounded set
+    phases = qBound(1, maxCoefficients / taps, 1024);
+    if (isWholeRate(inRate) && isWholeRate(outRate)) {
+        qint64 in = static_cast<qint64>(inRate);
+        qint64 out = static_cast<qint64>(outRate);
+        qint64 up = out / std::gcd(in, out);
+        if (up * taps <= maxCoefficients) {
+            phases = static_cast<int>(up);
+        }
+    }
+
+    coefficients = QVector<float>(phases * taps, 0.0f);
+    for (int phase = 0; phase < phases; ++phase) {
+        float *row = coefficients.data() + phase * taps;
+        double sum = 0;
+        for (int k = 0; k < 2 * halfTaps; ++k) {
+            // Distance in input samples from input tap k to the output position
+            double distance = static_cast<double>(phase) / phases + (halfTaps - 1 - k);
+            double x = distance / halfTaps;
+            if (std::abs(x) >= 1) {
+                continue;
+            }
+            double argument = M_PI * 2 * cutoff * distance;
+            double sinc = argument == 0 ? 1 : std::sin(argument) / argument;
+            double window = 0.42 + 0.5 * std::cos(M_PI * x) + 0.08 * std::cos(2 * M_PI * x);
+            row[k] = static_cast<float>(sinc * window);
+            sum += row[k];
+        }
+
+        // Unity gain at DC for every phase
+        for (int k = 0; k < taps; ++k) {
+            row[k] = static_cast<float>(row[k] / sum);
+        }
+    }
+}
+
+// Function to get the input rate
+double PolyphaseResampler::inputRate() const {
+    return inRate;
+}
+
+// Function to get the output rate
+double PolyphaseResampler::outputRate() const {
+    return outRate;
+}
+
+// Function to get the number of taps per phase, 0 when samples are copied
+int PolyphaseResampler::tapCount() const {
+    return taps;
+}
+
+// Function to get the number of phases
+int PolyphaseResampler::phaseCount() const {
+    return phases;
+}
+
+// Function to copy input samples first..first+length-1 as floats, repeating the end values outside the input
+template <typename T>
+static void gather(const T *samples, int count, double scale, qint64 first, float *work, qint64 length) {
+    qint64 begin = qBound<qint64>(0, -first, length);
+    qint64 end = qBound<qint64>(begin, count - first, length);
+    std::fill(work, work + begin, static_cast<float>(samples[0] * scale));
+    for (qint64 k = begin; k < end; ++k) {
+        work[k] = static_cast<float>(samples[first + k] * scale);
+    }
+    std::fill(work + end, work + length, static_cast<float>(samples[count - 1] * scale));
+}
+
+// Function to multiply a phase with the input samples; the fixed-width lanes are independent sums,
+// which the compiler turns into vector multiply-adds without reordering the additions
+static inline float dotProduct(const float *coefficients, const float *samples, int taps) {
+    float sums[8] = {};
+    for (int k = 0; k < taps; k += 8) {
+        for (int lane = 0; lane < 8; ++lane) {
+            sums[lane] += coefficients[k + lane] * samples[k + lane];
+        }
+    }
+    return ((sums[0] + sums[4]) + (sums[1] + sums[5])) + ((sums[2] + sums[6]) + (sums[3] + sums[7]));
+}
+
+// Function to resample a range of output samples
+void PolyphaseResampler::resample(const SampleBuffer &input, qint64 first, qint64 last, float *out) const {
+    if (last < first) {
+        return;
+    }
+    int count = input.size();
+    if (count == 0) {
+        std::fill(out, out + (last - first + 1), 0.0f);
+        return;
+    }
+
+    // Input samples the outputs reach, including a phase rounded up to the next sample
+    qint64 inputFirst = static_cast<qint64>(std::floor(first * step)) - halfTaps + 1;
+    qint64 inputLast = static_cast<qint64>(std::floor(last * step)) + 1 - halfTaps + taps;
+    if (taps == 0) {
+        inputFirst = first;
+        inputLast = last;
+    }
+    QVector<float> work(static_cast<int>(inputLast - inputFirst + 1));
+    input.visit([&](const auto *samples, int) {
+        gather(samples, count, input.scale(), inputFirst, work.data(), work.size());
+    });
+
+    if (taps == 0) {
+        std::copy(work.constData(), work.constData() + work.size(), out);
+        return;
+    }
+    const float *samples = work.constData();
+    const float *rows = coefficients.constData();
+    for (qint64 i = first; i <= last; ++i) {
+        double position = i * step;
+        qint64 sample = static_cast<qint64>(std::floor(position));
+        int phase = static_cast<int>(std::lround((position - sample) * phases));
+        if (phase == phases) {
+            ++sample;
+            phase = 0;
+        }
+        out[i - first] = dotProduct(rows + phase * taps, samples + (sample - halfTaps + 1 - inputFirst), taps);
+    }
+}
+
+// Worker resampling one chunk of one channel into its slot of the output
+class SignalAligner::ChunkTask : public QRunnable {
+public:
+    ChunkTask(const QSharedPointer<PolyphaseResampler> &resampler, const SampleBuffer &samples,
+              qint64 first, qint64 last, float *out)
+            : resampler(resampler), samples(samples), first(first), last(last), out(out) {}
+
+    void run() override {
+        resampler->resample(samples, first, last, out);
+    }
+
+private:
+    QSharedPointer<PolyphaseResampler> resampler;
+    SampleBuffer samples;
+    qint64 first;
+    qint64 last;
+    float *out;
+};
+
+// Constructor
+SignalAligner::SignalAligner() {
+}
+
+// Destructor
+SignalAligner::~SignalAligner() {
+    pool.waitForDone();
+}
+
+// Function to set the channels to align
+void SignalAligner::setChannels(const QMap<QString, SampleBuffer> &channels, const QMap<QString, double> &samplingRates) {
+    sources.clear();
+    for (auto it = channels.cbegin(); it != channels.cend(); ++it) {
+        Source &source = sources[it.key()];
+        source.samples = it.value();
+        source.samplingRate = samplingRates.value(it.key(), 1);
+    }
+}
+
+// Function to drop the channels
+void SignalAligner::clear() {
+    sources.clear();
+}
+
+// Function to get the channel names
+QStringList SignalAligner::channelNames() const {
+    return sources.keys();
+}
+
+// Function to get the rate of one channel
+double SignalAligner::samplingRate(const QString &name) const {
+    auto it = sources.constFind(name);
+    return it != sources.constEnd() ? it.value().samplingRate : 0;
+}
+
+// Function to get the highest rate of all channels
+double SignalAligner::highestRate() const {
+    double rate = 0;
+    for (const Source &source : sources) {
+        rate = std::max(rate, source.samplingRate);
+    }
+    return rate;
+}
+
+// Function to get the length of the longest channel in seconds
+double SignalAligner::duration() const {
+    double seconds = 0;
+    for (const Source &source : sources) {
+        seconds = std::max(seconds, (source.samples.size() - 1) / source.samplingRate);
+    }
+    return seconds;
+}
+
+// Function to resample channels onto a common grid
+AlignedSignal SignalAligner::align(const QStringList &names, double samplingRate, double startTime, double endTime) {
+    AlignedSignal result;
+    result.samplingRate = samplingRate > 0 ? samplingRate : highestRate();
+    double rate = result.samplingRate;
+    if (sources.isEmpty() || rate <= 0) {
+        return result;
+    }
+
+    // Output samples inside the range and the recording
+    qint64 first = std::max<qint64>(0, static_cast<qint64>(std::ceil(startTime * rate)));
+    qint64 last = static_cast<qint64>(std::floor(std::min(endTime, duration()) * rate));
+    last = std::min<qint64>(last, first + std::numeric_limits<int>::max() - 1);
+    if (last < first) {
+        return result;
+    }
+    int count = static_cast<int>(last - first + 1);
+    result.startTime = first / rate;
+
+    // Chunks of about the same number of multiply-adds, whatever the filter length
+    const qint64 workPerChunk = 1 << 22;
+    QMap<double, QSharedPointer<PolyphaseResampler>> resamplers;
+    QMap<QString, QVector<float>> outputs;
+    const QStringList selected = names.isEmpty() ? QStringList(sources.keys()) : names;
+    for (const QString &name : selected) {
+        auto it = sources.constFind(name);
+        if (it == sources.constEnd() || outputs.contains(name)) {
+            continue;
+        }
+        QSharedPointer<PolyphaseResampler> &resampler = resamplers[it.value().samplingRate];
+        if (!resampler) {
+            resampler.reset(new PolyphaseResampler(it.value().samplingRate, rate));
+        }
+
+        QVector<float> &values = outputs[name];
+        values.resize(count);
+        qint64 chunk = std::max<qint64>(4096, workPerChunk / std::max(1, resampler->tapCount()));
+        for (qint64 from = 0; from < count; from += chunk) {
+            qint64 to = std::min<qint64>(from + chunk, count) - 1;
+            pool.start(new ChunkTask(resampler, it.value().samples, first + from, first + to, values.data() + from));
+        }
+    }
+    pool.waitForDone();
+
+    for (auto it = outputs.cbegin(); it != outputs.cend(); ++it) {
+        result.channels.insert(it.key(), SampleBuffer(it.value()));
+    }
+    return result;
+}
@@ -0,0 +1,86 @@
+//
+// Polyphase resampling of channels recorded at different rates onto a common time grid.
+//
+
+#ifndef SIGNALRESAMPLER_H
+#define SIGNALRESAMPLER_H
+
+#include <QMap>
+#include <QString>
+#include <QStringList>
+#include <QThreadPool>
+#include <QVector>
+#include "SampleBuffer.h"
+
+// PolyphaseResampler converts one channel from its sampling rate to another. The interpolation
+// filter is a Blackman-windowed sinc with its cutoff at 0.45 of the lower of the two rates, split
+// into phases so every output sample is one dot product of a phase with the input samples around
+// it. Rates with a small exact ratio (e.g. 250 Hz to 44.1 kHz) get one phase per distinct
+// fractional position; others pick the nearest of a bounded number of phases.
+class PolyphaseResampler {
+public:
+    PolyphaseResampler(double inputRate, double outputRate, int zeroCrossings = 16);
+
+    double inputRate() const;
+    double outputRate() const;
+    int tapCount() const;
+    int phaseCount() const;
+
+    // Write output samples first..last (output sample i lies at t = i / outputRate) into out as
+    // floats. Input samples before the start or after the end of the input repeat its end values.
+    void resample(const SampleBuffer &input, qint64 first, qint64 last, float *out) const;
+
+private:
+    // Coefficients per phase; taps are padded with zeros to a multiple of this for the dot product
+    static constexpr int lanes = 8;
+    static constexpr int maxCoefficients = 1 << 20;
+
+    double inRate;
+    double outRate;
+    double step;                     // Input samples per output sample
+    int halfTaps;                    // Input samples on either side of the output position
+    int taps;
+    int phases;
+    QVector<float> coefficients;     // phases x taps, tap 0 weights the earliest input sample
+};
+
+// Channels resampled onto one grid, all of the same length
+struct AlignedSignal {
+    double samplingRate = 0;
+    double startTime = 0;                   // Time of sample 0 (s)
+    QMap<QString, SampleBuffer> channels;   // Floats
+};
+
+// SignalAligner keeps the channels of a recording with their own sampling rates and produces
+// aligned views at a common rate on request. The output of every channel is split into chunks
+// that are resampled in parallel on a worker pool; align() returns once all chunks are done.
+class SignalAligner {
+public:
+    SignalAligner();
+    ~SignalAligner();
+
+    // Set the channels and their rates; buffers are shared, not copied
+    void setChannels(const QMap<QString, SampleBuffer> &channels, const QMap<QString, double> &samplingRates);
+    void clear();
+
+    QStringList channelNames() const;
+    double samplingRate(const QString &name) const;     // 0 for unknown channels
+    double highestRate() const;
+    double duration() const;                            // Time of the last sample of the longest channel
+
+    // Resample the named channels (all for an empty list) to samples at t = i / samplingRate for
+    // startTime <= t <= endTime, clamped to the recording; a rate of 0 selects the highest rate
+    AlignedSignal align(const QStringList &names, double samplingRate, double startTime, double endTime);
+
+private:
+    class ChunkTask;
+
+    struct Source {
+        SampleBuffer samples;
+        double samplingRate = 1;
+    };
+    QMap<QString, Source> sources;
+    QThreadPool pool;
+};
+
+#endif // SIGNALRESAMPLER_H
@@ -0,0 +1,77 @@
+//
+// Single-pass summary statistics for signal channels.
+//
+
+#include "SignalStats.h"
+#include <algorithm>
+
+// Function to compute the min/max of a sample array of any type in a single fused pass
+template <typename T>
+static SignalStats computeTypedStats(const T *samples, int count) {
+    SignalStats stats;
+    if (!samples || count <= 0) {
+        return stats;
+    }
+
+    // Independent accumulator lanes keep the loop free of dependencies so it vectorizes
+    const int lanes = 4;
+    T mins[lanes];
+    T maxs[lanes];
+    for (int lane = 0; lane < lanes; ++lane) {
+        mins[lane] = samples[0];
+        maxs[lane] = samples[0];
+    }
+
+    int blockEnd = count - count % lanes;
+    for (int i = 0; i < blockEnd; i += lanes) {
+        for (int lane = 0; lane < lanes; ++lane) {
+            T value = samples[i + lane];
+            mins[lane] = value < mins[lane] ? value : mins[lane];
+            maxs[lane] = value > maxs[lane] ? value : maxs[lane];
+        }
+    }
+    for (int i = blockEnd; i < count; ++i) {
+        mins[0] = std::min(mins[0], samples[i]);
+        maxs[0] = std::max(maxs[0], samples[i]);
+    }
+
+    stats.minValue = *std::min_element(mins, mins + lanes);
+    stats.maxValue = *std::max_element(maxs, maxs + lanes);
+    stats.valid = true;
+    return stats;
+}
+
+// Function to compute the min/max of double samples
+SignalStats computeSignalStats(const double *samples, int count) {
+    return computeTypedStats(samples, count);
+}
+
+// Function to compute the min/max of float samples
+SignalStats computeSignalStats(const float *samples, int count) {
+    return computeTypedStats(samples, count);
+}
+
+// Function to compute the min/max of 16-bit samples in stored units
+SignalStats computeSignalStats(const qint16 *samples, int count) {
+    return computeTypedStats(samples, count);
+}
+
+// Function to compute the min/max of a range of a typed buffer in physical units
+SignalStats computeSignalStats(const SampleBuffer &samples, int first, int count) {
+    SignalStats stats;
+    first = qBound(0, first, samples.size());
+    count = count < 0 ? samples.size() - first : qMin(count, samples.size() - first);
+    samples.visit([&stats, first, count](const auto *data, int) {
+        stats = computeSignalStats(data + first, count);
+    });
+
+    // Scaling happens once on the result, not per sample; a negative scale swaps the ends
+    double scale = samples.scale();
+    if (stats.valid && scale != 1) {
+        double first = stats.minValue * scale;
+        double second = stats.maxValue * scale;
+        stats.minValue = std::min(first, second);
+        stats.maxValue = std::max(first, second);
+    }
+    return stats;
+}
@@ -0,0 +1,28 @@
+//
+// Single-pass summary statistics for signal channels.
+//
+
+#ifndef SIGNALSTATS_H
+#define SIGNALSTATS_H
+
+#include "SampleBuffer.h"
+
+// Range of a channel as needed for centering and axis scaling
+struct SignalStats {
+    double minValue = 0;
+    double maxValue = 0;
+    bool valid = false;   // False for empty input
+
+    // Center of the value range
+    double center() const { return (minValue + maxValue) / 2; }
+};
+
+// Compute min, max and center of a sample array in one vectorizable pass, in the array's units
+SignalStats computeSignalStats(const double *samples, int count);
+SignalStats computeSignalStats(const float *samples, int count);
+SignalStats computeSignalStats(const qint16 *samples, int count);
+
+// Same for count samples of a typed buffer starting at first (all if count < 0), in physical units
+SignalStats computeSignalStats(const SampleBuffer &samples, int first = 0, int count = -1);
+
+#endif // SIGNALSTATS_H
@@ -0,0 +1,542 @@
+//
+// Persistent cache of the display data derived from recordings.
+//
+
+#include "SignalViewCache.h"
+#include <QCryptographicHash>
+#include <QFile>
+#include <QFileInfo>
+#include <QRunnable>
+#include <QSaveFile>
+#include <cstring>
+#include <limits>
+
+// Format version, advanced whenever the layout or the processing behind the stored data changes
+static const quint32 formatVersion = 3;
+
+// Kinds of cache files
+static const quint32 signalKind = 1;
+static const quint32 spectrogramKind = 2;
+
+static const char cacheMagic[8] = {'S', 'P', 'A', 'N', 'V', 'I', 'E', 'W'};
+
+// Bytes per hashed content block, and blocks hashed per recording
+static const qint64 fingerprintBlockBytes = 64 * 1024;
+static const int fingerprintBlocks = 32;
+
+// Fixed header at the start of every cache file
+struct CacheHeader {
+    char magic[8];
+    quint32 version;
+    quint32 kind;
+    char key[32];
+    char contentHash[32];    // SHA-256 of all samples of a recording, zero for spectrograms
+    qint64 fileBytes;        // Size of the complete file, rejects truncated files
+    qint32 entryCount;
+    qint32 reserved;
+};
+
+// Record in front of the name and arrays of one channel
+struct ChannelRecord {
+    qint32 nameBytes;
+    qint32 type;
+    qint32 sampleCount;
+    qint32 levelCount;       // Pyramid levels above the raw level
+    double scale;
+    double minValue;         // Statistics of all samples
+    double maxValue;
+    qint32 statsValid;
+    qint32 hasIndex;         // Selection index arrays follow the levels
+    qint32 landmarkCounts[SignalLandmarks::kindCount];   // Landmark indexes of each kind follow the index
+};
+
+// Record in front of the frames of a spectrogram
+struct SpectrogramRecord {
+    qint32 frameCount;
+    qint32 binCount;
+    double duration;
+    double maxFrequency;
+};
+
+// Function to round an offset up to the alignment of all records and arrays
+static qint64 aligned(qint64 offset) {
+    return (offset + 7) & ~static_cast<qint64>(7);
+}
+
+// Function to add the bytes of a plain value to a hash
+template <typename T>
+static void addValue(QCryptographicHash &hash, const T &value) {
+    hash.addData(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+// Function to add the size and evenly spaced blocks of a byte range to a hash, first and last included
+static void addFingerprint(QCryptographicHash &hash, const char *bytes, qint64 size, int blocks) {
+    addValue(hash, size);
+    if (size <= blocks * fingerprintBlockBytes) {
+        hash.addData(bytes, static_cast<int>(size));
+        return;
+    }
+    qint64 stride = (size - fingerprintBlockBytes) / (blocks - 1);
+    for (int k = 0; k < blocks; ++k) {
+        qint64 offset = k == blocks - 1 ? size - fingerprintBlockBytes : k * stride;
+        hash.addData(bytes + offset, static_cast<int>(fingerprintBlockBytes));
+    }
+}
+
+// Function to add the size and modification time of a recording to a hash; most edits change one of them
+static void addFileStamp(QCryptographicHash &hash, const QString &path) {
+    QFileInfo info(path);
+    addValue(hash, info.size());
+    addValue(hash, info.lastModified().toMSecsSinceEpoch());
+}
+
+// Function to compute the key of a recording's summary
+static QByteArray signalKey(const MappedSignalFile &file) {
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    addValue(hash, formatVersion);
+    addValue(hash, signalKind);
+    addValue(hash, static_cast<qint32>(Q_BYTE_ORDER));
+    addValue(hash, static_cast<qint32>(SignalPyramid::reductionFactor));
+    addValue(hash, static_cast<qint32>(SignalRangeIndex::blockSize));
+    addValue(hash, file.samplingRate());
+
+    addFileStamp(hash, file.fileName());
+
+    // Blocks are spread over all channels, so the bytes read do not grow with their number
+    int channels = file.channelCount();
+    int blocks = qMax(2, fingerprintBlocks / qMax(1, channels));
+    for (int i = 0; i < channels; ++i) {
+        SampleBuffer samples = file.channel(i);
+        hash.addData(file.channelNames()[i].toUtf8());
+        addValue(hash, static_cast<qint32>(samples.type()));
+        addValue(hash, samples.scale());
+        samples.visit([&](const auto *data, int count) {
+            addFingerprint(hash, reinterpret_cast<const char *>(data), static_cast<qint64>(count) * sizeof(*data), blocks);
+        });
+    }
+    return hash.result();
+}
+
+// Function to hash all samples of a recording, channel after channel
+static QByteArray contentHash(const MappedSignalFile &file) {
+    static const qint64 pieceBytes = 16 * 1024 * 1024;
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    for (int i = 0; i < file.channelCount(); ++i) {
+        file.channel(i).visit([&](const auto *data, int count) {
+            const char *bytes = reinterpret_cast<const char *>(data);
+            qint64 size = static_cast<qint64>(count) * sizeof(*data);
+            for (qint64 offset = 0; offset < size; offset += pieceBytes) {
+                hash.addData(bytes + offset, static_cast<int>(qMin(pieceBytes, size - offset)));
+            }
+        });
+    }
+    return hash.result();
+}
+
+// Function to get the number of pyramid levels above the raw level that build() makes for count samples
+static int expectedLevelCount(int count) {
+    int levels = 0;
+    while (count > SignalPyramid::reductionFactor) {
+        count = (count + SignalPyramid::reductionFactor - 1) / SignalPyramid::reductionFactor;
+        ++levels;
+    }
+    return levels;
+}
+
+// Function to write bytes followed by padding up to the next aligned offset
+static bool writeBytes(QSaveFile &out, const void *data, qint64 bytes) {
+    static const char zeros[8] = {};
+    if (bytes > 0 && out.write(static_cast<const char *>(data), bytes) != bytes) {
+        return false;
+    }
+    qint64 padding = aligned(out.pos()) - out.pos();
+    return padding == 0 || out.write(zeros, padding) == padding;
+}
+
+// Function to write the stored samples of a buffer
+static bool writeSamples(QSaveFile &out, const SampleBuffer &samples) {
+    bool ok = true;
+    samples.visit([&](const auto *data, int count) {
+        ok = writeBytes(out, data, static_cast<qint64>(count) * sizeof(*data));
+    });
+    return ok;
+}
+
+// Function to open a cache file for writing and reserve its header
+static bool beginFile(QSaveFile &out) {
+    CacheHeader header = {};
+    return out.open(QIODevice::WriteOnly) && writeBytes(out, &header, sizeof(header));
+}
+
+// Function to fill in the header and replace the cache file with the written one
+static bool finishFile(QSaveFile &out, quint32 kind, const QByteArray &key, const QByteArray &content, int entryCount) {
+    CacheHeader header = {};
+    std::memcpy(header.magic, cacheMagic, sizeof(header.magic));
+    header.version = formatVersion;
+    header.kind = kind;
+    std::memcpy(header.key, key.constData(), qMin<size_t>(sizeof(header.key), key.size()));
+    std::memcpy(header.contentHash, content.constData(), qMin<size_t>(sizeof(header.contentHash), content.size()));
+    header.fileBytes = out.pos();
+    header.entryCount = entryCount;
+    if (!out.seek(0) || out.write(reinterpret_cast<const char *>(&header), sizeof(header)) != sizeof(header)) {
+        out.cancelWriting();
+        return false;
+    }
+    return out.commit();
+}
+
+// Function to copy a record out of the mapping and move past it
+template <typename T>
+static bool readRecord(const MappedSignalFile &cache, qint64 &offset, T &record) {
+    if (offset + static_cast<qint64>(sizeof(T)) > cache.byteCount()) {
+        return false;
+    }
+    std::memcpy(&record, cache.bytes() + offset, sizeof(T));
+    offset = aligned(offset + sizeof(T));
+    return true;
+}
+
+// Function to copy an array of sample indexes out of the mapping and move past it
+static bool readIndexes(const MappedSignalFile &cache, qint64 &offset, int count, int sampleCount, QVector<int> &out) {
+    qint64 bytes = static_cast<qint64>(count) * sizeof(qint32);
+    if (count < 0 || offset + bytes > cache.byteCount()) {
+        return false;
+    }
+    out.resize(count);
+    if (count > 0) {
+        std::memcpy(out.data(), cache.bytes() + offset, bytes);
+    }
+    offset = aligned(offset + bytes);
+
+    // Queries rely on sorted indexes inside the channel
+    for (int i = 0; i < count; ++i) {
+        if (out[i] < 0 || out[i] >= sampleCount || (i > 0 && out[i] < out[i - 1])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Function to refer to an array inside the mapping and move past it
+static bool readSamples(const MappedSignalFile &cache, qint64 &offset, SampleBuffer::Type type, int count, double scale, SampleBuffer &out) {
+    out = cache.region(offset, type, count, scale);
+    if (out.size() != count) {
+        return false;
+    }
+    offset = aligned(offset + static_cast<qint64>(count) * SampleBuffer::sampleSize(type));
+    return true;
+}
+
+// Function to map a cache file and check that its header matches; offset is set to the first record
+static QSharedPointer<MappedSignalFile> openCache(const QString &path, quint32 kind, const QByteArray &key, int entryCount, qint64 &offset) {
+    QSharedPointer<MappedSignalFile> cache = MappedSignalFile::openData(path);
+    offset = 0;
+    CacheHeader header;
+    if (!cache || !readRecord(*cache, offset, header)) {
+        return QSharedPointer<MappedSignalFile>();
+    }
+    if (std::memcmp(header.magic, cacheMagic, sizeof(header.magic)) != 0 || header.version != formatVersion
+        || header.kind != kind || key.size() != static_cast<int>(sizeof(header.key))
+        || std::memcmp(header.key, key.constData(), sizeof(header.key)) != 0
+        || header.fileBytes != cache->byteCount() || header.entryCount != entryCount) {
+        return QSharedPointer<MappedSignalFile>();
+    }
+    return cache;
+}
+
+// Function to write the summary of a recording
+static void writeSignal(const QSharedPointer<MappedSignalFile> &file, const PreparedSignal &summary) {
+    // Every channel of the recording must be summarized, in the order of the file
+    QVector<const PreparedChannel *> channels;
+    for (const QString &name : file->channelNames()) {
+        const PreparedChannel *found = nullptr;
+        for (const PreparedChannel &channel : summary.channels) {
+            if (channel.name == name) {
+                found = &channel;
+            }
+        }
+        if (!found || found->samples.size() != file->samplesPerChannel() || found->samples.isEmpty()) {
+            return;
+        }
+        channels.append(found);
+    }
+
+    QSaveFile out(SignalViewCache::signalCachePath(file->fileName()));
+    bool ok = beginFile(out);
+    for (const PreparedChannel *channel : channels) {
+        QByteArray name = channel->name.toUtf8();
+        ChannelRecord record = {};
+        record.nameBytes = name.size();
+        record.type = channel->samples.type();
+        record.sampleCount = channel->samples.size();
+        record.levelCount = channel->pyramid.levelCount() - 1;
+        record.scale = channel->samples.scale();
+        record.minValue = channel->stats.minValue;
+        record.maxValue = channel->stats.maxValue;
+        record.statsValid = channel->stats.valid;
+        record.hasIndex = !channel->rangeIndex.isEmpty();
+        QVector<int> landmarks[SignalLandmarks::kindCount];
+        for (int k = 0; k < SignalLandmarks::kindCount; ++k) {
+            landmarks[k] = channel->landmarks.positions(static_cast<SignalLandmarks::Kind>(1 << k));
+            record.landmarkCounts[k] = landmarks[k].size();
+        }
+        ok = ok && writeBytes(out, &record, sizeof(record)) && writeBytes(out, name.constData(), name.size());
+        for (int level = 1; ok && level < channel->pyramid.levelCount(); ++level) {
+            ok = writeSamples(out, channel->pyramid.minValues(level)) && writeSamples(out, channel->pyramid.maxValues(level));
+        }
+        if (ok && record.hasIndex) {
+            SignalRangeIndex::Blocks blocks = channel->rangeIndex.blocks();
+            ok = writeSamples(out, blocks.sumPrefix) && writeSamples(out, blocks.squarePrefix)
+                 && writeSamples(out, blocks.pathPrefix) && writeSamples(out, blocks.maxSteps);
+        }
+        for (int k = 0; ok && k < SignalLandmarks::kindCount; ++k) {
+            ok = writeBytes(out, landmarks[k].constData(), static_cast<qint64>(landmarks[k].size()) * sizeof(qint32));
+        }
+    }
+    if (!ok) {
+        out.cancelWriting();
+        return;
+    }
+    // The background pass left the pages of the recording resident, so hashing them reads no disk
+    finishFile(out, signalKind, signalKey(*file), contentHash(*file), channels.size());
+}
+
+// Function to write the spectrogram of a recording
+static void writeSpectrogram(const QString &recordingPath, const QByteArray &key, const CachedSpectrogram &spectrogram) {
+    QSaveFile out(SignalViewCache::spectrogramCachePath(recordingPath));
+    SpectrogramRecord record = {};
+    record.frameCount = spectrogram.frameCount;
+    record.binCount = spectrogram.binCount;
+    record.duration = spectrogram.duration;
+    record.maxFrequency = spectrogram.maxFrequency;
+    if (!beginFile(out) || !writeBytes(out, &record, sizeof(record)) || !writeSamples(out, spectrogram.frames)) {
+        out.cancelWriting();
+        return;
+    }
+    finishFile(out, spectrogramKind, key, QByteArray(), 1);
+}
+
+// Function to check that the cached summary of a recording was built from its current samples
+static bool contentMatches(const MappedSignalFile &file) {
+    qint64 offset;
+    QSharedPointer<MappedSignalFile> cache = openCache(SignalViewCache::signalCachePath(file.fileName()), signalKind, signalKey(file),
+                                                       file.channelCount(), offset);
+    CacheHeader header;
+    offset = 0;
+    if (!cache || !readRecord(*cache, offset, header)) {
+        return true;   // Replaced since it was loaded; its own check belongs to whoever loads it
+    }
+    QByteArray content = contentHash(file);
+    return content.size() == static_cast<int>(sizeof(header.contentHash))
+           && std::memcmp(header.contentHash, content.constData(), sizeof(header.contentHash)) == 0;
+}
+
+// Worker writing or checking one cache file
+class SignalViewCache::StoreTask : public QRunnable {
+public:
+    StoreTask(const QSharedPointer<MappedSignalFile> &file, const PreparedSignal &summary)
+            : file(file), summary(summary), receiver(nullptr) {}
+    StoreTask(const QString &recordingPath, const QByteArray &key, const CachedSpectrogram &spectrogram)
+            : recordingPath(recordingPath), key(key), spectrogram(spectrogram), receiver(nullptr) {}
+    StoreTask(const QSharedPointer<MappedSignalFile> &file, QObject *receiver, const std::function<void()> &onStale)
+            : file(file), receiver(receiver), onStale(onStale) {}
+
+    void run() override {
+        if (receiver) {
+            if (!contentMatches(*file)) {
+                QMetaObject::invokeMethod(receiver, onStale, Qt::QueuedConnection);
+            }
+        } else if (file) {
+            writeSignal(file, summary);
+        } else {
+            writeSpectrogram(recordingPath, key, spectrogram);
+        }
+    }
+
+private:
+    QSharedPointer<MappedSignalFile> file;
+    PreparedSignal summary;
+    QString recordingPath;
+    QByteArray key;
+    CachedSpectrogram spectrogram;
+    QObject *receiver;                  // Set for a check
+    std::function<void()> onStale;
+};
+
+// Constructor
+SignalViewCache::SignalViewCache() {
+    pool.setMaxThreadCount(1);
+}
+
+// Destructor, pending stores are finished so no cache is lost
+SignalViewCache::~SignalViewCache() {
+    pool.waitForDone();
+}
+
+// Function to get the summary cache file of a recording
+QString SignalViewCache::signalCachePath(const QString &recordingPath) {
+    return recordingPath + ".viewcache";
+}
+
+// Function to get the spectrogram cache file of a recording
+QString SignalViewCache::spectrogramCachePath(const QString &recordingPath) {
+    return recordingPath + ".spectrogram.viewcache";
+}
+
+// Function to compute the key of a spectrogram
+QByteArray SignalViewCache::spectrogramKey(const QString &recordingPath, const QVector<double> &samples, double samplingRate,
+                                           const SpectrogramParameters &parameters) {
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    addValue(hash, formatVersion);
+    addValue(hash, spectrogramKind);
+    addValue(hash, static_cast<qint32>(Q_BYTE_ORDER));
+    addFileStamp(hash, recordingPath);
+    addValue(hash, samplingRate);
+    addValue(hash, static_cast<qint32>(parameters.windowType));
+    addValue(hash, static_cast<qint32>(parameters.windowLength));
+    addValue(hash, static_cast<qint32>(parameters.hopSize));
+    addValue(hash, static_cast<qint32>(parameters.fftSize));
+    addValue(hash, parameters.maxFrequency);
+    addFingerprint(hash, reinterpret_cast<const char *>(samples.constData()),
+                   static_cast<qint64>(samples.size()) * sizeof(double), fingerprintBlocks);
+    return hash.result();
+}
+
+// Function to read the cached summary of a mapped recording
+bool SignalViewCache::loadSignal(const QSharedPointer<MappedSignalFile> &file, PreparedSignal &out) {
+    // The key reads parts of the recording, so it is only computed if there is a cache to check
+    if (!file || file->samplesPerChannel() == 0 || !QFile::exists(signalCachePath(file->fileName()))) {
+        return false;
+    }
+    qint64 offset;
+    QSharedPointer<MappedSignalFile> cache = openCache(signalCachePath(file->fileName()), signalKind, signalKey(*file),
+                                                       file->channelCount(), offset);
+    if (!cache) {
+        return false;
+    }
+
+    PreparedSignal result;
+    double rate = file->samplingRate();
+    result.samplingRate = rate;
+    result.globalMin = std::numeric_limits<double>::max();
+    result.globalMax = std::numeric_limits<double>::lowest();
+    QStringList names = file->channelNames();
+    for (int i = 0; i < names.size(); ++i) {
+        ChannelRecord record;
+        if (!readRecord(*cache, offset, record) || record.nameBytes < 0 || offset + record.nameBytes > cache->byteCount()) {
+            return false;
+        }
+        QString name = QString::fromUtf8(reinterpret_cast<const char *>(cache->bytes() + offset), record.nameBytes);
+        offset = aligned(offset + record.nameBytes);
+
+        PreparedChannel channel;
+        channel.name = names[i];
+        channel.samples = file->channel(i);
+        channel.samplingRate = rate;
+        SampleBuffer::Type type = channel.samples.type();
+        int count = channel.samples.size();
+        double scale = channel.samples.scale();
+        if (name != channel.name || record.type != type || record.sampleCount != count || record.scale != scale
+            || record.levelCount != expectedLevelCount(count)) {
+            return false;
+        }
+
+        // Levels and index arrays stay in the cache file and are paged in as they are read
+        QVector<SampleBuffer> mins;
+        QVector<SampleBuffer> maxs;
+        int buckets = count;
+        for (int level = 1; level <= record.levelCount; ++level) {
+            buckets = (buckets + SignalPyramid::reductionFactor - 1) / SignalPyramid::reductionFactor;
+            SampleBuffer levelMins;
+            SampleBuffer levelMaxs;
+            if (!readSamples(*cache, offset, type, buckets, scale, levelMins) || !readSamples(*cache, offset, type, buckets, scale, levelMaxs)) {
+                return false;
+            }
+            mins.append(levelMins);
+            maxs.append(levelMaxs);
+        }
+        channel.pyramid.setLevels(mins, maxs);
+
+        if (record.hasIndex) {
+            int blockCount = (count + SignalRangeIndex::blockSize - 1) / SignalRangeIndex::blockSize;
+            SignalRangeIndex::Blocks blocks;
+            blocks.sampleCount = count;
+            if (!readSamples(*cache, offset, SampleBuffer::Float64, blockCount + 1, 1, blocks.sumPrefix)
+                || !readSamples(*cache, offset, SampleBuffer::Float64, blockCount + 1, 1, blocks.squarePrefix)
+                || !readSamples(*cache, offset, SampleBuffer::Float64, blockCount + 1, 1, blocks.pathPrefix)
+                || !readSamples(*cache, offset, SampleBuffer::Float64, blockCount, 1, blocks.maxSteps)) {
+                return false;
+            }
+            channel.rangeIndex.restore(blocks);
+        }
+        for (int k = 0; k < SignalLandmarks::kindCount; ++k) {
+            QVector<int> indexes;
+            if (!readIndexes(*cache, offset, record.landmarkCounts[k], count, indexes)) {
+                return false;
+            }
+            channel.landmarks.setPositions(static_cast<SignalLandmarks::Kind>(1 << k), indexes);
+        }
+
+        channel.stats.minValue = record.minValue;
+        channel.stats.maxValue = record.maxValue;
+        channel.stats.valid = record.statsValid != 0;
+        if (channel.stats.valid) {
+            result.globalMin = qMin(result.globalMin, channel.stats.minValue);
+            result.globalMax = qMax(result.globalMax, channel.stats.maxValue);
+        }
+        result.maxTime = qMax(result.maxTime, (count - 1) / rate);
+        result.channels.append(std::move(channel));
+    }
+
+    out = std::move(result);
+    return true;
+}
+
+// Function to write the summary of a mapped recording in the background
+void SignalViewCache::storeSignal(const QSharedPointer<MappedSignalFile> &file, const PreparedSignal &summary) {
+    if (file) {
+        pool.start(new StoreTask(file, summary));
+    }
+}
+
+// Function to check the cached summary of a mapped recording in the background
+void SignalViewCache::verifySignal(const QSharedPointer<MappedSignalFile> &file, QObject *receiver, const std::function<void()> &onStale) {
+    if (file && receiver) {
+        pool.start(new StoreTask(file, receiver, onStale));
+    }
+}
+
+// Function to read the cached spectrogram of a recording
+bool SignalViewCache::loadSpectrogram(const QString &recordingPath, const QByteArray &key, CachedSpectrogram &out) {
+    qint64 offset;
+    QSharedPointer<MappedSignalFile> cache = openCache(spectrogramCachePath(recordingPath), spectrogramKind, key, 1, offset);
+    SpectrogramRecord record;
+    if (!cache || !readRecord(*cache, offset, record) || record.frameCount <= 0 || record.binCount <= 0
+        || record.frameCount > std::numeric_limits<int>::max() / record.binCount) {
+        return false;
+    }
+
+    CachedSpectrogram result;
+    if (!readSamples(*cache, offset, SampleBuffer::Float32, record.frameCount * record.binCount, 1, result.frames)) {
+        return false;
+    }
+    result.frameCount = record.frameCount;
+    result.binCount = record.binCount;
+    result.duration = record.duration;
+    result.maxFrequency = record.maxFrequency;
+    out = result;
+    return true;
+}
+
+// Function to write the spectrogram of a recording in the background
+void SignalViewCache::storeSpectrogram(const QString &recordingPath, const QByteArray &key, const CachedSpectrogram &spectrogram) {
+    if (!recordingPath.isEmpty() && spectrogram.frames.size() == spectrogram.frameCount * spectrogram.binCount
+        && spectrogram.frames.type() == SampleBuffer::Float32 && !spectrogram.frames.isEmpty()) {
+        pool.start(new StoreTask(recordingPath, key, spectrogram));
+    }
+}
+
+// Function to wait for pending stores
+void SignalViewCache::waitForDone() {
+    pool.waitForDone();
+}
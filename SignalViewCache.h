@@ -0,0 +1,81 @@
+//
+// Persistent cache of the display data derived from recordings.
+//
+
+#ifndef SIGNALVIEWCACHE_H
+#define SIGNALVIEWCACHE_H
+
+#include <QByteArray>
+#include <QSharedPointer>
+#include <QString>
+#include <QThreadPool>
+#include <QVector>
+#include <functional>
+#include "MappedSignalFile.h"
+#include "SignalLoader.h"
+#include "SpectrogramEngine.h"
+
+// A spectrogram as stored in a view cache
+struct CachedSpectrogram {
+    int frameCount = 0;
+    int binCount = 0;
+    double duration = 0;
+    double maxFrequency = 0;
+    SampleBuffer frames;   // Float32 power values (dB), frame after frame
+};
+
+// SignalViewCache keeps what the widget derives from a recording in files next to it: pyramid
+// levels, selection indexes and statistics of every channel, and spectrogram frames. A cache
+// file starts with a fixed header (magic, format version, kind, key, size) followed by records
+// and arrays at 8-byte aligned offsets in host byte order, so a valid file is memory-mapped and
+// its arrays are used in place, paged in as the view touches them; reopening a long recording
+// costs a header check instead of a pass over all samples.
+//
+// The key is a SHA-256 over the processing parameters, the size and modification time of the
+// recording and a fingerprint of the content: type, length and scale of every channel plus
+// evenly spaced blocks of their bytes. A file whose key differs is ignored and replaced by the
+// next store. A summary also stores a hash of all samples, so verifySignal() can catch edits
+// the key cannot see, e.g. ones that keep the modification time; the check reads the whole
+// recording again, which is what the cache is there to avoid, so callers run it only on request.
+// Stores and checks run in order on one worker thread, and stores go through QSaveFile, so
+// readers never see a partly written file.
+class SignalViewCache {
+public:
+    SignalViewCache();
+    ~SignalViewCache();
+
+    // Cache files of a recording
+    static QString signalCachePath(const QString &recordingPath);
+    static QString spectrogramCachePath(const QString &recordingPath);
+
+    // Key of the spectrogram of samples read from a recording and computed with the given parameters;
+    // covers the size and modification time of the recording like the key of a summary
+    static QByteArray spectrogramKey(const QString &recordingPath, const QVector<double> &samples, double samplingRate,
+                                     const SpectrogramParameters &parameters);
+
+    // Read the summary of a mapped recording: one channel per channel of the file, with the
+    // statistics of all its samples, its pyramid and its selection index, all sharing the
+    // mapping of the cache file. Returns false if there is no valid cache for the recording.
+    static bool loadSignal(const QSharedPointer<MappedSignalFile> &file, PreparedSignal &out);
+
+    // Write the summary of a mapped recording in the background; buffers are shared, not copied
+    void storeSignal(const QSharedPointer<MappedSignalFile> &file, const PreparedSignal &summary);
+
+    // Hash all samples of a recording in the background and compare them with its cached
+    // summary; onStale is called on the receiver's thread if the summary was built from other contents
+    void verifySignal(const QSharedPointer<MappedSignalFile> &file, QObject *receiver, const std::function<void()> &onStale);
+
+    // Read or write the spectrogram cached for a recording under a key
+    static bool loadSpectrogram(const QString &recordingPath, const QByteArray &key, CachedSpectrogram &out);
+    void storeSpectrogram(const QString &recordingPath, const QByteArray &key, const CachedSpectrogram &spectrogram);
+
+    // Wait until pending stores are written
+    void waitForDone();
+
+private:
+    class StoreTask;
+
+    QThreadPool pool;   // One writer, stores are written in order
+};
+
+#endif // SIGNALVIEWCACHE_H
@@ -0,0 +1,261 @@
+//
+// Multithreaded short-time Fourier transform for spectrogram display.
+//
+
+#include "SpectrogramEngine.h"
+#include "RealFft.h"
+#include <QRunnable>
+#include <cmath>
+
+// Number of frames handed to one worker task
+static const int framesPerTask = 32;
+
+// Smallest power value before conversion to dB, avoids log(0)
+static const float powerFloor = 1e-12f;
+
+// State of one computation, shared between the engine and its worker tasks
+struct SpectrogramEngine::Job {
+    QVector<double> samples;           // Input, shared with the caller's buffer
+    double samplingRate = 1;
+    SpectrogramParameters parameters;
+    int fftSize = 0;
+    int frames = 0;
+    int bins = 0;
+    QVector<float> window;             // Analysis window coefficients
+    QVector<float> output;             // frames * bins power values in dB
+    float *outputData = nullptr;       // Detached pointer into output for the workers
+    QAtomicInt cancelled;
+    int pendingTasks = 0;              // Only touched on the GUI thread
+    bool finished = false;
+};
+
+// Worker computing a contiguous block of frames
+class SpectrogramEngine::FrameTask : public QRunnable {
+public:
+    FrameTask(SpectrogramEngine *engine, const QSharedPointer<Job> &job, int firstFrame, int count)
+            : engine(engine), job(job), firstFrame(firstFrame), count(count) {}
+
+    void run() override {
+        RealFft fft(job->fftSize);
+        float *out = job->outputData + static_cast<qint64>(firstFrame) * job->bins;
+        if (!computeSpectrogramFrames(fft, job->samples.constData(), job->samples.size(), job->window,
+                                      job->parameters.hopSize, firstFrame, count, job->bins, out, &job->cancelled)) {
+            return;
+        }
+
+        // Hand the finished block over to the GUI thread
+        SpectrogramEngine *target = engine;
+        QSharedPointer<Job> finishedJob = job;
+        int first = firstFrame;
+        int frames = count;
+        QMetaObject::invokeMethod(target, [target, finishedJob, first, frames]() {
+            target->onFramesComputed(finishedJob, first, frames);
+        }, Qt::QueuedConnection);
+    }
+
+private:
+    SpectrogramEngine *engine;
+    QSharedPointer<Job> job;
+    int firstFrame;
+    int count;
+};
+
+// Function to build the coefficients of an analysis window
+QVector<float> makeSpectrogramWindow(SpectrogramParameters::WindowType type, int length) {
+    QVector<float> window(length, 1.0f);
+    if (length < 2) {
+        return window;
+    }
+
+    const double twoPi = 2.0 * M_PI;
+    for (int i = 0; i < length; ++i) {
+        double phase = twoPi * i / (length - 1);
+        switch (type) {
+            case SpectrogramParameters::Hann:
+                window[i] = static_cast<float>(0.5 - 0.5 * std::cos(phase));
+                break;
+            case SpectrogramParameters::Hamming:
+                window[i] = static_cast<float>(0.54 - 0.46 * std::cos(phase));
+                break;
+            case SpectrogramParameters::Blackman:
+                window[i] = static_cast<float>(0.42 - 0.5 * std::cos(phase) + 0.08 * std::cos(2 * phase));
+                break;
+            case SpectrogramParameters::Rectangular:
+                break;
+        }
+    }
+    return window;
+}
+
+// Function to get the number of frames of a signal
+int spectrogramFrameCount(int sampleCount, int windowLength, int hopSize) {
+    if (sampleCount <= 0) {
+        return 0;
+    } else if (sampleCount < windowLength) {
+        return 1;
+    }
+    return 1 + (sampleCount - windowLength) / hopSize;
+}
+
+// Function to compute the power spectra of a block of frames
+bool computeSpectrogramFrames(RealFft &fft, const double *samples, int sampleCount, const QVector<float> &window,
+                              int hopSize, int firstFrame, int count, int bins, float *out,
+                              const QAtomicInt *cancelled, float *peak) {
+    QVector<float> frameBuffer(fft.size(), 0.0f);
+    QVector<float> power(fft.binCount());
+    const float *coefficients = window.constData();
+    int windowLength = qMin(window.size(), fft.size());
+    bins = qMin(bins, fft.binCount());
+    float largest = peak ? *peak : 0.0f;
+
+    for (int frame = firstFrame; frame < firstFrame + count; ++frame) {
+        if (cancelled && cancelled->loadRelaxed()) {
+            return false;
+        }
+
+        // Window the frame, samples past the end of the input stay zero
+        qint64 start = static_cast<qint64>(frame) * hopSize;
+        int available = static_cast<int>(qBound<qint64>(0, sampleCount - start, windowLength));
+        float *buffer = frameBuffer.data();
+        for (int i = 0; i < available; ++i) {
+            buffer[i] = static_cast<float>(samples[start + i]) * coefficients[i];
+        }
+        for (int i = available; i < windowLength; ++i) {
+            buffer[i] = 0.0f;
+        }
+
+        fft.powerSpectrum(buffer, power.data());
+
+        const float *values = power.constData();
+        for (int bin = 0; bin < bins; ++bin) {
+            float level = 10.0f * std::log10(values[bin] + powerFloor);
+            out[bin] = level;
+            largest = qMax(largest, level);
+        }
+        out += bins;
+    }
+
+    if (peak) {
+        *peak = largest;
+    }
+    return true;
+}
+
+// Constructor
+SpectrogramEngine::SpectrogramEngine(QObject *parent)
+        : QObject(parent) {
+}
+
+// Destructor, workers must not outlive the engine they report to
+SpectrogramEngine::~SpectrogramEngine() {
+    cancel();
+    pool.waitForDone();
+}
+
+// Function to start computing the spectrogram of the given samples
+void SpectrogramEngine::compute(const QVector<double> &samples, double samplingRate, const SpectrogramParameters &parameters) {
+    cancel();
+
+    QSharedPointer<Job> next(new Job);
+    next->samples = samples;
+    next->samplingRate = samplingRate > 0 ? samplingRate : 1;
+    next->parameters = parameters;
+    next->parameters.windowLength = qMax(2, parameters.windowLength);
+    next->parameters.hopSize = qMax(1, parameters.hopSize);
+    next->fftSize = RealFft::sizeFor(qMax(parameters.fftSize, next->parameters.windowLength));
+    next->window = makeSpectrogramWindow(parameters.windowType, next->parameters.windowLength);
+
+    // Frames start every hop samples
+    next->frames = spectrogramFrameCount(samples.size(), next->parameters.windowLength, next->parameters.hopSize);
+
+    // Only bins up to the requested maximum frequency are kept
+    double binWidth = next->samplingRate / next->fftSize;
+    int allBins = next->fftSize / 2 + 1;
+    next->bins = qBound(1, static_cast<int>(parameters.maxFrequency / binWidth) + 1, allBins);
+
+    next->output = QVector<float>(next->frames * next->bins, 10.0f * std::log10(powerFloor));
+    next->outputData = next->output.data();
+
+    job = next;
+    if (job->frames == 0) {
+        job->finished = true;
+        emit finished();
+        return;
+    }
+
+    for (int first = 0; first < job->frames; first += framesPerTask) {
+        int count = qMin(framesPerTask, job->frames - first);
+        ++job->pendingTasks;
+        pool.start(new FrameTask(this, job, first, count));
+    }
+}
+
+// Function to cancel the running computation
+void SpectrogramEngine::cancel() {
+    if (job) {
+        job->cancelled.storeRelaxed(1);
+    }
+}
+
+// Function to free the frames of a finished computation
+void SpectrogramEngine::releaseFrames() {
+    if (job && job->finished) {
+        job->output = QVector<float>();
+        job->outputData = nullptr;
+    }
+}
+
+// Function called on the GUI thread when a worker finished a block of frames
+void SpectrogramEngine::onFramesComputed(const QSharedPointer<Job> &finishedJob, int firstFrame, int count) {
+    // Results of a replaced computation are dropped
+    if (finishedJob != job || job->cancelled.loadRelaxed()) {
+        return;
+    }
+
+    emit framesReady(firstFrame, count);
+
+    if (--job->pendingTasks == 0) {
+        job->finished = true;
+        emit finished();
+    }
+}
+
+// Function to get the number of frames
+int SpectrogramEngine::frameCount() const {
+    return job ? job->frames : 0;
+}
+
+// Function to get the number of frequency bins per frame
+int SpectrogramEngine::binCount() const {
+    return job ? job->bins : 0;
+}
+
+// Function to get the time between frames
+double SpectrogramEngine::frameStep() const {
+    return job ? job->parameters.hopSize / job->samplingRate : 0;
+}
+
+// Function to get the frequency spacing of the bins
+double SpectrogramEngine::binStep() const {
+    return job ? job->samplingRate / job->fftSize : 0;
+}
+
+// Function to get the duration of the input
+double SpectrogramEngine::duration() const {
+    return job ? job->samples.size() / job->samplingRate : 0;
+}
+
+// Function to get the frequency of the last bin
+double SpectrogramEngine::maxFrequency() const {
+    return job ? (job->bins - 1) * binStep() : 0;
+}
+
+// Function to get the power values of one frame
+const float *SpectrogramEngine::frame(int index) const {
+    return job->output.constData() + static_cast<qint64>(index) * job->bins;
+}
+
+// Function to check whether all frames are available
+bool SpectrogramEngine::isFinished() const {
+    return job && job->finished;
+}
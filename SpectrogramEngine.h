@@ -0,0 +1,87 @@
+//
+// Multithreaded short-time Fourier transform for spectrogram display.
+//
+
+#ifndef SPECTROGRAMENGINE_H
+#define SPECTROGRAMENGINE_H
+
+#include <QAtomicInt>
+#include <QObject>
+#include <QSharedPointer>
+#include <QThreadPool>
+#include <QVector>
+
+// Parameters of the short-time Fourier transform
+struct SpectrogramParameters {
+    enum WindowType { Rectangular, Hann, Hamming, Blackman };
+
+    WindowType windowType = Hann;
+    int windowLength = 512;       // Samples per analysis window
+    int hopSize = 128;            // Samples between successive frames
+    int fftSize = 512;            // Transform size, rounded up to a power of two >= windowLength
+    double maxFrequency = 5000;   // Highest frequency kept in the result (Hz)
+};
+
+class RealFft;
+
+// Coefficients of the analysis window of the given type
+QVector<float> makeSpectrogramWindow(SpectrogramParameters::WindowType type, int length);
+
+// Number of frames of a signal; a short non-empty signal still yields one zero-padded frame
+int spectrogramFrameCount(int sampleCount, int windowLength, int hopSize);
+
+// Compute power (dB) of count frames starting at firstFrame, bins values per frame, into out.
+// Stops early and returns false once cancelled becomes non-zero; peak receives the largest value.
+bool computeSpectrogramFrames(RealFft &fft, const double *samples, int sampleCount, const QVector<float> &window,
+                              int hopSize, int firstFrame, int count, int bins, float *out,
+                              const QAtomicInt *cancelled = nullptr, float *peak = nullptr);
+
+// SpectrogramEngine computes an STFT on a worker pool and reports frames as they complete.
+// Results are stored frame after frame in one contiguous buffer of power values in dB.
+class SpectrogramEngine : public QObject {
+    Q_OBJECT
+
+public:
+    explicit SpectrogramEngine(QObject *parent = nullptr);
+    ~SpectrogramEngine();
+
+    // Start a new computation and return immediately; a running one is cancelled
+    void compute(const QVector<double> &samples, double samplingRate, const SpectrogramParameters &parameters);
+
+    // Stop the running computation, frames already reported stay valid
+    void cancel();
+
+    // Free the frame buffer of a finished computation; geometry queries stay valid, frame() does not
+    void releaseFrames();
+
+    // Geometry of the current result
+    int frameCount() const;
+    int binCount() const;
+    double frameStep() const;      // Seconds between frames
+    double binStep() const;        // Hz between bins
+    double duration() const;       // Seconds covered by the input
+    double maxFrequency() const;   // Frequency of the last bin
+
+    // Power values (dB) of one frame, binCount() entries; valid once the frame was reported
+    const float *frame(int index) const;
+
+    bool isFinished() const;
+
+signals:
+    // Emitted on the GUI thread whenever a block of frames is complete
+    void framesReady(int firstFrame, int count);
+    // Emitted once all frames of the current computation are complete
+    void finished();
+
+private:
+    struct Job;
+    class FrameTask;
+
+    // Function called on the GUI thread for every completed block
+    void onFramesComputed(const QSharedPointer<Job> &finishedJob, int firstFrame, int count);
+
+    QSharedPointer<Job> job;   // Current computation, shared with its worker tasks
+    QThreadPool pool;          // Workers owned by this engine
+};
+
+#endif // SPECTROGRAMENGINE_H
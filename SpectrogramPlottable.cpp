@@ -0,0 +1,223 @@
+//
+// QCustomPlot plottable drawing a quantized spectrogram at screen resolution.
+//
+
+#include "SpectrogramPlottable.h"
+
+// Constructor
+SpectrogramPlottable::SpectrogramPlottable(QCPAxis *keyAxis, QCPAxis *valueAxis)
+        : QCPAbstractPlottable(keyAxis, valueAxis), dataRange(0, 1), imageRevision(-1),
+          lookupRevision(0), imageLookupRevision(-1) {
+    gradient = QCPColorGradient(QCPColorGradient::gpGrayscale);
+}
+
+// Function to set the raster and the area it covers
+void SpectrogramPlottable::setRaster(const QSharedPointer<SpectrogramRaster> &raster, const QCPRange &keyRange, const QCPRange &valueRange) {
+    cells = raster;
+    this->keyRange = keyRange;
+    this->valueRange = valueRange;
+    imageRevision = -1;
+    updateLookupTable();
+}
+
+// Function to get the raster
+QSharedPointer<SpectrogramRaster> SpectrogramPlottable::raster() const {
+    return cells;
+}
+
+// Function to draw from a tile cache
+void SpectrogramPlottable::setTileCache(SpectrogramTileCache *cache, const QCPRange &keyRange, const QCPRange &valueRange) {
+    cells.reset();
+    tileCache = cache;
+    tileImages.clear();
+    this->keyRange = keyRange;
+    this->valueRange = valueRange;
+    updateLookupTable();
+}
+
+// Function to set the color gradient
+void SpectrogramPlottable::setGradient(const QCPColorGradient &gradient) {
+    this->gradient = gradient;
+    updateLookupTable();
+}
+
+// Function to set the value range mapped onto the gradient
+void SpectrogramPlottable::setDataRange(const QCPRange &dataRange) {
+    this->dataRange = dataRange;
+    updateLookupTable();
+}
+
+// Function to precompute the color of every quantization level
+void SpectrogramPlottable::updateLookupTable() {
+    if (!cells && !tileCache) {
+        return;
+    }
+
+    int levels = cells ? cells->levelCount() : tileCache->quantizationLevelCount();
+    QVector<double> levelValues(levels);
+    for (int level = 0; level < levels; ++level) {
+        levelValues[level] = cells ? cells->levelValue(level) : tileCache->quantizationLevelValue(level);
+    }
+    lookupTable.resize(levels);
+    gradient.colorize(levelValues.constData(), dataRange, lookupTable.data(), levels);
+    ++lookupRevision;
+}
+
+// Function to test for selection, the spectrogram is not selectable
+double SpectrogramPlottable::selectTest(const QPointF &pos, bool onlySelectable, QVariant *details) const {
+    Q_UNUSED(pos);
+    Q_UNUSED(onlySelectable);
+    Q_UNUSED(details);
+    return -1;
+}
+
+// Function to get the time range covered by the raster
+QCPRange SpectrogramPlottable::getKeyRange(bool &foundRange, QCP::SignDomain inSignDomain) const {
+    Q_UNUSED(inSignDomain);
+    foundRange = !cells.isNull() || !tileCache.isNull();
+    return keyRange;
+}
+
+// Function to get the frequency range covered by the raster
+QCPRange SpectrogramPlottable::getValueRange(bool &foundRange, QCP::SignDomain inSignDomain, const QCPRange &inKeyRange) const {
+    Q_UNUSED(inSignDomain);
+    Q_UNUSED(inKeyRange);
+    foundRange = !cells.isNull() || !tileCache.isNull();
+    return valueRange;
+}
+
+// Function to get the pixel rectangle of a key/value window
+QRect SpectrogramPlottable::targetRectFor(const QCPRange &keys, const QCPRange &values) const {
+    QCPAxis *keyAxis = mKeyAxis.data();
+    QCPAxis *valueAxis = mValueAxis.data();
+    QRect rect = QRectF(QPointF(keyAxis->coordToPixel(keys.lower), valueAxis->coordToPixel(values.upper)),
+                        QPointF(keyAxis->coordToPixel(keys.upper), valueAxis->coordToPixel(values.lower)))
+                         .normalized().toAlignedRect();
+    return rect.intersected(clipRect());
+}
+
+// Function to draw the visible part of the raster
+void SpectrogramPlottable::draw(QCPPainter *painter) {
+    QCPAxis *keyAxis = mKeyAxis.data();
+    QCPAxis *valueAxis = mValueAxis.data();
+    if (!keyAxis || !valueAxis || keyRange.size() <= 0 || valueRange.size() <= 0) {
+        return;
+    }
+
+    // Visible part of the covered area
+    QCPRange visibleKeys(qMax(keyAxis->range().lower, keyRange.lower), qMin(keyAxis->range().upper, keyRange.upper));
+    QCPRange visibleValues(qMax(valueAxis->range().lower, valueRange.lower), qMin(valueAxis->range().upper, valueRange.upper));
+    if (visibleKeys.size() <= 0 || visibleValues.size() <= 0) {
+        return;
+    }
+
+    if (tileCache) {
+        drawTiles(painter, visibleKeys, visibleValues);
+        return;
+    }
+    if (!cells || cells->frameCount() == 0) {
+        return;
+    }
+
+    QRect targetRect = targetRectFor(visibleKeys, visibleValues);
+    if (targetRect.isEmpty()) {
+        return;
+    }
+
+    // Rasterize again only if the window, the size, the data or the colors changed
+    bool imageValid = image.size() == targetRect.size()
+                      && imageRevision == cells->revision()
+                      && imageLookupRevision == lookupRevision
+                      && imageKeyRange == visibleKeys
+                      && imageValueRange == visibleValues;
+    if (!imageValid) {
+        if (image.size() != targetRect.size()) {
+            image = QImage(targetRect.size(), QImage::Format_ARGB32_Premultiplied);
+        }
+
+        double framesPerKey = cells->frameCount() / keyRange.size();
+        double binsPerValue = cells->binCount() / valueRange.size();
+        cells->render(image,
+                      (visibleKeys.lower - keyRange.lower) * framesPerKey,
+                      (visibleKeys.upper - keyRange.lower) * framesPerKey,
+                      (visibleValues.lower - valueRange.lower) * binsPerValue,
+                      (visibleValues.upper - valueRange.lower) * binsPerValue,
+                      lookupTable.constData());
+
+        imageRevision = cells->revision();
+        imageLookupRevision = lookupRevision;
+        imageKeyRange = visibleKeys;
+        imageValueRange = visibleValues;
+    }
+
+    applyDefaultAntialiasingHint(painter);
+    painter->drawImage(targetRect, image);
+}
+
+// Function to draw the cached tiles of the visible window, coarse tiles first so finer ones cover them
+void SpectrogramPlottable::drawTiles(QCPPainter *painter, const QCPRange &visibleKeys, const QCPRange &visibleValues) {
+    QRect visibleRect = targetRectFor(visibleKeys, visibleValues);
+    if (visibleRect.isEmpty()) {
+        return;
+    }
+
+    double secondsPerPixel = visibleKeys.size() / visibleRect.width();
+    QVector<SpectrogramTile> tiles = tileCache->tilesFor(visibleKeys.lower, visibleKeys.upper, secondsPerPixel);
+    double binsPerValue = tileCache->binCount() / valueRange.size();
+
+    applyDefaultAntialiasingHint(painter);
+    QCPAxis *keyAxis = mKeyAxis.data();
+    QVector<TileImage> drawnImages;
+    for (const SpectrogramTile &tile : tiles) {
+        QCPRange tileKeys(qMax(tile.startTime, visibleKeys.lower), qMin(tile.endTime, visibleKeys.upper));
+        if (tileKeys.size() <= 0 || tile.endTime <= tile.startTime) {
+            continue;
+        }
+        QRect tileRect = targetRectFor(tileKeys, visibleValues);
+        if (tileRect.isEmpty()) {
+            continue;
+        }
+
+        // The whole tile is rasterized once for its scale, so a pan only moves the image
+        double left = keyAxis->coordToPixel(tile.startTime);
+        double right = keyAxis->coordToPixel(tile.endTime);
+        QSize size(qBound(1, qRound(qAbs(right - left)), maxTileImageWidth), visibleRect.height());
+        TileImage cached;
+        for (const TileImage &entry : tileImages) {
+            if (entry.raster == tile.raster && entry.revision == tile.raster->revision() && entry.lookupRevision == lookupRevision
+                && entry.values == visibleValues && entry.image.size() == size) {
+                cached = entry;
+                break;
+            }
+        }
+        if (cached.image.isNull()) {
+            cached.raster = tile.raster;
+            cached.revision = tile.raster->revision();
+            cached.lookupRevision = lookupRevision;
+            cached.values = visibleValues;
+            cached.image = QImage(size, QImage::Format_ARGB32_Premultiplied);
+            tile.raster->render(cached.image, 0, tile.raster->frameCount(),
+                                (visibleValues.lower - valueRange.lower) * binsPerValue,
+                                (visibleValues.upper - valueRange.lower) * binsPerValue,
+                                lookupTable.constData());
+        }
+
+        painter->save();
+        painter->setClipRect(tileRect, Qt::IntersectClip);
+        painter->drawImage(QRectF(QPointF(qMin(left, right), visibleRect.top()), QSizeF(qAbs(right - left), visibleRect.height())),
+                           cached.image);
+        painter->restore();
+        drawnImages.append(cached);
+    }
+
+    // Tiles that left the view release their images
+    tileImages = drawnImages;
+}
+
+// Function to draw the legend icon as a small gradient swatch
+void SpectrogramPlottable::drawLegendIcon(QCPPainter *painter, const QRectF &rect) const {
+    QLinearGradient swatch(rect.topLeft(), rect.topRight());
+    swatch.setColorAt(0, QColor(gradient.color(dataRange.lower, dataRange)));
+    swatch.setColorAt(1, QColor(gradient.color(dataRange.upper, dataRange)));
+    painter->fillRect(rect, swatch);
+}
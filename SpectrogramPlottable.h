@@ -0,0 +1,75 @@
+//
+// QCustomPlot plottable drawing a quantized spectrogram at screen resolution.
+//
+
+#ifndef SPECTROGRAMPLOTTABLE_H
+#define SPECTROGRAMPLOTTABLE_H
+
+#include "qcustomplot.h"
+#include "SpectrogramRaster.h"
+#include "SpectrogramTileCache.h"
+#include <QPointer>
+#include <QSharedPointer>
+
+// SpectrogramPlottable rasterizes only the visible time/frequency window of a SpectrogramRaster,
+// one pixel per screen pixel, through a color lookup table built from the gradient and data range.
+class SpectrogramPlottable : public QCPAbstractPlottable {
+    Q_OBJECT
+
+public:
+    SpectrogramPlottable(QCPAxis *keyAxis, QCPAxis *valueAxis);
+
+    // Raster shown by the plottable and the key (time) and value (frequency) ranges it covers
+    void setRaster(const QSharedPointer<SpectrogramRaster> &raster, const QCPRange &keyRange, const QCPRange &valueRange);
+    QSharedPointer<SpectrogramRaster> raster() const;
+
+    // Draw zoom-dependent tiles from a cache instead of a single raster
+    void setTileCache(SpectrogramTileCache *cache, const QCPRange &keyRange, const QCPRange &valueRange);
+
+    // Color mapping, both rebuild the lookup table
+    void setGradient(const QCPColorGradient &gradient);
+    void setDataRange(const QCPRange &dataRange);
+
+    // QCPAbstractPlottable interface
+    double selectTest(const QPointF &pos, bool onlySelectable, QVariant *details = nullptr) const override;
+    QCPRange getKeyRange(bool &foundRange, QCP::SignDomain inSignDomain = QCP::sdBoth) const override;
+    QCPRange getValueRange(bool &foundRange, QCP::SignDomain inSignDomain = QCP::sdBoth, const QCPRange &inKeyRange = QCPRange()) const override;
+
+protected:
+    void draw(QCPPainter *painter) override;
+    void drawLegendIcon(QCPPainter *painter, const QRectF &rect) const override;
+
+private:
+    void updateLookupTable();
+    QRect targetRectFor(const QCPRange &keys, const QCPRange &values) const;
+    void drawTiles(QCPPainter *painter, const QCPRange &visibleKeys, const QCPRange &visibleValues);
+
+    QSharedPointer<SpectrogramRaster> cells;
+    QPointer<SpectrogramTileCache> tileCache;
+    QCPRange keyRange;
+    QCPRange valueRange;
+    QCPColorGradient gradient;
+    QCPRange dataRange;
+    QVector<QRgb> lookupTable;   // One color per quantization level
+
+    // Image of the last drawn window, reused while nothing changed
+    QImage image;
+    QCPRange imageKeyRange;
+    QCPRange imageValueRange;
+    int imageRevision;
+    int lookupRevision;
+    int imageLookupRevision;
+
+    // Whole tiles rasterized at their current scale, reused while a pan keeps scale and colors
+    struct TileImage {
+        QSharedPointer<SpectrogramRaster> raster;   // Held, so no other tile can take its address
+        int revision = -1;
+        int lookupRevision = -1;
+        QCPRange values;
+        QImage image;
+    };
+    QVector<TileImage> tileImages;   // Tiles of the last frame
+    static const int maxTileImageWidth = 4096;   // Wider tiles are stretched from an image this wide
+};
+
+#endif // SPECTROGRAMPLOTTABLE_H
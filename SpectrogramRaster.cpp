@@ -0,0 +1,141 @@
+//
+// Quantized spectrogram storage with a lookup-table raster kernel.
+//
+
+#include "SpectrogramRaster.h"
+#include <algorithm>
+
+// Function to convert a row of values into levels, written with a fixed stride
+template <typename T, typename Level>
+static void quantizeRow(const T *values, int count, Level *out, int stride, double minValue, double scale, double maxLevel) {
+    for (int i = 0; i < count; ++i) {
+        double level = (static_cast<double>(values[i]) - minValue) * scale;
+        level = level < 0 ? 0 : (level > maxLevel ? maxLevel : level);
+        out[static_cast<qint64>(i) * stride] = static_cast<Level>(level + 0.5);
+    }
+}
+
+// Function to map one screen row through the lookup table; a straight gather loop that vectorizes
+template <typename Level>
+static void renderRow(const Level *row, const int *columnFrames, QRgb *line, int width, const QRgb *lut) {
+    for (int x = 0; x < width; ++x) {
+        line[x] = lut[row[columnFrames[x]]];
+    }
+}
+
+// Constructor
+SpectrogramRaster::SpectrogramRaster(int frames, int bins, Depth depth, double minValue, double maxValue)
+        : frames(qMax(0, frames)), bins(qMax(0, bins)), cellDepth(depth),
+          minValue(minValue), maxValue(maxValue > minValue ? maxValue : minValue + 1), changeCount(0) {
+    qint64 cellCount = static_cast<qint64>(this->frames) * this->bins;
+    if (cellDepth == Depth8) {
+        cells8 = QVector<quint8>(cellCount, 0);
+    } else {
+        cells16 = QVector<quint16>(cellCount, 0);
+    }
+}
+
+// Function to get the number of frames
+int SpectrogramRaster::frameCount() const {
+    return frames;
+}
+
+// Function to get the number of bins
+int SpectrogramRaster::binCount() const {
+    return bins;
+}
+
+// Function to get the storage depth
+SpectrogramRaster::Depth SpectrogramRaster::depth() const {
+    return cellDepth;
+}
+
+// Function to get the number of quantization levels
+int SpectrogramRaster::levelCount() const {
+    return levelCount(cellDepth);
+}
+
+// Function to get the value represented by a level
+double SpectrogramRaster::levelValue(int level) const {
+    return levelValue(cellDepth, minValue, maxValue, level);
+}
+
+// Function to get the number of quantization levels of a depth
+int SpectrogramRaster::levelCount(Depth depth) {
+    return depth == Depth8 ? 256 : 65536;
+}
+
+// Function to get the value represented by a level for a given depth and value range
+double SpectrogramRaster::levelValue(Depth depth, double minValue, double maxValue, int level) {
+    return minValue + (maxValue - minValue) * level / (levelCount(depth) - 1);
+}
+
+// Function to quantize frames of float values
+void SpectrogramRaster::setFrames(int firstFrame, int count, const float *values) {
+    quantizeFrames(firstFrame, count, values);
+}
+
+// Function to quantize frames of double values
+void SpectrogramRaster::setFrames(int firstFrame, int count, const double *values) {
+    quantizeFrames(firstFrame, count, values);
+}
+
+// Function to quantize a single frame
+void SpectrogramRaster::setFrame(int frame, const double *values) {
+    quantizeFrames(frame, 1, values);
+}
+
+// Function to quantize frames into the bin-major cell buffer
+template <typename T>
+void SpectrogramRaster::quantizeFrames(int firstFrame, int count, const T *values) {
+    count = qMin(count, frames - firstFrame);
+    if (firstFrame < 0 || count <= 0) {
+        return;
+    }
+
+    double maxLevel = levelCount() - 1;
+    double scale = maxLevel / (maxValue - minValue);
+    for (int frame = firstFrame; frame < firstFrame + count; ++frame) {
+        const T *frameValues = values + static_cast<qint64>(frame - firstFrame) * bins;
+        if (cellDepth == Depth8) {
+            quantizeRow(frameValues, bins, cells8.data() + frame, frames, minValue, scale, maxLevel);
+        } else {
+            quantizeRow(frameValues, bins, cells16.data() + frame, frames, minValue, scale, maxLevel);
+        }
+    }
+    ++changeCount;
+}
+
+// Function to get the change counter
+int SpectrogramRaster::revision() const {
+    return changeCount;
+}
+
+// Function to rasterize a frame/bin window into an image of screen resolution
+void SpectrogramRaster::render(QImage &image, double frameBegin, double frameEnd, double binBegin, double binEnd, const QRgb *lut) const {
+    int width = image.width();
+    int height = image.height();
+    if (width <= 0 || height <= 0 || frames == 0 || bins == 0) {
+        return;
+    }
+
+    // Nearest frame for every pixel column, computed once per image
+    QVector<int> columnFrames(width);
+    double frameScale = (frameEnd - frameBegin) / width;
+    for (int x = 0; x < width; ++x) {
+        columnFrames[x] = qBound(0, static_cast<int>(frameBegin + (x + 0.5) * frameScale), frames - 1);
+    }
+
+    // Each pixel row reads one contiguous bin row of the cell buffer
+    double binScale = (binEnd - binBegin) / height;
+    for (int y = 0; y < height; ++y) {
+        int bin = qBound(0, static_cast<int>(binEnd - (y + 0.5) * binScale), bins - 1);
+        QRgb *line = reinterpret_cast<QRgb *>(image.scanLine(y));
+        qint64 rowStart = static_cast<qint64>(bin) * frames;
+        if (cellDepth == Depth8) {
+            renderRow(cells8.constData() + rowStart, columnFrames.constData(), line, width, lut);
+        } else {
+            renderRow(cells16.constData() + rowStart, columnFrames.constData(), line, width, lut);
+        }
+    }
+}
@@ -0,0 +1,58 @@
+//
+// Quantized spectrogram storage with a lookup-table raster kernel.
+//
+
+#ifndef SPECTROGRAMRASTER_H
+#define SPECTROGRAMRASTER_H
+
+#include <QImage>
+#include <QVector>
+
+// SpectrogramRaster keeps spectrogram magnitudes as 8- or 16-bit levels in one contiguous,
+// bin-major buffer (all frames of bin 0, then bin 1, ...), so screen rows read linearly.
+// Values are mapped linearly from [minValue, maxValue] onto the available levels.
+class SpectrogramRaster {
+public:
+    enum Depth { Depth8, Depth16 };
+
+    SpectrogramRaster(int frames, int bins, Depth depth, double minValue, double maxValue);
+
+    int frameCount() const;
+    int binCount() const;
+    Depth depth() const;
+
+    // Number of quantization levels (256 or 65536) and the value each level stands for
+    int levelCount() const;
+    double levelValue(int level) const;
+    static int levelCount(Depth depth);
+    static double levelValue(Depth depth, double minValue, double maxValue, int level);
+
+    // Quantize frames given frame after frame, binCount() values each
+    void setFrames(int firstFrame, int count, const float *values);
+    void setFrames(int firstFrame, int count, const double *values);
+
+    // Quantize a single frame
+    void setFrame(int frame, const double *values);
+
+    // Counter increased on every change, used to invalidate cached images
+    int revision() const;
+
+    // Fill the image with the frame range [frameBegin, frameEnd) and bin range [binBegin, binEnd),
+    // lowest bin at the bottom; colors come from lut, which has levelCount() entries
+    void render(QImage &image, double frameBegin, double frameEnd, double binBegin, double binEnd, const QRgb *lut) const;
+
+private:
+    template <typename T>
+    void quantizeFrames(int firstFrame, int count, const T *values);
+
+    int frames;
+    int bins;
+    Depth cellDepth;
+    double minValue;
+    double maxValue;
+    int changeCount;
+    QVector<quint8> cells8;     // Used for Depth8
+    QVector<quint16> cells16;   // Used for Depth16
+};
+
+#endif // SPECTROGRAMRASTER_H
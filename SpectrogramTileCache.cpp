@@ -0,0 +1,336 @@
+//
+// Zoom-aware tile cache for spectrograms with background refinement.
+//
+
+#include "SpectrogramTileCache.h"
+#include "RealFft.h"
+#include <QRunnable>
+#include <cmath>
+#include <limits>
+
+// Frames per tile at every zoom level
+static const int framesPerTile = 256;
+
+// Function to hash a tile key
+uint qHash(const SpectrogramTileKey &key, uint seed) {
+    quint64 mixed = key.parametersHash ^ (static_cast<quint64>(key.level) << 56) ^ static_cast<quint64>(key.index);
+    return static_cast<uint>((mixed ^ (mixed >> 32)) ^ seed);
+}
+
+// Worker computing and quantizing one tile
+class SpectrogramTileCache::TileTask : public QRunnable {
+public:
+    TileTask(SpectrogramTileCache *cache, const SpectrogramTileKey &key, const SpectrogramTile &tile,
+             const QVector<double> &samples, const QVector<float> &window, int fftSize, int hopSize,
+             int firstFrame, int frameCount, int bins, double minValue, double maxValue,
+             const QSharedPointer<WantedTiles> &wanted)
+            : cache(cache), key(key), tile(tile), samples(samples), window(window), fftSize(fftSize),
+              hopSize(hopSize), firstFrame(firstFrame), frameCount(frameCount), bins(bins),
+              minValue(minValue), maxValue(maxValue), wanted(wanted) {}
+
+    void run() override {
+        // Tiles the view moved away from while they were queued are not computed
+        bool stillWanted;
+        {
+            QMutexLocker locker(&wanted->mutex);
+            stillWanted = wanted->keys.contains(key);
+        }
+
+        if (stillWanted) {
+            RealFft fft(fftSize);
+            QVector<float> frames(frameCount * bins);
+            float peak = std::numeric_limits<float>::lowest();
+            computeSpectrogramFrames(fft, samples.constData(), samples.size(), window, hopSize,
+                                     firstFrame, frameCount, bins, frames.data(), nullptr, &peak);
+
+            SpectrogramRaster::Depth depth = tile.raster->depth();
+            tile.raster.reset(new SpectrogramRaster(frameCount, bins, depth, minValue, maxValue));
+            tile.raster->setFrames(0, frameCount, frames.constData());
+            tile.peak = peak;
+        }
+
+        SpectrogramTileCache *target = cache;
+        SpectrogramTileKey finishedKey = key;
+        SpectrogramTile finishedTile = tile;
+        QMetaObject::invokeMethod(target, [target, finishedKey, finishedTile, stillWanted]() {
+            target->onTileComputed(finishedKey, finishedTile, stillWanted);
+        }, Qt::QueuedConnection);
+    }
+
+private:
+    SpectrogramTileCache *cache;
+    SpectrogramTileKey key;
+    SpectrogramTile tile;
+    QVector<double> samples;
+    QVector<float> window;
+    int fftSize;
+    int hopSize;
+    int firstFrame;
+    int frameCount;
+    int bins;
+    double minValue;
+    double maxValue;
+    QSharedPointer<WantedTiles> wanted;
+};
+
+// Constructor
+SpectrogramTileCache::SpectrogramTileCache(QObject *parent)
+        : QObject(parent), samplingRate(1), fftSize(0), bins(0), sourceGeneration(0), parametersHash(0),
+          cellDepth(SpectrogramRaster::Depth8), minValue(-120), maxValue(160),
+          largestPeak(std::numeric_limits<float>::lowest()), wanted(new WantedTiles) {
+    setMemoryBudget(256ll * 1024 * 1024);
+}
+
+// Destructor, workers must not outlive the cache they report to
+SpectrogramTileCache::~SpectrogramTileCache() {
+    pool.clear();
+    pool.waitForDone();
+}
+
+// Function to set the signal and STFT parameters
+void SpectrogramTileCache::setSource(const QVector<double> &samples, double samplingRate, const SpectrogramParameters &parameters) {
+    // The cache holds a reference to its source, so a buffer sharing its data has the same
+    // content; any other buffer may sit at a freed address of an earlier source, so its tiles
+    // must never match older ones
+    if (samples.constData() != this->samples.constData() || samples.size() != this->samples.size()) {
+        ++sourceGeneration;
+    }
+    this->samples = samples;
+    this->samplingRate = samplingRate > 0 ? samplingRate : 1;
+    this->parameters = parameters;
+    this->parameters.windowLength = qMax(2, parameters.windowLength);
+    this->parameters.hopSize = qMax(1, parameters.hopSize);
+    fftSize = RealFft::sizeFor(qMax(parameters.fftSize, this->parameters.windowLength));
+    window = makeSpectrogramWindow(parameters.windowType, this->parameters.windowLength);
+
+    double binWidth = this->samplingRate / fftSize;
+    bins = qBound(1, static_cast<int>(parameters.maxFrequency / binWidth) + 1, fftSize / 2 + 1);
+
+    // The hash keys the tiles by source generation and every parameter that changes their content
+    const quint64 fields[] = {
+        sourceGeneration,
+        static_cast<quint64>(samples.size()),
+        static_cast<quint64>(std::llround(this->samplingRate * 1000)),
+        static_cast<quint64>(this->parameters.windowType),
+        static_cast<quint64>(this->parameters.windowLength),
+        static_cast<quint64>(this->parameters.hopSize),
+        static_cast<quint64>(fftSize),
+        static_cast<quint64>(bins),
+        static_cast<quint64>(cellDepth),
+    };
+    quint64 hash = 1469598103934665603ull;
+    for (quint64 field : fields) {
+        hash = (hash ^ field) * 1099511628211ull;
+    }
+    parametersHash = hash;
+
+    largestPeak = std::numeric_limits<float>::lowest();
+    pool.clear();
+    pending.clear();
+    QMutexLocker locker(&wanted->mutex);
+    wanted->keys.clear();
+}
+
+// Function to set the quantization of new tiles
+void SpectrogramTileCache::setQuantization(SpectrogramRaster::Depth depth, double minValue, double maxValue) {
+    if (depth == cellDepth && minValue == this->minValue && maxValue == this->maxValue) {
+        return;   // Keep tiles of an unchanged quantization for the next source with the same hash
+    }
+    cellDepth = depth;
+    this->minValue = minValue;
+    this->maxValue = maxValue;
+    tiles.clear();
+}
+
+// Function to get the quantization depth
+SpectrogramRaster::Depth SpectrogramTileCache::depth() const {
+    return cellDepth;
+}
+
+// Function to get the number of quantization levels
+int SpectrogramTileCache::quantizationLevelCount() const {
+    return SpectrogramRaster::levelCount(cellDepth);
+}
+
+// Function to get the value represented by a quantization level
+double SpectrogramTileCache::quantizationLevelValue(int level) const {
+    return SpectrogramRaster::levelValue(cellDepth, minValue, maxValue, level);
+}
+
+// Function to set the memory budget of the cache
+void SpectrogramTileCache::setMemoryBudget(qint64 bytes) {
+    tiles.setMaxCost(static_cast<int>(qBound<qint64>(1, bytes / 1024, std::numeric_limits<int>::max())));
+}
+
+// Function to get the number of zoom levels
+int SpectrogramTileCache::zoomLevelCount() const {
+    int levels = 1;
+    while ((parameters.hopSize >> levels) >= 1) {
+        ++levels;
+    }
+    return levels;
+}
+
+// Function to get the number of frequency bins
+int SpectrogramTileCache::binCount() const {
+    return bins;
+}
+
+// Function to get the duration of the source
+double SpectrogramTileCache::duration() const {
+    return samples.size() / samplingRate;
+}
+
+// Function to get the frequency of the last bin
+double SpectrogramTileCache::maxFrequency() const {
+    return fftSize > 0 ? (bins - 1) * samplingRate / fftSize : 0;
+}
+
+// Function to get the hop size of a zoom level
+int SpectrogramTileCache::hopSize(int level) const {
+    return qMax(1, parameters.hopSize >> level);
+}
+
+// Function to get the time span of one tile at a zoom level
+double SpectrogramTileCache::tileDuration(int level) const {
+    return static_cast<double>(framesPerTile) * hopSize(level) / samplingRate;
+}
+
+// Function to get the number of tiles at a zoom level
+int SpectrogramTileCache::tileCount(int level) const {
+    int frames = spectrogramFrameCount(samples.size(), parameters.windowLength, hopSize(level));
+    return (frames + framesPerTile - 1) / framesPerTile;
+}
+
+// Function to build the cache key of a tile
+SpectrogramTileKey SpectrogramTileCache::keyFor(int level, int index) const {
+    SpectrogramTileKey key;
+    key.level = level;
+    key.index = index;
+    key.parametersHash = parametersHash;
+    return key;
+}
+
+// Function to pick the zoom level for a given screen resolution
+int SpectrogramTileCache::levelFor(double secondsPerPixel) const {
+    int level = 0;
+    int levels = zoomLevelCount();
+    while (level + 1 < levels && hopSize(level) / samplingRate > secondsPerPixel) {
+        ++level;
+    }
+    return level;
+}
+
+// Function to collect the tiles to draw for a time range
+QVector<SpectrogramTile> SpectrogramTileCache::tilesFor(double startTime, double endTime, double secondsPerPixel) {
+    QVector<SpectrogramTile> result;
+    if (samples.isEmpty() || endTime <= startTime) {
+        return result;
+    }
+
+    int target = levelFor(secondsPerPixel);
+    QSet<SpectrogramTileKey> needed;
+
+    for (int level = 0; level <= target; ++level) {
+        // Cells are centered on their frames, so tiles start half a hop before the first window center
+        double origin = (parameters.windowLength / 2.0 - hopSize(level) / 2.0) / samplingRate;
+        double span = tileDuration(level);
+        int first = qMax(0, static_cast<int>(std::floor((startTime - origin) / span)));
+        int last = qMin(tileCount(level) - 1, static_cast<int>(std::floor((endTime - origin) / span)));
+
+        for (int index = first; index <= last; ++index) {
+            SpectrogramTileKey key = keyFor(level, index);
+            if (SpectrogramTile *tile = tiles.object(key)) {
+                result.append(*tile);
+            } else if (level == target) {
+                needed.insert(key);
+                requestTile(level, index);
+            }
+        }
+    }
+
+    // Queued tiles outside the new view are skipped by the workers
+    QMutexLocker locker(&wanted->mutex);
+    for (auto it = wanted->keys.begin(); it != wanted->keys.end();) {
+        if (it->level == 0) {
+            ++it;   // Prefetched overview tiles stay wanted
+        } else if (!needed.contains(*it)) {
+            it = wanted->keys.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    wanted->keys.unite(needed);
+    return result;
+}
+
+// Function to request every tile of a zoom level
+void SpectrogramTileCache::prefetchLevel(int level) {
+    int count = tileCount(level);
+    {
+        QMutexLocker locker(&wanted->mutex);
+        for (int index = 0; index < count; ++index) {
+            wanted->keys.insert(keyFor(level, index));
+        }
+    }
+    for (int index = 0; index < count; ++index) {
+        requestTile(level, index);
+    }
+}
+
+// Function to get the largest power seen so far
+float SpectrogramTileCache::peak() const {
+    return largestPeak;
+}
+
+// Function to queue the computation of a tile unless it is cached or already queued
+void SpectrogramTileCache::requestTile(int level, int index) {
+    SpectrogramTileKey key = keyFor(level, index);
+    if (pending.contains(key) || tiles.contains(key)) {
+        return;
+    }
+    pending.insert(key);
+
+    int hop = hopSize(level);
+    int frames = spectrogramFrameCount(samples.size(), parameters.windowLength, hop);
+    int firstFrame = index * framesPerTile;
+    int frameCount = qMin(framesPerTile, frames - firstFrame);
+
+    SpectrogramTile tile;
+    tile.level = level;
+    tile.startTime = (static_cast<double>(firstFrame) * hop + parameters.windowLength / 2.0 - hop / 2.0) / samplingRate;
+    tile.endTime = tile.startTime + static_cast<double>(frameCount) * hop / samplingRate;
+    tile.raster.reset(new SpectrogramRaster(0, 0, cellDepth, minValue, maxValue));
+
+    // Coarse levels first, so the overview fills in before the detail
+    pool.start(new TileTask(this, key, tile, samples, window, fftSize, hop, firstFrame, frameCount, bins,
+                            minValue, maxValue, wanted), -level);
+}
+
+// Function called on the GUI thread when a worker finished or skipped a tile
+void SpectrogramTileCache::onTileComputed(const SpectrogramTileKey &key, const SpectrogramTile &tile, bool computed) {
+    pending.remove(key);
+    if (key.parametersHash != parametersHash) {
+        return;   // Result of a previous source
+    }
+
+    if (!computed) {
+        // Skipped while queued; ask again if the view came back to it in the meantime
+        bool neededAgain;
+        {
+            QMutexLocker locker(&wanted->mutex);
+            neededAgain = wanted->keys.contains(key);
+        }
+        if (neededAgain) {
+            requestTile(key.level, key.index);
+        }
+        return;
+    }
+
+    qint64 bytes = static_cast<qint64>(tile.raster->frameCount()) * tile.raster->binCount()
+                   * (tile.raster->depth() == SpectrogramRaster::Depth8 ? 1 : 2);
+    tiles.insert(key, new SpectrogramTile(tile), static_cast<int>(qMax<qint64>(1, bytes / 1024)));
+    largestPeak = qMax(largestPeak, tile.peak);
+
+    emit tileReady();
+}
@@ -0,0 +1,122 @@
+//
+// Zoom-aware tile cache for spectrograms with background refinement.
+//
+
+#ifndef SPECTROGRAMTILECACHE_H
+#define SPECTROGRAMTILECACHE_H
+
+#include <QCache>
+#include <QHash>
+#include <QMutex>
+#include <QObject>
+#include <QSet>
+#include <QSharedPointer>
+#include <QThreadPool>
+#include <QVector>
+#include "SpectrogramEngine.h"
+#include "SpectrogramRaster.h"
+
+// Identifies one tile: time tile index at a zoom level for one set of STFT parameters
+struct SpectrogramTileKey {
+    int level = 0;
+    int index = 0;
+    quint64 parametersHash = 0;
+
+    bool operator==(const SpectrogramTileKey &other) const {
+        return level == other.level && index == other.index && parametersHash == other.parametersHash;
+    }
+};
+
+uint qHash(const SpectrogramTileKey &key, uint seed = 0);
+
+// One computed tile, ready to draw
+struct SpectrogramTile {
+    int level = 0;
+    double startTime = 0;   // Left edge of the first frame cell (s)
+    double endTime = 0;     // Right edge of the last frame cell (s)
+    float peak = 0;         // Largest power in the tile (dB)
+    QSharedPointer<SpectrogramRaster> raster;
+};
+
+// SpectrogramTileCache splits a recording into fixed-size time tiles per zoom level.
+// Level 0 uses the configured hop size; every finer level halves it. Tiles are computed
+// on a worker pool when requested and kept in an LRU cache bounded by a memory budget.
+class SpectrogramTileCache : public QObject {
+    Q_OBJECT
+
+public:
+    explicit SpectrogramTileCache(QObject *parent = nullptr);
+    ~SpectrogramTileCache();
+
+    // Set the signal and STFT parameters; tiles of other parameters are no longer returned
+    void setSource(const QVector<double> &samples, double samplingRate, const SpectrogramParameters &parameters);
+
+    // Quantization of the tile rasters
+    void setQuantization(SpectrogramRaster::Depth depth, double minValue, double maxValue);
+    SpectrogramRaster::Depth depth() const;
+    int quantizationLevelCount() const;
+    double quantizationLevelValue(int level) const;
+
+    // Upper bound of memory held by cached tiles
+    void setMemoryBudget(qint64 bytes);
+
+    // Geometry of the source
+    int zoomLevelCount() const;
+    int binCount() const;
+    double duration() const;
+    double maxFrequency() const;
+
+    // Finest zoom level whose frame step is not finer than the given seconds per pixel
+    int levelFor(double secondsPerPixel) const;
+
+    // Tiles to draw for the time range, coarse before fine. Missing tiles of the target
+    // level are requested in the background and covered by cached coarser tiles meanwhile.
+    QVector<SpectrogramTile> tilesFor(double startTime, double endTime, double secondsPerPixel);
+
+    // Request all tiles of a level, e.g. level 0 so there is always something to show
+    void prefetchLevel(int level);
+
+    // Largest power seen in any computed tile (dB)
+    float peak() const;
+
+signals:
+    // Emitted on the GUI thread whenever a requested tile was computed
+    void tileReady();
+
+private:
+    class TileTask;
+
+    int hopSize(int level) const;
+    double tileDuration(int level) const;
+    int tileCount(int level) const;
+    SpectrogramTileKey keyFor(int level, int index) const;
+    void requestTile(int level, int index);
+    void onTileComputed(const SpectrogramTileKey &key, const SpectrogramTile &tile, bool computed);
+
+    QVector<double> samples;              // Source, shared with the caller's buffer
+    double samplingRate;
+    SpectrogramParameters parameters;
+    QVector<float> window;
+    int fftSize;
+    int bins;
+    quint64 sourceGeneration;             // Advanced whenever a different sample buffer is set
+    quint64 parametersHash;
+
+    SpectrogramRaster::Depth cellDepth;
+    double minValue;
+    double maxValue;
+    float largestPeak;
+
+    QCache<SpectrogramTileKey, SpectrogramTile> tiles;   // LRU, cost in kilobytes
+    QSet<SpectrogramTileKey> pending;                     // Requested, not yet computed
+
+    // Tiles the current view needs; shared with queued tasks so unneeded ones are skipped
+    struct WantedTiles {
+        QMutex mutex;
+        QSet<SpectrogramTileKey> keys;
+    };
+    QSharedPointer<WantedTiles> wanted;
+    QThreadPool pool;
+};
+
+#endif // SPECTROGRAMTILECACHE_H
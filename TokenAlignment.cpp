@@ -0,0 +1,401 @@
+//
+// Time alignment of repeated tokens by banded dynamic time warping.
+//
+
+#include "TokenAlignment.h"
+#include "SignalResampler.h"
+#include <QRunnable>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+static const float infinity = std::numeric_limits<float>::infinity();
+
+// Frames of one token, one contiguous array per channel so distances run over neighbouring frames
+struct Features {
+    int length = 0;                  // Frames per channel, 0 if the token cannot be aligned
+    QVector<QVector<float>> channels;
+};
+
+// Function to get the duration of the reference token
+double TokenAlignment::duration() const {
+    if (reference < 0 || warps[reference].isEmpty()) {
+        return 0;
+    }
+    return (warps[reference].size() - 1) / featureRate;
+}
+
+// Function to map a reference time to the matching token time
+double TokenAlignment::tokenTime(int token, double referenceTime) const {
+    if (token < 0 || token >= warps.size() || warps[token].isEmpty()) {
+        return referenceTime;
+    }
+    const QVector<double> &warp = warps[token];
+    double position = qBound(0.0, referenceTime * featureRate, static_cast<double>(warp.size() - 1));
+    int index = static_cast<int>(position);
+    if (index >= warp.size() - 1) {
+        return warp.last();
+    }
+    double fraction = position - index;
+    return warp[index] * (1 - fraction) + warp[index + 1] * fraction;
+}
+
+// Function to sample a token channel on the time axis of the reference
+SampleBuffer warpChannel(const AlignmentToken &token, const QString &channel, const TokenAlignment &alignment,
+                         int tokenIndex, double samplingRate) {
+    SampleBuffer samples = token.channels.value(channel);
+    if (samples.isEmpty() || samplingRate <= 0 || tokenIndex < 0 || tokenIndex >= alignment.warps.size()
+        || alignment.warps[tokenIndex].isEmpty()) {
+        return SampleBuffer();
+    }
+
+    int count = static_cast<int>(std::floor(alignment.duration() * samplingRate)) + 1;
+    int last = samples.size() - 1;
+    QVector<float> values(count);
+    for (int k = 0; k < count; ++k) {
+        double time = alignment.tokenTime(tokenIndex, k / samplingRate);
+        double position = qBound(0.0, time * token.samplingRate, static_cast<double>(last));
+        int index = static_cast<int>(position);
+        double fraction = position - index;
+        double value = index < last ? samples.valueAt(index) * (1 - fraction) + samples.valueAt(index + 1) * fraction
+                                    : samples.valueAt(last);
+        values[k] = static_cast<float>(value);
+    }
+    return SampleBuffer(values);
+}
+
+// Function to resample the chosen channels of a token to frames at the feature rate; false if one is missing
+static bool extractFeatures(const AlignmentToken &token, const QStringList &channels, double rate, Features &out) {
+    out = Features();
+    double duration = std::numeric_limits<double>::max();
+    for (const QString &name : channels) {
+        SampleBuffer samples = token.channels.value(name);
+        if (samples.isEmpty() || token.samplingRate <= 0) {
+            return false;
+        }
+        duration = std::min(duration, (samples.size() - 1) / token.samplingRate);
+    }
+
+    int length = static_cast<int>(std::floor(duration * rate)) + 1;
+    PolyphaseResampler resampler(token.samplingRate, rate);
+    for (const QString &name : channels) {
+        QVector<float> values(length);
+        resampler.resample(token.channels.value(name), 0, length - 1, values.data());
+        out.channels.append(values);
+    }
+    out.length = length;
+    return true;
+}
+
+// Function to get the band half-width for two lengths; a steep diagonal widens it so that
+// the bands of neighbouring rows overlap and a path always exists
+static int bandHalfWidth(int n, int m, double fraction) {
+    int width = static_cast<int>(std::ceil(fraction * std::max(n, m)));
+    double slope = n > 1 ? static_cast<double>(m - 1) / (n - 1) : m;
+    return std::max(width, static_cast<int>(std::ceil(slope)) + 1);
+}
+
+// Function to get the token frames lo..hi row i of the reference may be matched to
+static void bandLimits(int n, int m, int halfWidth, int i, int &lo, int &hi) {
+    double center = n > 1 ? static_cast<double>(i) * (m - 1) / (n - 1) : 0;
+    lo = std::max(0, static_cast<int>(std::ceil(center - halfWidth)));
+    hi = std::min(m - 1, static_cast<int>(std::floor(center + halfWidth)));
+}
+
+// Function to compute row i of the accumulated cost over token frames lo..hi from row i - 1, given
+// over previousLo..previousHi (null for the first row); cost and shifted hold hi - lo + 2 values
+static void computeRow(const Features &a, const Features &b, int i, int lo, int hi,
+                       const float *previous, int previousLo, int previousHi, float *row, float *cost, float *shifted) {
+    int width = hi - lo + 1;
+
+    // Squared distances of reference frame i to the token frames, one pass per channel
+    std::fill(cost, cost + width, 0.0f);
+    for (int c = 0; c < a.channels.size(); ++c) {
+        float x = a.channels[c][i];
+        const float *y = b.channels[c].constData() + lo;
+        for (int k = 0; k < width; ++k) {
+            float difference = x - y[k];
+            cost[k] += difference * difference;
+        }
+    }
+
+    if (!previous) {
+        row[0] = cost[0];
+        for (int k = 1; k < width; ++k) {
+            row[k] = row[k - 1] + cost[k];
+        }
+        return;
+    }
+
+    // Row i - 1 at token frames lo - 1..hi, infinite outside its band
+    for (int k = 0; k <= width; ++k) {
+        int j = lo - 1 + k;
+        shifted[k] = j >= previousLo && j <= previousHi ? previous[j - previousLo] : infinity;
+    }
+
+    // Diagonal and vertical steps do not depend on the row itself; only the horizontal step carries
+    for (int k = 0; k < width; ++k) {
+        row[k] = std::min(shifted[k], shifted[k + 1]) + cost[k];
+    }
+    for (int k = 1; k < width; ++k) {
+        row[k] = std::min(row[k], row[k - 1] + cost[k]);
+    }
+}
+
+// Function to get the distance of two tokens, keeping only two rows of the cost matrix
+static double dtwDistance(const Features &a, const Features &b, double fraction) {
+    int n = a.length;
+    int m = b.length;
+    int halfWidth = bandHalfWidth(n, m, fraction);
+    int stride = 2 * halfWidth + 2;
+    QVector<float> rows(2 * stride);
+    QVector<float> cost(stride);
+    QVector<float> shifted(stride + 1);
+
+    const float *previous = nullptr;
+    int previousLo = 0;
+    int previousHi = -1;
+    for (int i = 0; i < n; ++i) {
+        int lo;
+        int hi;
+        bandLimits(n, m, halfWidth, i, lo, hi);
+        float *row = rows.data() + (i & 1) * stride;
+        computeRow(a, b, i, lo, hi, previous, previousLo, previousHi, row, cost.data(), shifted.data());
+        previous = row;
+        previousLo = lo;
+        previousHi = hi;
+    }
+    return previous[m - 1 - previousLo] / (n + m);
+}
+
+// Function to align b to a; matched receives the mean frame of b matched to every frame of a
+static double dtwWarp(const Features &a, const Features &b, double fraction, QVector<double> &matched) {
+    int n = a.length;
+    int m = b.length;
+    int halfWidth = bandHalfWidth(n, m, fraction);
+    int stride = 2 * halfWidth + 2;
+    QVector<float> band(n * stride);
+    QVector<int> los(n);
+    QVector<int> his(n);
+    QVector<float> cost(stride);
+    QVector<float> shifted(stride + 1);
+
+    for (int i = 0; i < n; ++i) {
+        bandLimits(n, m, halfWidth, i, los[i], his[i]);
+        const float *previous = i > 0 ? band.constData() + (i - 1) * stride : nullptr;
+        computeRow(a, b, i, los[i], his[i], previous, i > 0 ? los[i - 1] : 0, i > 0 ? his[i - 1] : -1,
+                   band.data() + i * stride, cost.data(), shifted.data());
+    }
+
+    // Accumulated cost of a cell, infinite outside the band
+    auto at = [&](int i, int j) {
+        return i >= 0 && j >= los[i] && j <= his[i] ? band[i * stride + j - los[i]] : infinity;
+    };
+
+    // Walk back from the last cell, preferring the diagonal on ties
+    QVector<double> sums(n, 0.0);
+    QVector<int> counts(n, 0);
+    int i = n - 1;
+    int j = m - 1;
+    for (;;) {
+        sums[i] += j;
+        ++counts[i];
+        if (i == 0 && j == 0) {
+            break;
+        }
+        float diagonal = at(i - 1, j - 1);
+        float up = at(i - 1, j);
+        float left = j > 0 ? at(i, j - 1) : infinity;
+        if (diagonal <= up && diagonal <= left) {
+            --i;
+            --j;
+        } else if (up <= left) {
+            --i;
+        } else {
+            --j;
+        }
+    }
+
+    matched.resize(n);
+    for (int k = 0; k < n; ++k) {
+        matched[k] = sums[k] / counts[k];
+    }
+    return at(n - 1, m - 1) / (n + m);
+}
+
+// Worker comparing one token with all tokens after it
+class TokenAligner::PairTask : public QRunnable {
+public:
+    PairTask(const QVector<Features> *features, int first, double fraction, double *distances)
+            : features(features), first(first), fraction(fraction), distances(distances) {}
+
+    void run() override {
+        int count = features->size();
+        for (int second = first + 1; second < count; ++second) {
+            if (features->at(second).length == 0) {
+                continue;
+            }
+            double distance = dtwDistance(features->at(first), features->at(second), fraction);
+            distances[first * count + second] = distance;
+            distances[second * count + first] = distance;
+        }
+    }
+
+private:
+    const QVector<Features> *features;
+    int first;
+    double fraction;
+    double *distances;   // count x count, each pair written by one task only
+};
+
+// Worker aligning one token to the reference
+class TokenAligner::PathTask : public QRunnable {
+public:
+    PathTask(const QVector<Features> *features, int reference, int token, double fraction, double rate,
+             double *distance, QVector<double> *warp)
+            : features(features), reference(reference), token(token), fraction(fraction), rate(rate),
+              distance(distance), warp(warp) {}
+
+    void run() override {
+        const Features &referenceFeatures = features->at(reference);
+        QVector<double> matched;
+        if (token == reference) {
+            matched.resize(referenceFeatures.length);
+            for (int i = 0; i < matched.size(); ++i) {
+                matched[i] = i;
+            }
+            *distance = 0;
+        } else {
+            *distance = dtwWarp(referenceFeatures, features->at(token), fraction, matched);
+        }
+
+        // Frames of the token become times
+        for (double &frame : matched) {
+            frame /= rate;
+        }
+        *warp = matched;
+    }
+
+private:
+    const QVector<Features> *features;
+    int reference;
+    int token;
+    double fraction;
+    double rate;
+    double *distance;
+    QVector<double> *warp;
+};
+
+// Constructor
+TokenAligner::TokenAligner()
+        : bandFraction(0.1), featureRate(100) {
+}
+
+// Destructor
+TokenAligner::~TokenAligner() {
+    pool.waitForDone();
+}
+
+// Function to set the band half-width
+void TokenAligner::setBand(double fraction) {
+    bandFraction = qBound(0.0, fraction, 1.0);
+}
+
+// Function to set the rate of the compared features
+void TokenAligner::setFeatureRate(double rate) {
+    featureRate = rate > 0 ? rate : 100;
+}
+
+// Function to align tokens to a reference
+TokenAlignment TokenAligner::align(const QVector<AlignmentToken> &tokens, const QStringList &channels, int reference) {
+    TokenAlignment result;
+    int count = tokens.size();
+    if (count == 0 || channels.isEmpty()) {
+        return result;
+    }
+
+    // Features are never sampled faster than the fastest token
+    double highestRate = 0;
+    for (const AlignmentToken &token : tokens) {
+        highestRate = std::max(highestRate, token.samplingRate);
+    }
+    double rate = std::min(featureRate, highestRate);
+    if (rate <= 0) {
+        return result;
+    }
+    result.featureRate = rate;
+
+    QVector<Features> features(count);
+    for (int t = 0; t < count; ++t) {
+        extractFeatures(tokens[t], channels, rate, features[t]);
+    }
+
+    // Every channel is scaled by its mean and deviation over all tokens
+    for (int c = 0; c < channels.size(); ++c) {
+        double sum = 0;
+        double squares = 0;
+        qint64 frames = 0;
+        for (const Features &token : features) {
+            for (int i = 0; i < token.length; ++i) {
+                double value = token.channels[c][i];
+                sum += value;
+                squares += value * value;
+            }
+            frames += token.length;
+        }
+        if (frames == 0) {
+            return result;
+        }
+        double mean = sum / frames;
+        double deviation = std::sqrt(std::max(0.0, squares / frames - mean * mean));
+        float scale = static_cast<float>(deviation > 0 ? 1 / deviation : 1);
+        for (Features &token : features) {
+            float *values = token.channels.isEmpty() ? nullptr : token.channels[c].data();
+            for (int i = 0; i < token.length; ++i) {
+                values[i] = static_cast<float>((values[i] - mean) * scale);
+            }
+        }
+    }
+
+    // Without a usable reference, the token with the smallest distance to all others is taken
+    if (reference < 0 || reference >= count || features[reference].length == 0) {
+        QVector<double> pairDistances(count * count, 0.0);
+        for (int t = 0; t < count; ++t) {
+            if (features[t].length > 0) {
+                pool.start(new PairTask(&features, t, bandFraction, pairDistances.data()));
+            }
+        }
+        pool.waitForDone();
+
+        reference = -1;
+        double bestSum = std::numeric_limits<double>::max();
+        for (int a = 0; a < count; ++a) {
+            if (features[a].length == 0) {
+                continue;
+            }
+            double sum = 0;
+            for (int b = 0; b < count; ++b) {
+                sum += pairDistances[a * count + b];
+            }
+            if (sum < bestSum) {
+                bestSum = sum;
+                reference = a;
+            }
+        }
+        if (reference < 0) {
+            return result;
+        }
+    }
+
+    result.reference = reference;
+    result.distances = QVector<double>(count, std::numeric_limits<double>::infinity());
+    result.warps.resize(count);
+    for (int t = 0; t < count; ++t) {
+        if (features[t].length > 0) {
+            pool.start(new PathTask(&features, reference, t, bandFraction, rate,
+                                    result.distances.data() + t, result.warps.data() + t));
+        }
+    }
+    pool.waitForDone();
+    return result;
+}
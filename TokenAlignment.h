@@ -0,0 +1,71 @@
+//
+// Time alignment of repeated tokens by banded dynamic time warping.
+//
+
+#ifndef TOKENALIGNMENT_H
+#define TOKENALIGNMENT_H
+
+#include <QMap>
+#include <QString>
+#include <QStringList>
+#include <QThreadPool>
+#include <QVector>
+#include "SampleBuffer.h"
+
+// One repetition of an utterance or gesture, all channels at one rate
+struct AlignmentToken {
+    QString name;
+    QMap<QString, SampleBuffer> channels;
+    double samplingRate = 1;
+};
+
+// Tokens aligned to one of them
+struct TokenAlignment {
+    int reference = -1;               // Index of the reference token, -1 if nothing was aligned
+    double featureRate = 0;           // Rate of the frames compared by the alignment (Hz)
+    QVector<double> distances;        // Per token: distance to the reference per path step, infinite if not aligned
+    QVector<QVector<double>> warps;   // Per token: token time (s) at every reference frame, empty if not aligned
+
+    // Duration of the reference token (s)
+    double duration() const;
+
+    // Time in a token matching a time in the reference, interpolated between frames
+    double tokenTime(int token, double referenceTime) const;
+};
+
+// Channel of a token sampled at the times matching t = i / samplingRate in the reference, as floats
+SampleBuffer warpChannel(const AlignmentToken &token, const QString &channel, const TokenAlignment &alignment,
+                         int tokenIndex, double samplingRate);
+
+// TokenAligner aligns repetitions by dynamic time warping on chosen channels. Channels are
+// resampled to a common frame rate and normalized with the mean and deviation of all tokens, so
+// channels of different units weigh alike while differences between tokens are kept. The warping
+// path is restricted to a band around the diagonal; inside the band a row of the cost matrix is
+// computed in two vectorizable passes (distances and the vertical and diagonal steps) and one short
+// sequential pass for the horizontal step. Without a given reference, all pairs of tokens are
+// compared on a worker pool and the token closest to all others becomes the reference; then every
+// token is aligned to it in parallel. align() returns once all alignments are done.
+class TokenAligner {
+public:
+    TokenAligner();
+    ~TokenAligner();
+
+    // Half-width of the band as a fraction of the longer token
+    void setBand(double fraction);
+    // Frame rate of the compared features; kinematic gestures need far less than the recording rate
+    void setFeatureRate(double rate);
+
+    // Align tokens on the given channels to the reference token, or to the most central token for -1;
+    // tokens lacking one of the channels are not aligned
+    TokenAlignment align(const QVector<AlignmentToken> &tokens, const QStringList &channels, int reference = -1);
+
+private:
+    class PairTask;
+    class PathTask;
+
+    double bandFraction;
+    double featureRate;
+    QThreadPool pool;
+};
+
+#endif // TOKENALIGNMENT_H
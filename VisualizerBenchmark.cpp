@@ -0,0 +1,315 @@
+//
+// Headless benchmark of the visualizer hot paths on synthetic sessions.
+//
+
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QMouseEvent>
+#include <QTextStream>
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "KinematicVisualizer.h"
+#include "ReplotScheduler.h"
+
+#ifdef Q_OS_UNIX
+#include <sys/resource.h>
+#endif
+
+// Sizes of the synthetic session and of every measurement
+struct BenchmarkSettings {
+    int channels = 8;
+    int samples = 1000000;
+    int samplingRate = 10000;
+    int frames = 4000;
+    int bins = 512;
+    int plots = 2;
+    int iterations = 20;
+    int moves = 2000;
+    int width = 1600;
+    int height = 400;
+    int tokens = 24;             // Repetitions of a 2-second gesture for the alignment
+    bool waveform = false;       // Column-raster waveforms instead of line graphs
+};
+
+// Latencies of one measured operation
+struct BenchmarkResult {
+    QString name;
+    std::vector<qint64> nanoseconds;
+    double itemsPerRun = 0;      // Work items per run for throughput, 0 for operations per second
+    QString itemUnit;
+};
+
+// Function to get the peak resident memory of the process in bytes, -1 if unknown
+static qint64 peakMemoryBytes() {
+#ifdef Q_OS_UNIX
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return -1;
+    }
+#ifdef Q_OS_MACOS
+    return usage.ru_maxrss;            // Bytes on macOS
+#else
+    return static_cast<qint64>(usage.ru_maxrss) * 1024;   // Kilobytes elsewhere
+#endif
+#else
+    return -1;
+#endif
+}
+
+// Function to create channels of mixed sines with a little noise
+static QMap<QString, QVector<double>> makeChannels(const BenchmarkSettings &settings) {
+    QMap<QString, QVector<double>> channels;
+    quint32 noise = 12345;
+    for (int c = 0; c < settings.channels; ++c) {
+        QVector<double> samples(settings.samples);
+        double frequency = 2.0 + 3.0 * c;
+        for (int i = 0; i < settings.samples; ++i) {
+            double t = static_cast<double>(i) / settings.samplingRate;
+            noise = noise * 1664525u + 1013904223u;
+            samples[i] = std::sin(2 * M_PI * frequency * t) + 0.3 * std::sin(2 * M_PI * 7.1 * frequency * t)
+                         + 0.05 * (static_cast<double>(noise >> 8) / (1 << 24) - 0.5);
+        }
+        channels.insert(QString("ch%1").arg(c), samples);
+    }
+    return channels;
+}
+
+// Function to create a spectrogram matrix in dB with a few moving formant bands
+static QVector<QVector<double>> makeSpectrogram(const BenchmarkSettings &settings) {
+    QVector<QVector<double>> matrix(settings.frames);
+    for (int x = 0; x < settings.frames; ++x) {
+        QVector<double> &column = matrix[x];
+        column.resize(settings.bins);
+        double phase = static_cast<double>(x) / settings.frames;
+        for (int y = 0; y < settings.bins; ++y) {
+            double band = static_cast<double>(y) / settings.bins;
+            double formant = std::exp(-std::pow((band - 0.2 - 0.1 * std::sin(6.28 * phase)) * 20, 2))
+                             + std::exp(-std::pow((band - 0.5) * 15, 2));
+            column[y] = -90 + 80 * formant;
+        }
+    }
+    return matrix;
+}
+
+// Function to time one operation a number of times; setup runs untimed before every run
+static BenchmarkResult measure(const QString &name, int runs, const std::function<void(int)> &operation,
+                               const std::function<void(int)> &setup = std::function<void(int)>()) {
+    BenchmarkResult result;
+    result.name = name;
+    result.nanoseconds.reserve(runs);
+    QElapsedTimer timer;
+    for (int run = 0; run < runs; ++run) {
+        if (setup) {
+            setup(run);
+        }
+        timer.start();
+        operation(run);
+        result.nanoseconds.push_back(timer.nsecsElapsed());
+    }
+    return result;
+}
+
+// Function to get a percentile of sorted latencies in milliseconds
+static double percentile(const std::vector<qint64> &sorted, double fraction) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    size_t index = static_cast<size_t>(std::ceil(fraction * sorted.size())) - 1;
+    return sorted[std::min(index, sorted.size() - 1)] / 1e6;
+}
+
+// Function to print one result line
+static void report(QTextStream &out, BenchmarkResult result) {
+    std::sort(result.nanoseconds.begin(), result.nanoseconds.end());
+    double total = 0;
+    for (qint64 ns : result.nanoseconds) {
+        total += ns;
+    }
+    double meanSeconds = result.nanoseconds.empty() ? 0 : total / result.nanoseconds.size() / 1e9;
+    double perRun = result.itemsPerRun > 0 ? result.itemsPerRun : 1;
+    QString unit = result.itemsPerRun > 0 ? result.itemUnit : QString("ops");
+    double throughput = meanSeconds > 0 ? perRun / meanSeconds : 0;
+
+    out << QString("%1 %2 %3 %4 %5 %6  %7 %8/s\n")
+            .arg(result.name, -28)
+            .arg(static_cast<qulonglong>(result.nanoseconds.size()), 6)
+            .arg(percentile(result.nanoseconds, 0.5), 10, 'f', 3)
+            .arg(percentile(result.nanoseconds, 0.95), 10, 'f', 3)
+            .arg(percentile(result.nanoseconds, 0.99), 10, 'f', 3)
+            .arg(result.nanoseconds.empty() ? 0.0 : result.nanoseconds.back() / 1e6, 10, 'f', 3)
+            .arg(throughput, 14, 'g', 4)
+            .arg(unit);
+    out.flush();
+}
+
+// Function to read the benchmark settings from the command line
+static BenchmarkSettings parseSettings(const QApplication &app) {
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Times the visualizer hot paths on a synthetic session.");
+    parser.addHelpOption();
+    BenchmarkSettings settings;
+    QList<QPair<QCommandLineOption, int*>> options = {
+            {QCommandLineOption("channels", "Signal channels.", "n", QString::number(settings.channels)), &settings.channels},
+            {QCommandLineOption("samples", "Samples per channel.", "n", QString::number(settings.samples)), &settings.samples},
+            {QCommandLineOption("rate", "Sampling rate (Hz).", "hz", QString::number(settings.samplingRate)), &settings.samplingRate},
+            {QCommandLineOption("frames", "Spectrogram frames.", "n", QString::number(settings.frames)), &settings.frames},
+            {QCommandLineOption("bins", "Spectrogram frequency bins.", "n", QString::number(settings.bins)), &settings.bins},
+            {QCommandLineOption("plots", "Plots in the sync group.", "n", QString::number(settings.plots)), &settings.plots},
+            {QCommandLineOption("iterations", "Runs of the load and zoom measurements.", "n", QString::number(settings.iterations)), &settings.iterations},
+            {QCommandLineOption("moves", "Mouse moves and pan steps.", "n", QString::number(settings.moves)), &settings.moves},
+            {QCommandLineOption("width", "Plot width (px).", "px", QString::number(settings.width)), &settings.width},
+            {QCommandLineOption("height", "Plot height (px).", "px", QString::number(settings.height)), &settings.height},
+            {QCommandLineOption("tokens", "Tokens aligned by dynamic time warping.", "n", QString::number(settings.tokens)), &settings.tokens},
+    };
+    for (const auto &option : options) {
+        parser.addOption(option.first);
+    }
+    QCommandLineOption waveformOption("waveform", "Draw the signal plots as column-raster waveforms.");
+    parser.addOption(waveformOption);
+    parser.process(app);
+    for (const auto &option : options) {
+        *option.second = qMax(1, parser.value(option.first).toInt());
+    }
+    settings.waveform = parser.isSet(waveformOption);
+    return settings;
+}
+
+int main(int argc, char *argv[]) {
+    // No display is needed; an explicit QT_QPA_PLATFORM still wins
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    QApplication app(argc, argv);
+    QApplication::setApplicationName("VisualizerBenchmark");
+    BenchmarkSettings settings = parseSettings(app);
+    QTextStream out(stdout);
+
+    out << QString("Session: %1 channels x %2 samples at %3 Hz, spectrogram %4 x %5, %6 plots of %7 x %8 px\n")
+            .arg(settings.channels).arg(settings.samples).arg(settings.samplingRate)
+            .arg(settings.frames).arg(settings.bins).arg(settings.plots)
+            .arg(settings.width).arg(settings.height);
+    QMap<QString, QVector<double>> channels = makeChannels(settings);
+    QVector<QVector<double>> spectrogram = makeSpectrogram(settings);
+    double duration = static_cast<double>(settings.samples) / settings.samplingRate;
+    out << QString("Synthetic data ready, peak memory %1 MB\n\n").arg(peakMemoryBytes() / 1048576.0, 0, 'f', 1);
+
+    // One document: signal plots plus a spectrogram, all in one sync group
+    PlotSyncGroup group;
+    std::vector<std::unique_ptr<KinematicVisualizer>> visualizers;
+    for (int p = 0; p < settings.plots + 1; ++p) {
+        visualizers.emplace_back(new KinematicVisualizer);
+        KinematicVisualizer *visualizer = visualizers.back().get();
+        visualizer->setSyncGroup(&group);
+        visualizer->setTrackedParameter("ch0");
+        visualizer->setWaveformRendering(settings.waveform);
+        visualizer->resize(settings.width, settings.height);
+        visualizer->show();
+    }
+    KinematicVisualizer *signalView = visualizers.front().get();
+    KinematicVisualizer *spectrogramView = visualizers.back().get();
+    QCustomPlot *signalPlot = signalView->getCustomPlot();
+    QApplication::processEvents();
+
+    out << QString("%1 %2 %3 %4 %5 %6  %7\n")
+            .arg("operation", -28).arg("runs", 6)
+            .arg("p50 ms", 10).arg("p95 ms", 10).arg("p99 ms", 10).arg("max ms", 10)
+            .arg("throughput", 14);
+
+    // Loading; every plot but the spectrogram shows the recording
+    BenchmarkResult load = measure("visualizeSignal", settings.iterations, [&](int) {
+        signalView->visualizeSignal(channels, "Benchmark", 1, settings.samplingRate);
+    });
+    load.itemsPerRun = static_cast<double>(settings.channels) * settings.samples;
+    load.itemUnit = "samples";
+    report(out, load);
+    for (int p = 1; p < settings.plots; ++p) {
+        visualizers[p]->visualizeSignal(channels, "Benchmark", 1, settings.samplingRate);
+    }
+
+    BenchmarkResult loadSpectrogram = measure("visualizeSpectrogram", settings.iterations, [&](int) {
+        spectrogramView->visualizeSpectrogram(spectrogram, "Benchmark", duration);
+    });
+    loadSpectrogram.itemsPerRun = static_cast<double>(settings.frames) * settings.bins;
+    loadSpectrogram.itemUnit = "cells";
+    report(out, loadSpectrogram);
+    ReplotScheduler::instance()->flush();
+
+    // Cursor lookup alone, as done by getYValueFromSignal for the tracked channel
+    SignalChannelStore store;
+    store.setChannel("ch0", channels.value("ch0"), settings.samplingRate);
+    volatile double sink = 0;
+    BenchmarkResult lookup = measure("cursor value lookup", settings.moves, [&](int run) {
+        sink = sink + store.valueAt("ch0", duration * run / settings.moves);
+    });
+    report(out, lookup);
+
+    // Mouse moves across the plot: updateCursorItems, the value lookup and one frame of replots
+    QRect area = signalPlot->axisRect()->rect();
+    BenchmarkResult moves = measure("mouse move + frame", settings.moves, [&](int run) {
+        QPoint position(area.left() + run % qMax(1, area.width()), area.center().y());
+        QMouseEvent event(QEvent::MouseMove, position, Qt::NoButton, Qt::NoButton, Qt::NoModifier);
+        QApplication::sendEvent(signalPlot, &event);
+        ReplotScheduler::instance()->flush();
+    });
+    report(out, moves);
+
+    // Panning a zoomed-in view: synchronizePlots, level of detail of every plot, one frame
+    double window = duration / 20;
+    BenchmarkResult pan = measure("pan + sync + frame", settings.moves, [&](int run) {
+        double start = std::fmod(run * window / 50, duration - window);
+        signalPlot->xAxis->setRange(start, start + window);
+        ReplotScheduler::instance()->flush();
+    });
+    report(out, pan);
+
+    // Zooming to a selection, restoring the full range untimed before every run
+    BenchmarkResult zoom = measure("zoomToSelection", settings.iterations, [&](int) {
+        signalView->zoomToSelection();
+        ReplotScheduler::instance()->flush();
+    }, [&](int run) {
+        signalPlot->xAxis->setRange(0, duration);
+        ReplotScheduler::instance()->flush();
+        double start = duration * (run % 10) / 20;
+        QCPItemRect *rect = new QCPItemRect(signalPlot);
+        rect->topLeft->setCoords(start, signalPlot->yAxis->range().upper);
+        rect->bottomRight->setCoords(start + duration / 10, signalPlot->yAxis->range().lower);
+        group.setSelection(rect);
+    });
+    report(out, zoom);
+
+    // Aligning repetitions of a 2-second gesture at 250 Hz, each played at its own speed
+    QVector<AlignmentToken> tokens;
+    for (int t = 0; t < settings.tokens; ++t) {
+        AlignmentToken token;
+        token.name = QString("token%1").arg(t);
+        token.samplingRate = 250;
+        double speed = 0.8 + 0.4 * t / qMax(1, settings.tokens - 1);
+        int count = static_cast<int>(2 * token.samplingRate / speed);
+        for (int c = 0; c < 3; ++c) {
+            QVector<double> values(count);
+            for (int i = 0; i < count; ++i) {
+                double phase = static_cast<double>(i) / count;
+                values[i] = std::sin(2 * M_PI * (c + 1) * (phase + 0.05 * std::sin(M_PI * phase)));
+            }
+            token.channels.insert(QString("ch%1").arg(c), SampleBuffer(values));
+        }
+        tokens.append(token);
+    }
+    TokenAligner tokenAligner;
+    BenchmarkResult alignment = measure("token alignment", settings.iterations, [&](int) {
+        tokenAligner.align(tokens, QStringList() << "ch0" << "ch1" << "ch2");
+    });
+    alignment.itemsPerRun = settings.tokens;
+    alignment.itemUnit = "tokens";
+    report(out, alignment);
+
+    qint64 peak = peakMemoryBytes();
+    out << "\n" << (peak < 0 ? QString("Peak memory: unknown on this platform\n")
+                             : QString("Peak memory: %1 MB\n").arg(peak / 1048576.0, 0, 'f', 1));
+    Q_UNUSED(sink);
+    return 0;
+}
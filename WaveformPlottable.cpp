@@ -0,0 +1,220 @@
+//
+// QCustomPlot plottable drawing a uniformly sampled channel as a column raster.
+//
+
+#include "WaveformPlottable.h"
+#include "PlotProfiler.h"
+#include <cmath>
+#include <cstring>
+
+// Constructor
+WaveformPlottable::WaveformPlottable(QCPAxis *keyAxis, QCPAxis *valueAxis)
+        : QCPAbstractPlottable(keyAxis, valueAxis), samplingRate(1), offset(0), revision(0),
+          imageFirstColumn(0), imageKeysPerColumn(0), imageRevision(-1), imageColor(0), imagePenWidth(0),
+          imageRatio(1) {
+}
+
+// Function to set the channel and where it is drawn
+void WaveformPlottable::setSignal(const SampleBuffer &samples, const SignalPyramid &pyramid, double samplingRate, double offset) {
+    this->samples = samples;
+    this->pyramid = pyramid;
+    this->samplingRate = samplingRate > 0 ? samplingRate : 1;
+    this->offset = offset;
+    ++revision;
+}
+
+// Function to test for selection, the waveform is not selectable
+double WaveformPlottable::selectTest(const QPointF &pos, bool onlySelectable, QVariant *details) const {
+    Q_UNUSED(pos);
+    Q_UNUSED(onlySelectable);
+    Q_UNUSED(details);
+    return -1;
+}
+
+// Function to get the time range covered by the samples
+QCPRange WaveformPlottable::getKeyRange(bool &foundRange, QCP::SignDomain inSignDomain) const {
+    Q_UNUSED(inSignDomain);
+    foundRange = !samples.isEmpty();
+    return QCPRange(0, (samples.size() - 1) / samplingRate);
+}
+
+// Function to get the value range of the samples, optionally within a key range
+QCPRange WaveformPlottable::getValueRange(bool &foundRange, QCP::SignDomain inSignDomain, const QCPRange &inKeyRange) const {
+    Q_UNUSED(inSignDomain);
+    foundRange = false;
+
+    // Without the pyramid, the range of a mapped file would mean reading all of it
+    if (samples.isEmpty() || (pyramid.levelCount() == 1 && samples.size() > SignalPyramid::reductionFactor)) {
+        return QCPRange();
+    }
+    int first = 0;
+    int last = samples.size() - 1;
+    if (inKeyRange != QCPRange()) {
+        first = static_cast<int>(qBound(0.0, std::ceil(inKeyRange.lower * samplingRate), static_cast<double>(last)));
+        last = static_cast<int>(qBound(0.0, std::floor(inKeyRange.upper * samplingRate), static_cast<double>(last)));
+    }
+    double low;
+    double high;
+    foundRange = pyramid.rangeMinMax(samples, first, last, low, high);
+    return foundRange ? QCPRange(low + offset, high + offset) : QCPRange();
+}
+
+// Function to get the value at a fractional sample position inside the channel
+double WaveformPlottable::interpolatedValue(double position) const {
+    int index = static_cast<int>(position);
+    if (index >= samples.size() - 1) {
+        return samples.valueAt(samples.size() - 1);
+    }
+    double fraction = position - index;
+    return samples.valueAt(index) * (1 - fraction) + samples.valueAt(index + 1) * fraction;
+}
+
+// Function to get the lowest and highest value drawn in one column of the grid; false if it lies outside the channel
+bool WaveformPlottable::extentOf(qint64 column, double &low, double &high) const {
+    int count = samples.size();
+    double start = column * imageKeysPerColumn * samplingRate;
+    double end = (column + 1) * imageKeysPerColumn * samplingRate;
+    if (count == 0 || end < 0 || start > count - 1) {
+        return false;
+    }
+
+    // Values at the column edges connect the column to its neighbours
+    start = qMax(0.0, start);
+    end = qMin(static_cast<double>(count - 1), end);
+    low = interpolatedValue(start);
+    high = low;
+    double edge = interpolatedValue(end);
+    low = qMin(low, edge);
+    high = qMax(high, edge);
+
+    // Samples inside the column, one range query; a short run stands in while the pyramid is missing
+    int first = static_cast<int>(std::ceil(start));
+    int last = static_cast<int>(std::floor(end));
+    if (pyramid.levelCount() == 1 && count > SignalPyramid::reductionFactor) {
+        last = qMin(last, first + probeLength - 1);
+    }
+    double rangeLow;
+    double rangeHigh;
+    if (pyramid.rangeMinMax(samples, first, last, rangeLow, rangeHigh)) {
+        low = qMin(low, rangeLow);
+        high = qMax(high, rangeHigh);
+    }
+    return true;
+}
+
+// Function to rasterize image columns firstColumn..lastColumn
+void WaveformPlottable::renderColumns(int firstColumn, int lastColumn) {
+    QCPAxis *valueAxis = mValueAxis.data();
+    int height = image.height();
+    int stride = image.bytesPerLine() / static_cast<int>(sizeof(QRgb));
+    QRgb *pixels = reinterpret_cast<QRgb *>(image.bits());
+    double top = clipRect().top();
+    double ratio = imageRatio;
+
+    // Wider pens thicken the span vertically
+    int padAbove = (imagePenWidth - 1) / 2;
+    int padBelow = imagePenWidth - 1 - padAbove;
+
+    for (int x = firstColumn; x <= lastColumn; ++x) {
+        int spanTop = height;
+        int spanBottom = -1;
+        double low;
+        double high;
+        if (extentOf(imageFirstColumn + x, low, high)) {
+            double upperRow = qBound(-1.0, (valueAxis->coordToPixel(high + offset) - top) * ratio, static_cast<double>(height));
+            double lowerRow = qBound(-1.0, (valueAxis->coordToPixel(low + offset) - top) * ratio, static_cast<double>(height));
+            if (upperRow > lowerRow) {
+                std::swap(upperRow, lowerRow);
+            }
+            spanTop = qMax(0, static_cast<int>(std::floor(upperRow)) - padAbove);
+            spanBottom = qMin(height - 1, static_cast<int>(std::floor(lowerRow)) + padBelow);
+        }
+
+        QRgb *pixel = pixels + x;
+        for (int y = 0; y < height; ++y, pixel += stride) {
+            *pixel = y >= spanTop && y <= spanBottom ? imageColor : 0;
+        }
+    }
+}
+
+// Function to move the image by fewer whole columns than its width and draw the columns that became visible
+void WaveformPlottable::shiftColumns(int columns) {
+    int width = image.width();
+    imageFirstColumn += columns;
+    int kept = width - qAbs(columns);
+    for (int y = 0; y < image.height(); ++y) {
+        QRgb *line = reinterpret_cast<QRgb *>(image.scanLine(y));
+        if (columns > 0) {
+            std::memmove(line, line + columns, kept * sizeof(QRgb));
+        } else {
+            std::memmove(line - columns, line, kept * sizeof(QRgb));
+        }
+    }
+    if (columns > 0) {
+        renderColumns(kept, width - 1);
+    } else {
+        renderColumns(0, -columns - 1);
+    }
+}
+
+// Function to draw the channel from the cached columns
+void WaveformPlottable::draw(QCPPainter *painter) {
+    QCPAxis *keyAxis = mKeyAxis.data();
+    QCPAxis *valueAxis = mValueAxis.data();
+    QRect rect = clipRect();
+    if (!keyAxis || !valueAxis || samples.isEmpty() || rect.isEmpty()) {
+        return;
+    }
+    PlotProfiler::Scope scope("waveform", mParentPlot);
+
+    // One column per device pixel; a pan keeps the grid of the image, so its columns stay valid
+    qreal ratio = painter->device() ? painter->device()->devicePixelRatioF() : 1;
+    int columns = qMax(1, qRound(rect.width() * ratio));
+    QCPRange keys = keyAxis->range();
+    double keysPerColumn = keys.size() / columns;
+    if (keysPerColumn <= 0) {
+        return;
+    }
+    QSize size(columns + 1, qMax(1, qRound(rect.height() * ratio)));
+    bool sameGrid = image.size() == size && imageRatio == ratio
+                    && qAbs(keysPerColumn - imageKeysPerColumn) <= imageKeysPerColumn * 1e-9;
+    if (sameGrid) {
+        keysPerColumn = imageKeysPerColumn;
+    }
+    qint64 firstColumn = static_cast<qint64>(std::floor(keys.lower / keysPerColumn));
+    QRgb color = qPremultiply(mPen.color().rgba());
+    int penWidth = qMax(1, qRound(qMax(1, mPen.width()) * ratio));
+
+    if (!sameGrid || imageValueRange != valueAxis->range() || imageRevision != revision
+        || imageColor != color || imagePenWidth != penWidth) {
+        if (image.size() != size) {
+            image = QImage(size, QImage::Format_ARGB32_Premultiplied);
+        }
+        image.setDevicePixelRatio(ratio);
+        imageRatio = ratio;
+        imageFirstColumn = firstColumn;
+        imageKeysPerColumn = keysPerColumn;
+        imageValueRange = valueAxis->range();
+        imageRevision = revision;
+        imageColor = color;
+        imagePenWidth = penWidth;
+        renderColumns(0, size.width() - 1);
+    } else if (qAbs(firstColumn - imageFirstColumn) >= size.width()) {
+        imageFirstColumn = firstColumn;
+        renderColumns(0, size.width() - 1);
+    } else if (firstColumn != imageFirstColumn) {
+        shiftColumns(static_cast<int>(firstColumn - imageFirstColumn));
+    }
+
+    // The grid is drawn where its first column starts, up to one pixel left of the axis rect,
+    // snapped to a device pixel so columns are not resampled
+    double left = keyAxis->coordToPixel(imageFirstColumn * imageKeysPerColumn);
+    painter->drawImage(QPointF(std::floor(left * ratio + 0.5) / ratio, rect.top()), image);
+}
+
+// Function to draw the legend icon as a line in the pen of the waveform
+void WaveformPlottable::drawLegendIcon(QCPPainter *painter, const QRectF &rect) const {
+    applyDefaultAntialiasingHint(painter);
+    painter->setPen(mPen);
+    painter->drawLine(QLineF(rect.left(), rect.center().y(), rect.right(), rect.center().y()));
+}
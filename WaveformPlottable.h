@@ -0,0 +1,65 @@
+//
+// QCustomPlot plottable drawing a uniformly sampled channel as a column raster.
+//
+
+#ifndef WAVEFORMPLOTTABLE_H
+#define WAVEFORMPLOTTABLE_H
+
+#include "qcustomplot.h"
+#include "SampleBuffer.h"
+#include "SignalPyramid.h"
+
+// WaveformPlottable draws one channel without building a polyline. Every device pixel column
+// covers a fixed key interval, so high-DPI screens get their full horizontal resolution. The
+// vertical span of a column runs from the lowest to the highest value in its interval,
+// including the values interpolated at both edges so neighbouring columns join up. Spans are
+// rasterized into a cached image aligned to a column grid, so a pan shifts the image by whole
+// columns and only the columns it exposes are computed again. Zooming, a new value range or new
+// samples redraw all columns, each at the cost of one pyramid range query.
+class WaveformPlottable : public QCPAbstractPlottable {
+    Q_OBJECT
+
+public:
+    WaveformPlottable(QCPAxis *keyAxis, QCPAxis *valueAxis);
+
+    // Channel shown by the plottable; sample i lies at key i / samplingRate and is drawn at its
+    // value plus offset. The pyramid must be built from the samples, or hold only level 0 while
+    // it is being built, in which case columns read a short run of samples instead.
+    void setSignal(const SampleBuffer &samples, const SignalPyramid &pyramid, double samplingRate, double offset);
+
+    // QCPAbstractPlottable interface
+    double selectTest(const QPointF &pos, bool onlySelectable, QVariant *details = nullptr) const override;
+    QCPRange getKeyRange(bool &foundRange, QCP::SignDomain inSignDomain = QCP::sdBoth) const override;
+    QCPRange getValueRange(bool &foundRange, QCP::SignDomain inSignDomain = QCP::sdBoth, const QCPRange &inKeyRange = QCPRange()) const override;
+
+protected:
+    void draw(QCPPainter *painter) override;
+    void drawLegendIcon(QCPPainter *painter, const QRectF &rect) const override;
+
+private:
+    // Samples read per column while the pyramid is missing
+    static constexpr int probeLength = 64;
+
+    bool extentOf(qint64 column, double &low, double &high) const;
+    double interpolatedValue(double position) const;
+    void renderColumns(int firstColumn, int lastColumn);
+    void shiftColumns(int columns);
+
+    SampleBuffer samples;
+    SignalPyramid pyramid;
+    double samplingRate;
+    double offset;
+    int revision;                 // Advanced whenever the samples or their placement change
+
+    // Image of the columns imageFirstColumn.. on a grid of imageKeysPerColumn, and what it was drawn for
+    QImage image;
+    qint64 imageFirstColumn;
+    double imageKeysPerColumn;
+    QCPRange imageValueRange;
+    int imageRevision;
+    QRgb imageColor;
+    int imagePenWidth;               // In device pixels
+    qreal imageRatio;                // Device pixels per logical pixel
+};
+
+#endif // WAVEFORMPLOTTABLE_H